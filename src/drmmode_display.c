@@ -38,9 +38,12 @@
 #include "X11/Xatom.h"
 
 #include <sys/ioctl.h>
+#include "damage.h"
 #ifdef HAVE_LIBUDEV
+#include "randrstr.h"
 #include "libudev.h"
 #endif
+#include "drmmode_fb.h"
 
 typedef struct {
     int fd;
@@ -50,9 +53,22 @@ typedef struct {
     drmEventContext event_context;
 #ifdef HAVE_LIBUDEV
     struct udev_monitor *uevent_monitor;
+    OsTimerPtr hotplug_timer;
+    Bool hotplug_pending;
+    uint32_t hotplug_connector; /* 0: reprobe them all */
+    Bool hotplug_query; /* RRGetInfo is ours, the probes are fresh */
+    RRGetInfoProcPtr rr_get_info;
 #endif
+    drmmode_fb_cache_rec fb_cache;
+    DamagePtr tearfree_damage;
 } drmmode_rec, *drmmode_ptr;
 
+typedef struct {
+    struct nouveau_bo *bo;
+    PixmapPtr pixmap;
+    uint32_t fb_id;
+} drmmode_scanout_rec, *drmmode_scanout_ptr;
+
 typedef struct {
     drmmode_ptr drmmode;
     drmModeCrtcPtr mode_crtc;
@@ -61,7 +77,21 @@ typedef struct {
     int rotate_pitch;
     PixmapPtr rotate_pixmap;
     uint32_t rotate_fb_id;
+    uint32_t scanout_fb; /* framebuffer the CRTC shows */
+    uint32_t flip_fb; /* framebuffer it's flipping to, 0 if none */
     Bool cursor_visible;
+    /* TearFree */
+    drmmode_scanout_rec scanout[2];
+    int scanout_width;
+    int scanout_height;
+    int scanout_front;
+    RegionRec scanout_damage; /* drawn since the last flip */
+    RegionRec scanout_prev; /* copied for the last flip, the back lacks it */
+    RegionRec scanout_ready; /* already in the back, its flip failed */
+    Bool flip_pending;
+    int dpms_mode;
+    unsigned long frames;
+    unsigned long copied;
 } drmmode_crtc_private_rec, *drmmode_crtc_private_ptr;
 
 typedef struct {
@@ -79,6 +109,11 @@ typedef struct {
     drmModeConnectorPtr mode_output;
     drmModeEncoderPtr mode_encoder;
     drmModePropertyBlobPtr edid_blob;
+    uint32_t edid_prop_id;
+    unsigned long epoch; /* bumped on every connector probe */
+    unsigned long edid_epoch; /* probe the EDID was last looked at */
+    Bool probed; /* mode_output is current until the next uevent or
+		  * RandR query */
     int num_props;
     drmmode_prop_ptr props;
 } drmmode_output_private_rec, *drmmode_output_private_ptr;
@@ -98,6 +133,19 @@ drmmode_from_scrn(ScrnInfoPtr scrn)
 	return NULL;
 }
 
+void
+drmmode_fb_release(ScrnInfoPtr scrn, struct nouveau_bo *bo)
+{
+	xf86CrtcConfigPtr conf = XF86_CRTC_CONFIG_PTR(scrn);
+	drmmode_crtc_private_ptr drmmode_crtc;
+
+	if (!bo || !conf || !conf->num_crtc)
+		return;
+
+	drmmode_crtc = conf->crtc[0]->driver_private;
+	drmmode_fb_evict(&drmmode_crtc->drmmode->fb_cache, bo, FALSE);
+}
+
 static PixmapPtr
 drmmode_pixmap_wrap(ScreenPtr pScreen, int width, int height, int depth,
 		    int bpp, int pitch, struct nouveau_bo *bo, void *data)
@@ -180,7 +228,10 @@ drmmode_ConvertToKMode(ScrnInfoPtr scrn, drmModeModeInfo *kmode,
 static void
 drmmode_crtc_dpms(xf86CrtcPtr drmmode_crtc, int mode)
 {
+	drmmode_crtc_private_ptr priv = drmmode_crtc->driver_private;
 
+	priv->dpms_mode = mode;
+	nouveau_dri2_vblank_reset(drmmode_crtc->scrn);
 }
 
 void
@@ -262,8 +313,8 @@ drmmode_fbcon_copy(ScreenPtr pScreen)
 	/* wait for completion before continuing, avoids seeing a momentary
 	 * flash of "corruption" on occasion
 	 */
-	nouveau_bo_map(pNv->scanout, NOUVEAU_BO_RDWR);
-	nouveau_bo_unmap(pNv->scanout);
+	nv_bo_map(pNv, pNv->scanout, NOUVEAU_BO_RDWR);
+	nv_bo_unmap(pNv, pNv->scanout);
 
 	pScreen->DestroyPixmap(pdpix);
 	pScreen->DestroyPixmap(pspix);
@@ -272,10 +323,376 @@ drmmode_fbcon_copy(ScreenPtr pScreen)
 
 fallback:
 #endif
-	if (nouveau_bo_map(pNv->scanout, NOUVEAU_BO_WR))
+	if (nv_bo_map(pNv, pNv->scanout, NOUVEAU_BO_WR))
 		return;
 	memset(pNv->scanout->map, 0x00, pNv->scanout->size);
-	nouveau_bo_unmap(pNv->scanout);
+	nv_bo_unmap(pNv, pNv->scanout);
+}
+
+/* TearFree: rather than scanning out of the screen pixmap, each CRTC flips
+ * between two buffers of its own.  Whatever was drawn since the last flip
+ * is copied into the back one from the block handler, and flipped to on
+ * the next vblank.  The back buffer also misses whatever went into the
+ * front one for the previous flip, so that's copied again too.
+ *
+ * Flip events carry the CRTC, tagged in the low bit to tell them apart
+ * from DRI2 swaps, which carry their swap state.
+ */
+#define DRMMODE_TEARFREE_EVENT(c)	((void *)((uintptr_t)(c) | 1))
+#define DRMMODE_IS_TEARFREE_EVENT(p)	((uintptr_t)(p) & 1)
+#define DRMMODE_TEARFREE_CRTC(p)	\
+	((drmmode_crtc_private_ptr)((uintptr_t)(p) & ~(uintptr_t)1))
+
+static void
+drmmode_scanout_free(drmmode_ptr drmmode, drmmode_scanout_ptr scanout)
+{
+	if (scanout->pixmap) {
+		ScreenPtr pScreen = scanout->pixmap->drawable.pScreen;
+
+		pScreen->DestroyPixmap(scanout->pixmap);
+	}
+	if (scanout->bo) {
+		drmmode_fb_evict(&drmmode->fb_cache, scanout->bo, TRUE);
+		nouveau_bo_ref(NULL, &scanout->bo);
+	}
+	memset(scanout, 0, sizeof(*scanout));
+}
+
+static Bool
+drmmode_scanout_copy(ScrnInfoPtr scrn, drmmode_scanout_ptr scanout,
+		     RegionPtr region, int x, int y)
+{
+	ScreenPtr pScreen = scrn->pScreen;
+	ExaDriverPtr exa = NVPTR(scrn)->EXADriverPtr;
+	PixmapPtr ppix = pScreen->GetScreenPixmap(pScreen);
+	BoxPtr box = REGION_RECTS(region);
+	int nbox = REGION_NUM_RECTS(region);
+
+	if (!exa->PrepareCopy(ppix, scanout->pixmap, 1, 1, GXcopy, FB_ALLONES))
+		return FALSE;
+
+	while (nbox--) {
+		exa->Copy(scanout->pixmap, box->x1, box->y1,
+			  box->x1 - x, box->y1 - y,
+			  box->x2 - box->x1, box->y2 - box->y1);
+		box++;
+	}
+	exa->DoneCopy(scanout->pixmap);
+	return TRUE;
+}
+
+/* (Re)allocates the CRTC's buffers for the mode and fills both of them.
+ * Buffers of a previous size are handed back in old, to be freed once the
+ * CRTC no longer scans out of them.
+ */
+static Bool
+drmmode_tearfree_setup(xf86CrtcPtr crtc, DisplayModePtr mode, int x, int y,
+		       drmmode_scanout_rec old[2])
+{
+	ScrnInfoPtr scrn = crtc->scrn;
+	drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
+	drmmode_ptr drmmode = drmmode_crtc->drmmode;
+	int width = mode->HDisplay, height = mode->VDisplay;
+	BoxRec box = { x, y, x + width, y + height };
+	RegionRec region;
+	int i, pitch;
+
+	if (!drmmode->tearfree_damage)
+		return FALSE;
+
+	if (drmmode_crtc->scanout_width != width ||
+	    drmmode_crtc->scanout_height != height) {
+		memcpy(old, drmmode_crtc->scanout,
+		       sizeof(drmmode_crtc->scanout));
+		memset(drmmode_crtc->scanout, 0,
+		       sizeof(drmmode_crtc->scanout));
+		drmmode_crtc->scanout_width = 0;
+		drmmode_crtc->scanout_height = 0;
+
+		for (i = 0; i < 2; i++) {
+			drmmode_scanout_ptr scanout = &drmmode_crtc->scanout[i];
+
+			if (!nouveau_allocate_surface(scrn, width, height,
+						      scrn->bitsPerPixel,
+						      NOUVEAU_CREATE_PIXMAP_SCANOUT,
+						      &pitch, &scanout->bo))
+				goto fail;
+
+			scanout->fb_id = drmmode_fb_get(&drmmode->fb_cache,
+							scanout->bo,
+							width, height, pitch,
+							scrn->depth,
+							scrn->bitsPerPixel,
+							TRUE);
+			if (!scanout->fb_id)
+				goto fail;
+
+			scanout->pixmap =
+				drmmode_pixmap_wrap(scrn->pScreen, width,
+						    height, scrn->depth,
+						    scrn->bitsPerPixel, pitch,
+						    scanout->bo, NULL);
+			if (!scanout->pixmap)
+				goto fail;
+		}
+
+		drmmode_crtc->scanout_width = width;
+		drmmode_crtc->scanout_height = height;
+	}
+
+	REGION_INIT(NULL, &region, &box, 1);
+	for (i = 0; i < 2; i++) {
+		if (!drmmode_scanout_copy(scrn, &drmmode_crtc->scanout[i],
+					  &region, x, y)) {
+			REGION_UNINIT(NULL, &region);
+			return FALSE;
+		}
+	}
+	REGION_UNINIT(NULL, &region);
+	FIRE_RING(NVPTR(scrn)->chan);
+
+	REGION_EMPTY(NULL, &drmmode_crtc->scanout_damage);
+	REGION_EMPTY(NULL, &drmmode_crtc->scanout_prev);
+	REGION_EMPTY(NULL, &drmmode_crtc->scanout_ready);
+	return TRUE;
+
+fail:
+	xf86DrvMsg(scrn->scrnIndex, X_WARNING,
+		   "Couldn't allocate TearFree buffers, tearing instead\n");
+	for (i = 0; i < 2; i++)
+		drmmode_scanout_free(drmmode, &drmmode_crtc->scanout[i]);
+	return FALSE;
+}
+
+static void
+drmmode_tearfree_flip(xf86CrtcPtr crtc)
+{
+	ScrnInfoPtr scrn = crtc->scrn;
+	drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
+	drmmode_ptr drmmode = drmmode_crtc->drmmode;
+	int back = drmmode_crtc->scanout_front ^ 1;
+	unsigned long copied = 0;
+	RegionRec region;
+	BoxPtr box;
+	int nbox, ret;
+
+	if (drmmode_crtc->flip_pending || drmmode_crtc->dpms_mode != DPMSModeOn)
+		return;
+
+	/* Anything drawn since the last flip, plus what the back buffer
+	 * missed of the previous one, goes in unless a failed flip already
+	 * put it there.
+	 */
+	REGION_NULL(NULL, &region);
+	REGION_UNION(NULL, &region, &drmmode_crtc->scanout_damage,
+		     &drmmode_crtc->scanout_prev);
+	REGION_SUBTRACT(NULL, &region, &region, &drmmode_crtc->scanout_ready);
+	if (!REGION_NOTEMPTY(NULL, &region) &&
+	    !REGION_NOTEMPTY(NULL, &drmmode_crtc->scanout_ready)) {
+		REGION_UNINIT(NULL, &region);
+		return;
+	}
+
+	if (REGION_NOTEMPTY(NULL, &region)) {
+		if (!drmmode_scanout_copy(scrn, &drmmode_crtc->scanout[back],
+					  &region, crtc->x, crtc->y)) {
+			REGION_UNINIT(NULL, &region);
+			return;
+		}
+		FIRE_RING(NVPTR(scrn)->chan);
+
+		box = REGION_RECTS(&region);
+		nbox = REGION_NUM_RECTS(&region);
+		while (nbox--) {
+			copied += (box->x2 - box->x1) * (box->y2 - box->y1);
+			box++;
+		}
+		REGION_UNION(NULL, &drmmode_crtc->scanout_ready,
+			     &drmmode_crtc->scanout_ready, &region);
+		drmmode_crtc->copied += copied * (scrn->bitsPerPixel / 8);
+	}
+	REGION_UNINIT(NULL, &region);
+
+	ret = drmModePageFlip(drmmode->fd, drmmode_crtc->mode_crtc->crtc_id,
+			      drmmode_crtc->scanout[back].fb_id,
+			      DRM_MODE_PAGE_FLIP_EVENT,
+			      DRMMODE_TEARFREE_EVENT(drmmode_crtc));
+	if (ret) {
+		/* the back buffer stays current, only the flip is retried */
+		xf86DrvMsgVerb(scrn->scrnIndex, X_WARNING, 3,
+			       "TearFree flip failed: %s\n", strerror(errno));
+		return;
+	}
+
+	drmmode_crtc->flip_pending = TRUE;
+	drmmode_fb_hold(&drmmode->fb_cache, &drmmode_crtc->flip_fb,
+			drmmode_crtc->scanout[back].fb_id);
+	drmmode_crtc->scanout_front = back;
+	REGION_COPY(NULL, &drmmode_crtc->scanout_prev,
+		    &drmmode_crtc->scanout_damage);
+	REGION_EMPTY(NULL, &drmmode_crtc->scanout_damage);
+	REGION_EMPTY(NULL, &drmmode_crtc->scanout_ready);
+	drmmode_crtc->frames++;
+}
+
+/* Hands the screen damage out to the CRTCs showing it, and starts a flip
+ * on every CRTC that has something new and isn't still flipping or off.
+ */
+void
+drmmode_tearfree_update(ScrnInfoPtr scrn)
+{
+	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(scrn);
+	drmmode_ptr drmmode = drmmode_from_scrn(scrn);
+	RegionPtr damage;
+	int i;
+
+	if (!drmmode || !drmmode->tearfree_damage)
+		return;
+	damage = DamageRegion(drmmode->tearfree_damage);
+
+	for (i = 0; i < config->num_crtc; i++) {
+		xf86CrtcPtr crtc = config->crtc[i];
+		drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
+		RegionRec region;
+		BoxRec box;
+
+		if (!crtc->enabled || !drmmode_crtc->scanout_width)
+			continue;
+
+		box.x1 = crtc->x;
+		box.y1 = crtc->y;
+		box.x2 = crtc->x + drmmode_crtc->scanout_width;
+		box.y2 = crtc->y + drmmode_crtc->scanout_height;
+		REGION_INIT(NULL, &region, &box, 1);
+		REGION_INTERSECT(NULL, &region, &region, damage);
+		REGION_UNION(NULL, &drmmode_crtc->scanout_damage,
+			     &drmmode_crtc->scanout_damage, &region);
+		/* redrawn since it went into the back buffer */
+		REGION_SUBTRACT(NULL, &drmmode_crtc->scanout_ready,
+				&drmmode_crtc->scanout_ready, &region);
+		REGION_UNINIT(NULL, &region);
+
+		drmmode_tearfree_flip(crtc);
+	}
+
+	DamageEmpty(drmmode->tearfree_damage);
+}
+
+/* CRTCs scanning out of their own TearFree buffers rather than the screen
+ * pixmap, as a mask like nv_window_belongs_to_crtc() returns.
+ */
+unsigned int
+drmmode_tearfree_crtcs(ScrnInfoPtr scrn)
+{
+	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(scrn);
+	drmmode_ptr drmmode = drmmode_from_scrn(scrn);
+	unsigned int mask = 0;
+	int i;
+
+	if (!drmmode || !drmmode->tearfree_damage)
+		return 0;
+
+	for (i = 0; i < config->num_crtc; i++) {
+		xf86CrtcPtr crtc = config->crtc[i];
+		drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
+
+		if (crtc->enabled && drmmode_crtc->scanout_width)
+			mask |= 1 << i;
+	}
+
+	return mask;
+}
+
+Bool
+drmmode_tearfree_init(ScreenPtr pScreen)
+{
+	ScrnInfoPtr scrn = xf86Screens[pScreen->myNum];
+	drmmode_ptr drmmode = drmmode_from_scrn(scrn);
+	PixmapPtr ppix = pScreen->GetScreenPixmap(pScreen);
+
+	if (!NVPTR(scrn)->tear_free)
+		return TRUE;
+
+	drmmode->tearfree_damage = DamageCreate(NULL, NULL, DamageReportNone,
+						TRUE, pScreen, NULL);
+	if (!drmmode->tearfree_damage)
+		return FALSE;
+
+	DamageRegister(&ppix->drawable, drmmode->tearfree_damage);
+	return TRUE;
+}
+
+static void
+drmmode_tearfree_fini(ScreenPtr pScreen)
+{
+	ScrnInfoPtr scrn = xf86Screens[pScreen->myNum];
+	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(scrn);
+	drmmode_ptr drmmode = drmmode_from_scrn(scrn);
+	int i, j;
+
+	if (!drmmode->tearfree_damage)
+		return;
+
+	for (i = 0; i < config->num_crtc; i++) {
+		drmmode_crtc_private_ptr drmmode_crtc =
+			config->crtc[i]->driver_private;
+
+		if (drmmode_crtc->frames)
+			xf86DrvMsgVerb(scrn->scrnIndex, X_INFO, 3,
+				       "TearFree CRTC %d: %lu flips, "
+				       "%lu bytes copied per flip\n", i,
+				       drmmode_crtc->frames,
+				       drmmode_crtc->copied /
+				       drmmode_crtc->frames);
+
+		for (j = 0; j < 2; j++)
+			drmmode_scanout_free(drmmode,
+					     &drmmode_crtc->scanout[j]);
+		drmmode_crtc->scanout_width = 0;
+		drmmode_crtc->scanout_height = 0;
+		REGION_EMPTY(NULL, &drmmode_crtc->scanout_damage);
+		REGION_EMPTY(NULL, &drmmode_crtc->scanout_prev);
+		REGION_EMPTY(NULL, &drmmode_crtc->scanout_ready);
+	}
+
+	DamageUnregister(&pScreen->GetScreenPixmap(pScreen)->drawable,
+			 drmmode->tearfree_damage);
+	DamageDestroy(drmmode->tearfree_damage);
+	drmmode->tearfree_damage = NULL;
+}
+
+static void
+drmmode_vblank_handler(int fd, unsigned int frame, unsigned int tv_sec,
+		       unsigned int tv_usec, void *event_data)
+{
+	if (NOUVEAU_IS_XV_PRESENT_EVENT(event_data)) {
+		nouveau_xv_present_handler(fd, frame, tv_sec, tv_usec,
+					   event_data);
+		return;
+	}
+
+	nouveau_dri2_vblank_handler(fd, frame, tv_sec, tv_usec, event_data);
+}
+
+static void
+drmmode_flip_handler(int fd, unsigned int frame, unsigned int tv_sec,
+		     unsigned int tv_usec, void *event_data)
+{
+	if (DRMMODE_IS_TEARFREE_EVENT(event_data)) {
+		drmmode_crtc_private_ptr crtc =
+			DRMMODE_TEARFREE_CRTC(event_data);
+		drmmode_fb_cache_ptr cache = &crtc->drmmode->fb_cache;
+
+		crtc->flip_pending = FALSE;
+		if (crtc->flip_fb) {
+			drmmode_fb_hold(cache, &crtc->scanout_fb,
+					crtc->flip_fb);
+			drmmode_fb_hold(cache, &crtc->flip_fb, 0);
+		}
+		return;
+	}
+
+	nouveau_dri2_flip_handler(fd, frame, tv_sec, tv_usec, event_data);
 }
 
 static Bool
@@ -293,20 +710,24 @@ drmmode_set_mode_major(xf86CrtcPtr crtc, DisplayModePtr mode,
 	int i;
 	int fb_id;
 	drmModeModeInfo kmode;
+	drmmode_scanout_rec old_scanout[2];
+
+	memset(old_scanout, 0, sizeof(old_scanout));
+	nouveau_dri2_vblank_reset(pScrn);
 
 	if (drmmode->fb_id == 0) {
 		unsigned int pitch =
 			pScrn->displayWidth * (pScrn->bitsPerPixel / 8);
 
-		ret = drmModeAddFB(drmmode->fd,
-				   pScrn->virtualX, pScrn->virtualY,
-				   pScrn->depth, pScrn->bitsPerPixel,
-				   pitch, pNv->scanout->handle,
-				   &drmmode->fb_id);
-		if (ret < 0) {
+		fb_id = drmmode_fb_get(&drmmode->fb_cache, pNv->scanout,
+				       pScrn->virtualX, pScrn->virtualY, pitch,
+				       pScrn->depth, pScrn->bitsPerPixel,
+				       FALSE);
+		if (!fb_id) {
 			ErrorF("failed to add fb\n");
 			return FALSE;
 		}
+		drmmode_fb_hold(&drmmode->fb_cache, &drmmode->fb_id, fb_id);
 	}
 
 	if (!xf86CrtcRotate(crtc))
@@ -336,12 +757,37 @@ drmmode_set_mode_major(xf86CrtcPtr crtc, DisplayModePtr mode,
 		fb_id = drmmode_crtc->rotate_fb_id;
 		x = 0;
 		y = 0;
+	} else
+	if (pNv->tear_free &&
+	    drmmode_tearfree_setup(crtc, mode, x, y, old_scanout)) {
+		fb_id = drmmode_crtc->scanout[drmmode_crtc->scanout_front].fb_id;
+		x = 0;
+		y = 0;
+	} else
+	if (drmmode_crtc->scanout_width) {
+		/* rotated now, the buffers go once we're off them */
+		memcpy(old_scanout, drmmode_crtc->scanout,
+		       sizeof(old_scanout));
+		memset(drmmode_crtc->scanout, 0,
+		       sizeof(drmmode_crtc->scanout));
+		drmmode_crtc->scanout_width = 0;
+		drmmode_crtc->scanout_height = 0;
 	}
 
 	ret = drmModeSetCrtc(drmmode->fd, drmmode_crtc->mode_crtc->crtc_id,
 			     fb_id, x, y, output_ids, output_count, &kmode);
 	free(output_ids);
 
+	/* any flip still in flight was overridden by the modeset */
+	if (!ret) {
+		drmmode_fb_hold(&drmmode->fb_cache, &drmmode_crtc->scanout_fb,
+				fb_id);
+		drmmode_fb_hold(&drmmode->fb_cache, &drmmode_crtc->flip_fb, 0);
+	}
+
+	for (i = 0; i < 2; i++)
+		drmmode_scanout_free(drmmode, &old_scanout[i]);
+
 	if (ret) {
 		xf86DrvMsg(crtc->scrn->scrnIndex, X_ERROR,
 			   "failed to set mode: %s", strerror(-ret));
@@ -395,9 +841,10 @@ drmmode_load_cursor_argb (xf86CrtcPtr crtc, CARD32 *image)
 	struct nouveau_bo *cursor = drmmode_crtc->cursor;
 	drmmode_ptr drmmode = drmmode_crtc->drmmode;
 
-	nouveau_bo_map(cursor, NOUVEAU_BO_WR);
+	/* only ever read by scanout, no need to wait on the GPU */
+	nv_bo_map(pNv, cursor, NOUVEAU_BO_WR | NOUVEAU_BO_NOSYNC);
 	convert_cursor(cursor->map, image, 64, nv_cursor_width(pNv));
-	nouveau_bo_unmap(cursor);
+	nv_bo_unmap(pNv, cursor);
 
 	if (drmmode_crtc->cursor_visible) {
 		drmModeSetCursor(drmmode->fd, drmmode_crtc->mode_crtc->crtc_id,
@@ -431,6 +878,7 @@ static void *
 drmmode_crtc_shadow_allocate(xf86CrtcPtr crtc, int width, int height)
 {
 	ScrnInfoPtr scrn = crtc->scrn;
+	NVPtr pNv = NVPTR(scrn);
 	drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
 	drmmode_ptr drmmode = drmmode_crtc->drmmode;
 	void *virtual;
@@ -447,7 +895,8 @@ drmmode_crtc_shadow_allocate(xf86CrtcPtr crtc, int width, int height)
 		return NULL;
 	}
 
-	ret = nouveau_bo_map(drmmode_crtc->rotate_bo, NOUVEAU_BO_RDWR);
+	ret = nv_bo_map(pNv, drmmode_crtc->rotate_bo,
+			NOUVEAU_BO_RDWR | NOUVEAU_BO_NOSYNC);
 	if (ret) {
 		xf86DrvMsg(crtc->scrn->scrnIndex, X_ERROR,
 			   "Couldn't get virtual address of shadow scanout\n");
@@ -455,16 +904,17 @@ drmmode_crtc_shadow_allocate(xf86CrtcPtr crtc, int width, int height)
 		return NULL;
 	}
 	virtual = drmmode_crtc->rotate_bo->map;
-	nouveau_bo_unmap(drmmode_crtc->rotate_bo);
-
-	ret = drmModeAddFB(drmmode->fd, width, height, crtc->scrn->depth,
-			   crtc->scrn->bitsPerPixel, drmmode_crtc->rotate_pitch,
-			   drmmode_crtc->rotate_bo->handle,
-			   &drmmode_crtc->rotate_fb_id);
-	if (ret) {
+	nv_bo_unmap(pNv, drmmode_crtc->rotate_bo);
+
+	drmmode_crtc->rotate_fb_id =
+		drmmode_fb_get(&drmmode->fb_cache, drmmode_crtc->rotate_bo,
+			       width, height, drmmode_crtc->rotate_pitch,
+			       crtc->scrn->depth, crtc->scrn->bitsPerPixel,
+			       TRUE);
+	if (!drmmode_crtc->rotate_fb_id) {
 		xf86DrvMsg(crtc->scrn->scrnIndex, X_ERROR,
 			   "Error adding FB for shadow scanout: %s\n",
-			   strerror(-ret));
+			   strerror(errno));
 		nouveau_bo_ref(NULL, &drmmode_crtc->rotate_bo);
 		return NULL;
 	}
@@ -502,7 +952,8 @@ drmmode_crtc_shadow_destroy(xf86CrtcPtr crtc, PixmapPtr rotate_pixmap, void *dat
 		FreeScratchPixmapHeader(rotate_pixmap);
 
 	if (data) {
-		drmModeRmFB(drmmode->fd, drmmode_crtc->rotate_fb_id);
+		drmmode_fb_evict(&drmmode->fb_cache, drmmode_crtc->rotate_bo,
+				 TRUE);
 		drmmode_crtc->rotate_fb_id = 0;
 		if (!pNv->NoAccel)
 			nouveau_bo_ref(NULL, &drmmode_crtc->rotate_bo);
@@ -556,6 +1007,9 @@ drmmode_crtc_init(ScrnInfoPtr pScrn, drmmode_ptr drmmode, int num)
 	drmmode_crtc->mode_crtc = drmModeGetCrtc(drmmode->fd,
 						 drmmode->mode_res->crtcs[num]);
 	drmmode_crtc->drmmode = drmmode;
+	REGION_NULL(NULL, &drmmode_crtc->scanout_damage);
+	REGION_NULL(NULL, &drmmode_crtc->scanout_prev);
+	REGION_NULL(NULL, &drmmode_crtc->scanout_ready);
 
 	ret = nouveau_bo_new(pNv->dev, NOUVEAU_BO_VRAM | NOUVEAU_BO_MAP, 0,
 			     64*64*4, &drmmode_crtc->cursor);
@@ -566,17 +1020,105 @@ drmmode_crtc_init(ScrnInfoPtr pScrn, drmmode_ptr drmmode, int num)
 	return;
 }
 
+static uint32_t
+drmmode_output_edid_blob_id(drmmode_output_private_ptr drmmode_output)
+{
+	drmModeConnectorPtr koutput = drmmode_output->mode_output;
+	drmmode_ptr drmmode = drmmode_output->drmmode;
+	drmModePropertyPtr props;
+	int i;
+
+	if (!drmmode_output->edid_prop_id) {
+		for (i = 0; i < koutput->count_props; i++) {
+			props = drmModeGetProperty(drmmode->fd,
+						   koutput->props[i]);
+			if (!props)
+				continue;
+
+			if ((props->flags & DRM_MODE_PROP_BLOB) &&
+			    !strcmp(props->name, "EDID"))
+				drmmode_output->edid_prop_id = props->prop_id;
+			drmModeFreeProperty(props);
+		}
+	}
+
+	for (i = 0; i < koutput->count_props; i++) {
+		if (koutput->props[i] == drmmode_output->edid_prop_id)
+			return koutput->prop_values[i];
+	}
+
+	return 0;
+}
+
+/* Whether a change on the connector is guaranteed to raise a uevent.
+ * Analog and panel connectors are only noticed by load detection or
+ * polling, if at all, so they always go to the hardware.
+ */
+static Bool
+drmmode_hotplug_tracked(drmmode_ptr drmmode, drmModeConnectorPtr koutput)
+{
+#ifdef HAVE_LIBUDEV
+	if (!drmmode->uevent_monitor)
+		return FALSE;
+
+	switch (koutput->connector_type) {
+	case DRM_MODE_CONNECTOR_DVID:
+	case DRM_MODE_CONNECTOR_HDMIA:
+	case DRM_MODE_CONNECTOR_HDMIB:
+	case DRM_MODE_CONNECTOR_DisplayPort:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+#else
+	return FALSE;
+#endif
+}
+
+/* Asks the kernel for a fresh copy of the connector, which may mean a DDC
+ * read.  Unless uevents tell us when the connector changes, the result is
+ * only good for this one query.  Returns whether anything RandR cares
+ * about changed.
+ */
+static Bool
+drmmode_output_probe(drmmode_output_private_ptr drmmode_output)
+{
+	drmmode_ptr drmmode = drmmode_output->drmmode;
+	drmModeConnectorPtr old = drmmode_output->mode_output, koutput;
+	uint32_t old_edid = 0;
+	Bool changed;
+
+	koutput = drmModeGetConnector(drmmode->fd, drmmode_output->output_id);
+	if (!koutput)
+		return FALSE;
+
+	if (old)
+		old_edid = drmmode_output_edid_blob_id(drmmode_output);
+	drmmode_output->mode_output = koutput;
+	drmmode_output->epoch++;
+	drmmode_output->probed = drmmode_hotplug_tracked(drmmode, koutput);
+
+	changed = !old || old->connection != koutput->connection ||
+		  old->count_modes != koutput->count_modes ||
+		  old_edid != drmmode_output_edid_blob_id(drmmode_output);
+	if (!changed && koutput->count_modes)
+		changed = memcmp(old->modes, koutput->modes,
+				 koutput->count_modes *
+				 sizeof(drmModeModeInfo)) != 0;
+
+	drmModeFreeConnector(old);
+	return changed;
+}
+
 static xf86OutputStatus
 drmmode_output_detect(xf86OutputPtr output)
 {
-	/* go to the hw and retrieve a new output struct */
 	drmmode_output_private_ptr drmmode_output = output->driver_private;
-	drmmode_ptr drmmode = drmmode_output->drmmode;
 	xf86OutputStatus status;
-	drmModeFreeConnector(drmmode_output->mode_output);
 
-	drmmode_output->mode_output =
-		drmModeGetConnector(drmmode->fd, drmmode_output->output_id);
+	/* go to the hw unless the last probe is still known to be good */
+	if (!drmmode_output->probed)
+		drmmode_output_probe(drmmode_output);
 
 	switch (drmmode_output->mode_output->connection) {
 	case DRM_MODE_CONNECTED:
@@ -611,29 +1153,35 @@ drmmode_output_get_modes(xf86OutputPtr output)
 	drmmode_ptr drmmode = drmmode_output->drmmode;
 	int i;
 	DisplayModePtr Modes = NULL, Mode;
-	drmModePropertyPtr props;
+	drmModePropertyBlobPtr blob = NULL;
 	xf86MonPtr ddc_mon = NULL;
+	uint32_t blob_id;
 
-	/* look for an EDID property */
-	for (i = 0; i < koutput->count_props; i++) {
-		props = drmModeGetProperty(drmmode->fd, koutput->props[i]);
-		if (!props || !(props->flags & DRM_MODE_PROP_BLOB))
-			continue;
-
-		if (!strcmp(props->name, "EDID")) {
-			if (drmmode_output->edid_blob)
-				drmModeFreePropertyBlob(drmmode_output->edid_blob);
-			drmmode_output->edid_blob =
-				drmModeGetPropertyBlob(drmmode->fd,
-						       koutput->prop_values[i]);
+	/* The EDID only needs another look after the connector has been
+	 * probed again, and only needs parsing again if it changed.
+	 */
+	if (drmmode_output->edid_epoch != drmmode_output->epoch ||
+	    !output->MonInfo) {
+		drmmode_output->edid_epoch = drmmode_output->epoch;
+
+		blob_id = drmmode_output_edid_blob_id(drmmode_output);
+		if (blob_id)
+			blob = drmModeGetPropertyBlob(drmmode->fd, blob_id);
+
+		if (!blob || !drmmode_output->edid_blob || !output->MonInfo ||
+		    blob->length != drmmode_output->edid_blob->length ||
+		    memcmp(blob->data, drmmode_output->edid_blob->data,
+			   blob->length)) {
+			if (blob)
+				ddc_mon = xf86InterpretEDID(
+					output->scrn->scrnIndex, blob->data);
+			xf86OutputSetEDID(output, ddc_mon);
 		}
-		drmModeFreeProperty(props);
-	}
 
-	if (drmmode_output->edid_blob)
-		ddc_mon = xf86InterpretEDID(output->scrn->scrnIndex,
-					    drmmode_output->edid_blob->data);
-	xf86OutputSetEDID(output, ddc_mon);
+		if (drmmode_output->edid_blob)
+			drmModeFreePropertyBlob(drmmode_output->edid_blob);
+		drmmode_output->edid_blob = blob;
+	}
 
 	/* modes should already be available */
 	for (i = 0; i < koutput->count_modes; i++) {
@@ -869,11 +1417,8 @@ drmmode_output_get_property(xf86OutputPtr output, Atom property)
 	uint32_t value;
 	int err, i;
 
-	if (output->scrn->vtSema) {
-		drmModeFreeConnector(drmmode_output->mode_output);
-		drmmode_output->mode_output =
-			drmModeGetConnector(drmmode->fd, drmmode_output->output_id);
-	}
+	if (output->scrn->vtSema)
+		drmmode_output_probe(drmmode_output);
 
 	for (i = 0; i < drmmode_output->num_props; i++) {
 		drmmode_prop_ptr p = &drmmode_output->props[i];
@@ -1071,7 +1616,7 @@ drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
 	drmmode_crtc_private_ptr
 		    drmmode_crtc = xf86_config->crtc[0]->driver_private;
 	drmmode_ptr drmmode = drmmode_crtc->drmmode;
-	uint32_t old_width, old_height, old_pitch, old_fb_id;
+	uint32_t old_width, old_height, old_pitch, fb_id;
 	struct nouveau_bo *old_bo = NULL;
 	int ret, i, pitch;
 	PixmapPtr ppix;
@@ -1084,7 +1629,6 @@ drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
 	old_width = scrn->virtualX;
 	old_height = scrn->virtualY;
 	old_pitch = scrn->displayWidth;
-	old_fb_id = drmmode->fb_id;
 	nouveau_bo_ref(pNv->scanout, &old_bo);
 	nouveau_bo_ref(NULL, &pNv->scanout);
 
@@ -1099,15 +1643,16 @@ drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
 	scrn->virtualY = height;
 	scrn->displayWidth = pitch / (scrn->bitsPerPixel >> 3);
 
-	nouveau_bo_map(pNv->scanout, NOUVEAU_BO_RDWR);
+	nv_bo_map(pNv, pNv->scanout, NOUVEAU_BO_RDWR | NOUVEAU_BO_NOSYNC);
 
-	ret = drmModeAddFB(drmmode->fd, width, height, scrn->depth,
-			   scrn->bitsPerPixel, pitch, pNv->scanout->handle,
-			   &drmmode->fb_id);
-	if (ret) {
-		nouveau_bo_unmap(pNv->scanout);
+	fb_id = drmmode_fb_get(&drmmode->fb_cache, pNv->scanout, width,
+			       height, pitch, scrn->depth,
+			       scrn->bitsPerPixel, FALSE);
+	if (!fb_id) {
+		nv_bo_unmap(pNv, pNv->scanout);
 		goto fail;
 	}
+	drmmode_fb_hold(&drmmode->fb_cache, &drmmode->fb_id, fb_id);
 
 	if (pNv->ShadowPtr) {
 		free(pNv->ShadowPtr);
@@ -1124,20 +1669,27 @@ drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
 #if GET_ABI_MAJOR(ABI_VIDEODRV_VERSION) < 9
 	scrn->pixmapPrivate.ptr = ppix->devPrivate.ptr;
 #endif
-	nouveau_bo_unmap(pNv->scanout);
+	nv_bo_unmap(pNv, pNv->scanout);
 
 	for (i = 0; i < xf86_config->num_crtc; i++) {
 		xf86CrtcPtr crtc = xf86_config->crtc[i];
-
-		if (!crtc->enabled)
+		drmmode_crtc_private_ptr priv = crtc->driver_private;
+
+		/* an unused CRTC may still be bound to the old buffer, it
+		 * may as well go off when that goes
+		 */
+		if (!crtc->enabled) {
+			drmmode_fb_hold(&drmmode->fb_cache, &priv->scanout_fb,
+					0);
+			drmmode_fb_hold(&drmmode->fb_cache, &priv->flip_fb, 0);
 			continue;
+		}
 
 		drmmode_set_mode_major(crtc, &crtc->mode,
 				       crtc->rotation, crtc->x, crtc->y);
 	}
 
-	if (old_fb_id)
-		drmModeRmFB(drmmode->fd, old_fb_id);
+	drmmode_fb_evict(&drmmode->fb_cache, old_bo, FALSE);
 	nouveau_bo_ref(NULL, &old_bo);
 
 	return TRUE;
@@ -1147,7 +1699,6 @@ drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
 	scrn->virtualX = old_width;
 	scrn->virtualY = old_height;
 	scrn->displayWidth = old_pitch;
-	drmmode->fb_id = old_fb_id;
 
 	return FALSE;
 }
@@ -1161,9 +1712,10 @@ Bool drmmode_pre_init(ScrnInfoPtr pScrn, int fd, int cpp)
 	drmmode_ptr drmmode;
 	int i;
 
-	drmmode = xnfalloc(sizeof *drmmode);
+	drmmode = xnfcalloc(1, sizeof *drmmode);
 	drmmode->fd = fd;
 	drmmode->fb_id = 0;
+	drmmode->fb_cache.fd = fd;
 
 	xf86CrtcConfigInit(pScrn, &drmmode_xf86crtc_config_funcs);
 
@@ -1208,6 +1760,7 @@ drmmode_remove_fb(ScrnInfoPtr pScrn)
 	xf86CrtcPtr crtc = NULL;
 	drmmode_crtc_private_ptr drmmode_crtc;
 	drmmode_ptr drmmode;
+	int i;
 
 	if (config)
 		crtc = config->crtc[0];
@@ -1217,9 +1770,17 @@ drmmode_remove_fb(ScrnInfoPtr pScrn)
 	drmmode_crtc = crtc->driver_private;
 	drmmode = drmmode_crtc->drmmode;
 
-	if (drmmode->fb_id)
-		drmModeRmFB(drmmode->fd, drmmode->fb_id);
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		   "Framebuffer cache: %lu hits, %lu AddFB calls\n",
+		   drmmode->fb_cache.hits, drmmode->fb_cache.adds);
+
+	drmmode_fb_cache_fini(&drmmode->fb_cache);
 	drmmode->fb_id = 0;
+	for (i = 0; i < config->num_crtc; i++) {
+		drmmode_crtc = config->crtc[i]->driver_private;
+		drmmode_crtc->scanout_fb = 0;
+		drmmode_crtc->flip_fb = 0;
+	}
 }
 
 int
@@ -1235,59 +1796,198 @@ drmmode_cursor_init(ScreenPtr pScreen)
 	return xf86_cursors_init(pScreen, size, size, flags);
 }
 
-Bool
-drmmode_page_flip(DrawablePtr draw, PixmapPtr back, void *priv)
+/* Queues a flip to back on every enabled CRTC, each of which delivers its
+ * own completion event with priv.  Async flips don't wait for vblank.
+ * Returns the number of flips queued, 0 leaves every CRTC on the old front
+ * buffer.  A CRTC refusing the flip after others took it is modeset onto
+ * back instead, so all of them end up showing it.
+ */
+int
+drmmode_page_flip(DrawablePtr draw, PixmapPtr back, void *priv, Bool async)
 {
 	ScrnInfoPtr scrn = xf86Screens[draw->pScreen->myNum];
 	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(scrn);
 	drmmode_crtc_private_ptr crtc = config->crtc[0]->driver_private;
 	drmmode_ptr mode = crtc->drmmode;
-	int ret, i, old_fb_id;
-
-	old_fb_id = mode->fb_id;
-	ret = drmModeAddFB(mode->fd, scrn->virtualX, scrn->virtualY,
-			   scrn->depth, scrn->bitsPerPixel,
-			   scrn->displayWidth * scrn->bitsPerPixel / 8,
-			   nouveau_pixmap_bo(back)->handle, &mode->fb_id);
-	if (ret) {
+	uint32_t fb_id;
+	uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT;
+	int ret, i, queued = 0;
+
+	fb_id = drmmode_fb_get(&mode->fb_cache, nouveau_pixmap_bo(back),
+			       scrn->virtualX, scrn->virtualY,
+			       scrn->displayWidth * scrn->bitsPerPixel / 8,
+			       scrn->depth, scrn->bitsPerPixel, FALSE);
+	if (!fb_id) {
 		xf86DrvMsg(scrn->scrnIndex, X_WARNING,
 			   "add fb failed: %s\n", strerror(errno));
-		return FALSE;
+		return 0;
 	}
 
+#ifdef DRM_MODE_PAGE_FLIP_ASYNC
+	if (async)
+		flags |= DRM_MODE_PAGE_FLIP_ASYNC;
+#endif
+
 	for (i = 0; i < config->num_crtc; i++) {
-		crtc = config->crtc[i]->driver_private;
+		xf86CrtcPtr xcrtc = config->crtc[i];
+
+		crtc = xcrtc->driver_private;
 
-		if (!config->crtc[i]->enabled)
+		if (!xcrtc->enabled)
 			continue;
 
 		ret = drmModePageFlip(mode->fd, crtc->mode_crtc->crtc_id,
-				      mode->fb_id, 0, priv);
-		if (ret) {
-			xf86DrvMsg(scrn->scrnIndex, X_WARNING,
-				   "flip queue failed: %s\n", strerror(errno));
-			return FALSE;
+				      fb_id, flags, priv);
+		if (!ret) {
+			/* the old front buffer stays held by the CRTCs until
+			 * drmmode_flip_complete()
+			 */
+			if (!queued++)
+				drmmode_fb_hold(&mode->fb_cache, &mode->fb_id,
+						fb_id);
+			drmmode_fb_hold(&mode->fb_cache, &crtc->flip_fb,
+					fb_id);
+			continue;
 		}
+
+		xf86DrvMsg(scrn->scrnIndex, X_WARNING,
+			   "flip queue failed: %s\n", strerror(errno));
+
+		/* With nothing queued yet the whole swap becomes a blit */
+		if (!queued)
+			break;
+
+		/* The caller exchanges the buffers once the queued flips
+		 * land, and those can't be taken back, so this CRTC has to
+		 * show the new front buffer too: set it there directly.
+		 */
+		if (!drmmode_set_mode_major(xcrtc, &xcrtc->mode,
+					    xcrtc->rotation, xcrtc->x,
+					    xcrtc->y))
+			xf86DrvMsg(scrn->scrnIndex, X_ERROR,
+				   "CRTC %d stuck on the old front buffer\n",
+				   i);
 	}
 
-	drmModeRmFB(mode->fd, old_fb_id);
+	return queued;
+}
 
-	return TRUE;
+/* Every flip queued by drmmode_page_flip() has landed, the CRTCs have let
+ * go of the old front buffer.
+ */
+void
+drmmode_flip_complete(ScrnInfoPtr scrn)
+{
+	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(scrn);
+	drmmode_ptr mode = drmmode_from_scrn(scrn);
+	int i;
+
+	for (i = 0; i < config->num_crtc; i++) {
+		drmmode_crtc_private_ptr crtc = config->crtc[i]->driver_private;
+
+		if (!crtc->flip_fb)
+			continue;
+
+		drmmode_fb_hold(&mode->fb_cache, &crtc->scanout_fb,
+				crtc->flip_fb);
+		drmmode_fb_hold(&mode->fb_cache, &crtc->flip_fb, 0);
+	}
 }
 
 #ifdef HAVE_LIBUDEV
+#define DRMMODE_HOTPLUG_DEBOUNCE 100 /* ms */
+
+/* Reprobes the connectors a burst of uevents was about, and only bothers
+ * RandR if one of them actually changed.  The probes leave the cache
+ * fresh, so RandR's own detect calls don't touch the hardware again.
+ */
+static CARD32
+drmmode_hotplug_timer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+	ScrnInfoPtr scrn = arg;
+	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(scrn);
+	drmmode_ptr drmmode = drmmode_from_scrn(scrn);
+	Bool changed = FALSE;
+	int i;
+
+	for (i = 0; i < config->num_output; i++) {
+		drmmode_output_private_ptr drmmode_output =
+			config->output[i]->driver_private;
+
+		if (drmmode->hotplug_connector &&
+		    drmmode->hotplug_connector != drmmode_output->output_id)
+			continue;
+
+		if (drmmode_output_probe(drmmode_output))
+			changed = TRUE;
+	}
+
+	drmmode->hotplug_pending = FALSE;
+	drmmode->hotplug_connector = 0;
+
+	if (changed) {
+		drmmode->hotplug_query = TRUE;
+		RRGetInfo(screenInfo.screens[scrn->scrnIndex], TRUE);
+		drmmode->hotplug_query = FALSE;
+	}
+	return 0;
+}
+
+/* RandR only calls down here when a client asks for the outputs to be
+ * probed, and the client means it: forget what the uevents vouched for.
+ */
+static Bool
+drmmode_rr_get_info(ScreenPtr pScreen, Rotation *rotations)
+{
+	ScrnInfoPtr scrn = xf86Screens[pScreen->myNum];
+	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(scrn);
+	drmmode_ptr drmmode = drmmode_from_scrn(scrn);
+	int i;
+
+	if (!drmmode->hotplug_query) {
+		for (i = 0; i < config->num_output; i++) {
+			drmmode_output_private_ptr drmmode_output =
+				config->output[i]->driver_private;
+
+			drmmode_output->probed = FALSE;
+		}
+	}
+
+	return drmmode->rr_get_info(pScreen, rotations);
+}
+
 static void
 drmmode_handle_uevents(ScrnInfoPtr scrn)
 {
 	drmmode_ptr drmmode = drmmode_from_scrn(scrn);
 	struct udev_device *dev;
 
+	const char *connector;
+	uint32_t id = 0;
+
 	dev = udev_monitor_receive_device(drmmode->uevent_monitor);
 	if (!dev)
 		return;
 
-	RRGetInfo(screenInfo.screens[scrn->scrnIndex], TRUE);
+	/* newer kernels say which connector the event is about */
+	connector = udev_device_get_property_value(dev, "CONNECTOR");
+	if (connector)
+		id = strtoul(connector, NULL, 0);
 	udev_device_unref(dev);
+
+	if (!drmmode->hotplug_pending)
+		drmmode->hotplug_connector = id;
+	else
+	if (drmmode->hotplug_connector != id)
+		drmmode->hotplug_connector = 0;
+	drmmode->hotplug_pending = TRUE;
+
+	/* hotplug tends to come in bursts, wait for it to settle */
+	drmmode->hotplug_timer = TimerSet(drmmode->hotplug_timer, 0,
+					  DRMMODE_HOTPLUG_DEBOUNCE,
+					  drmmode_hotplug_timer, scrn);
+	if (!drmmode->hotplug_timer)
+		drmmode_hotplug_timer(NULL, 0, scrn);
 }
 #endif
 
@@ -1322,16 +2022,52 @@ drmmode_uevent_init(ScrnInfoPtr scrn)
 #endif
 }
 
+static void
+drmmode_rr_init(ScreenPtr pScreen)
+{
+#ifdef HAVE_LIBUDEV
+	drmmode_ptr drmmode = drmmode_from_scrn(xf86Screens[pScreen->myNum]);
+	rrScrPrivPtr rp = rrGetScrPriv(pScreen);
+
+	if (!rp || !rp->rrGetInfo)
+		return;
+
+	drmmode->rr_get_info = rp->rrGetInfo;
+	rp->rrGetInfo = drmmode_rr_get_info;
+#endif
+}
+
+static void
+drmmode_rr_fini(ScreenPtr pScreen)
+{
+#ifdef HAVE_LIBUDEV
+	drmmode_ptr drmmode = drmmode_from_scrn(xf86Screens[pScreen->myNum]);
+	rrScrPrivPtr rp = rrGetScrPriv(pScreen);
+
+	if (!drmmode->rr_get_info)
+		return;
+
+	if (rp && rp->rrGetInfo == drmmode_rr_get_info)
+		rp->rrGetInfo = drmmode->rr_get_info;
+	drmmode->rr_get_info = NULL;
+#endif
+}
+
 static void
 drmmode_uevent_fini(ScrnInfoPtr scrn)
 {
 #ifdef HAVE_LIBUDEV
 	drmmode_ptr drmmode = drmmode_from_scrn(scrn);
 
+	TimerFree(drmmode->hotplug_timer);
+	drmmode->hotplug_timer = NULL;
+	drmmode->hotplug_pending = FALSE;
+
 	if (drmmode->uevent_monitor) {
 		struct udev *u = udev_monitor_get_udev(drmmode->uevent_monitor);
 
 		udev_monitor_unref(drmmode->uevent_monitor);
+		drmmode->uevent_monitor = NULL;
 		udev_unref(u);
 	}
 #endif
@@ -1363,10 +2099,12 @@ drmmode_screen_init(ScreenPtr pScreen)
 	drmmode_ptr drmmode = drmmode_from_scrn(scrn);
 
 	drmmode_uevent_init(scrn);
+	drmmode_rr_init(pScreen);
 
 	/* Plug in a vblank event handler */
 	drmmode->event_context.version = DRM_EVENT_CONTEXT_VERSION;
-	drmmode->event_context.vblank_handler = nouveau_dri2_vblank_handler;
+	drmmode->event_context.vblank_handler = drmmode_vblank_handler;
+	drmmode->event_context.page_flip_handler = drmmode_flip_handler;
 	AddGeneralSocket(drmmode->fd);
 
 	/* Register a wakeup handler to get informed on DRM events */
@@ -1379,5 +2117,7 @@ drmmode_screen_fini(ScreenPtr pScreen)
 {
 	ScrnInfoPtr scrn = xf86Screens[pScreen->myNum];
 
+	drmmode_tearfree_fini(pScreen);
+	drmmode_rr_fini(pScreen);
 	drmmode_uevent_fini(scrn);
 }
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2009 Nouveau Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "xf86drmMode.h"
+#include "nouveau_bo.h"
+#include "drmmode_fb.h"
+
+static drmmode_fb_ptr
+drmmode_fb_find(drmmode_fb_cache_ptr cache, uint32_t fb_id)
+{
+	int i;
+
+	if (!fb_id)
+		return NULL;
+
+	for (i = 0; i < DRMMODE_FB_CACHE_SIZE; i++) {
+		if (cache->entry[i].bo && cache->entry[i].fb_id == fb_id)
+			return &cache->entry[i];
+	}
+
+	return NULL;
+}
+
+static void
+drmmode_fb_remove(drmmode_fb_cache_ptr cache, drmmode_fb_ptr fb)
+{
+	drmModeRmFB(cache->fd, fb->fb_id);
+	nouveau_bo_ref(NULL, &fb->bo);
+	memset(fb, 0, sizeof(*fb));
+}
+
+uint32_t
+drmmode_fb_get(drmmode_fb_cache_ptr cache, struct nouveau_bo *bo,
+	       int width, int height, int pitch, int depth, int bpp,
+	       Bool pinned)
+{
+	drmmode_fb_ptr fb, victim = NULL;
+	int i, ret;
+
+	for (i = 0; i < DRMMODE_FB_CACHE_SIZE; i++) {
+		fb = &cache->entry[i];
+
+		if (fb->bo == bo && fb->width == width &&
+		    fb->height == height && fb->pitch == pitch &&
+		    fb->depth == depth && fb->bpp == bpp) {
+			fb->stamp = ++cache->stamp;
+			fb->pinned |= pinned;
+			fb->released = FALSE;
+			cache->hits++;
+			return fb->fb_id;
+		}
+
+		if (fb->pinned || fb->holders)
+			continue;
+
+		if (!victim || (victim->bo && (!fb->bo ||
+					       fb->stamp < victim->stamp)))
+			victim = fb;
+	}
+
+	if (!victim)
+		return 0;
+	if (victim->bo)
+		drmmode_fb_remove(cache, victim);
+
+	ret = drmModeAddFB(cache->fd, width, height, depth, bpp, pitch,
+			   bo->handle, &victim->fb_id);
+	if (ret) {
+		victim->fb_id = 0;
+		return 0;
+	}
+
+	nouveau_bo_ref(bo, &victim->bo);
+	victim->width = width;
+	victim->height = height;
+	victim->pitch = pitch;
+	victim->depth = depth;
+	victim->bpp = bpp;
+	victim->pinned = pinned;
+	victim->stamp = ++cache->stamp;
+	cache->adds++;
+	return victim->fb_id;
+}
+
+void
+drmmode_fb_evict(drmmode_fb_cache_ptr cache, struct nouveau_bo *bo,
+		 Bool unpin)
+{
+	int i;
+
+	for (i = 0; i < DRMMODE_FB_CACHE_SIZE; i++) {
+		drmmode_fb_ptr fb = &cache->entry[i];
+
+		if (!bo || fb->bo != bo)
+			continue;
+		if (fb->pinned && !unpin)
+			continue;
+
+		/* RmFB on a framebuffer being scanned out turns the CRTC
+		 * off, so that waits for its last flip away from it.
+		 */
+		if (fb->holders) {
+			fb->pinned = FALSE;
+			fb->released = TRUE;
+			continue;
+		}
+		drmmode_fb_remove(cache, fb);
+	}
+}
+
+/* Points holder (a CRTC's current or pending framebuffer, or the front
+ * buffer) at fb_id, 0 for none, and removes whatever it held before if
+ * that was evicted in the meantime.
+ */
+void
+drmmode_fb_hold(drmmode_fb_cache_ptr cache, uint32_t *holder, uint32_t fb_id)
+{
+	drmmode_fb_ptr old, fb;
+
+	if (*holder == fb_id)
+		return;
+
+	old = drmmode_fb_find(cache, *holder);
+	fb = drmmode_fb_find(cache, fb_id);
+
+	if (fb)
+		fb->holders++;
+	*holder = fb_id;
+
+	if (old && !--old->holders && old->released)
+		drmmode_fb_remove(cache, old);
+}
+
+void
+drmmode_fb_cache_fini(drmmode_fb_cache_ptr cache)
+{
+	int i;
+
+	for (i = 0; i < DRMMODE_FB_CACHE_SIZE; i++) {
+		if (cache->entry[i].bo)
+			drmmode_fb_remove(cache, &cache->entry[i]);
+	}
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2009 Nouveau Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DRMMODE_FB_H__
+#define __DRMMODE_FB_H__
+
+/* KMS framebuffer objects are cached per buffer, so that flipping between
+ * the same two or three buffers doesn't cost an AddFB/RmFB pair per frame.
+ * The cache holds a reference on each buffer, entries go away when the
+ * buffer's last pixmap is destroyed or they're the least recently used.
+ *
+ * An entry is never removed while something still scans out of it: every
+ * CRTC records the framebuffer it shows and the one it's flipping to, and
+ * the front buffer is recorded too, through drmmode_fb_hold().  Evicting
+ * an entry that's held only marks it, it goes once the last holder lets
+ * go.  Pinned entries (rotation shadows, TearFree buffers) are only ever
+ * evicted explicitly.
+ *
+ * Nothing here needs the server's headers, so fbcache_bench builds it on
+ * its own.
+ */
+
+#include <stdint.h>
+#include <X11/Xdefs.h>
+
+struct nouveau_bo;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define DRMMODE_FB_CACHE_SIZE 16
+
+typedef struct {
+	struct nouveau_bo *bo;
+	uint32_t fb_id;
+	int width;
+	int height;
+	int pitch;
+	int depth;
+	int bpp;
+	Bool pinned;
+	Bool released; /* evicted while held, goes with its last holder */
+	int holders;
+	unsigned long stamp;
+} drmmode_fb_rec, *drmmode_fb_ptr;
+
+typedef struct {
+	int fd;
+	drmmode_fb_rec entry[DRMMODE_FB_CACHE_SIZE];
+	unsigned long stamp;
+	unsigned long hits;
+	unsigned long adds;
+} drmmode_fb_cache_rec, *drmmode_fb_cache_ptr;
+
+uint32_t drmmode_fb_get(drmmode_fb_cache_ptr cache, struct nouveau_bo *bo,
+			int width, int height, int pitch, int depth, int bpp,
+			Bool pinned);
+void drmmode_fb_evict(drmmode_fb_cache_ptr cache, struct nouveau_bo *bo,
+		      Bool unpin);
+void drmmode_fb_hold(drmmode_fb_cache_ptr cache, uint32_t *holder,
+		     uint32_t fb_id);
+void drmmode_fb_cache_fini(drmmode_fb_cache_ptr cache);
+
+#endif
@@ -0,0 +1,386 @@
+/*
+ * Copyright 2009 Nouveau Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Checks and flip-rate benchmark of the KMS framebuffer cache
+ * (drmmode_fb.c) against a stubbed KMS layer.  The stubs keep track of
+ * which framebuffers the "CRTCs" are really scanning out, and fail any
+ * RmFB on one of those, the way the kernel would turn the CRTC off.
+ * Flips are driven the same way drmmode_page_flip() and
+ * drmmode_flip_complete() drive them.
+ *
+ * usage: fbcache_bench [flips [buffers]]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xf86drmMode.h"
+#include "nouveau_bo.h"
+#include "drmmode_fb.h"
+
+#define NCRTC		2
+#define MAX_FB		1024
+#define MAX_BO		64
+
+struct test_bo {
+	struct nouveau_bo base;
+	int refs;
+};
+
+/* the stubbed kernel */
+static Bool fb_live[MAX_FB];
+static uint32_t fb_next = 1;
+static uint32_t kms_shown[NCRTC];
+static unsigned long kms_adds, kms_rms, kms_crtc_off;
+
+static struct test_bo bos[MAX_BO];
+static int failures;
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: check failed: %s\n",		\
+			__FILE__, __LINE__, #cond);			\
+		failures++;						\
+	}								\
+} while (0)
+
+int
+drmModeAddFB(int fd, uint32_t width, uint32_t height, uint8_t depth,
+	     uint8_t bpp, uint32_t pitch, uint32_t bo_handle,
+	     uint32_t *buf_id)
+{
+	if (fb_next >= MAX_FB)
+		fb_next = 1;
+	while (fb_live[fb_next])
+		fb_next++;
+
+	fb_live[fb_next] = TRUE;
+	*buf_id = fb_next++;
+	kms_adds++;
+	return 0;
+}
+
+int
+drmModeRmFB(int fd, uint32_t buffer_id)
+{
+	int i;
+
+	if (buffer_id >= MAX_FB || !fb_live[buffer_id]) {
+		fprintf(stderr, "RmFB of unknown framebuffer %u\n",
+			buffer_id);
+		failures++;
+		return -1;
+	}
+
+	for (i = 0; i < NCRTC; i++) {
+		if (kms_shown[i] == buffer_id) {
+			kms_shown[i] = 0;
+			kms_crtc_off++;
+		}
+	}
+
+	fb_live[buffer_id] = FALSE;
+	kms_rms++;
+	return 0;
+}
+
+int
+nouveau_bo_ref(struct nouveau_bo *ref, struct nouveau_bo **pbo)
+{
+	if (ref)
+		((struct test_bo *)ref)->refs++;
+	if (*pbo)
+		((struct test_bo *)*pbo)->refs--;
+	*pbo = ref;
+	return 0;
+}
+
+/* the driver side, as drmmode_display.c holds the cache */
+struct test_mode {
+	drmmode_fb_cache_rec cache;
+	uint32_t front;
+	uint32_t scanout_fb[NCRTC];
+	uint32_t flip_fb[NCRTC];
+};
+
+static uint32_t
+test_fb(struct test_mode *m, int i, Bool pinned)
+{
+	return drmmode_fb_get(&m->cache, &bos[i].base, 1920, 1080,
+			      1920 * 4, 24, 32, pinned);
+}
+
+static void
+test_modeset(struct test_mode *m, int bo)
+{
+	uint32_t fb_id = test_fb(m, bo, FALSE);
+	int i;
+
+	drmmode_fb_hold(&m->cache, &m->front, fb_id);
+	for (i = 0; i < NCRTC; i++) {
+		kms_shown[i] = fb_id;
+		drmmode_fb_hold(&m->cache, &m->scanout_fb[i], fb_id);
+		drmmode_fb_hold(&m->cache, &m->flip_fb[i], 0);
+	}
+}
+
+static Bool
+test_flip_queue(struct test_mode *m, int bo)
+{
+	uint32_t fb_id = test_fb(m, bo, FALSE);
+	int i;
+
+	if (!fb_id)
+		return FALSE;
+
+	drmmode_fb_hold(&m->cache, &m->front, fb_id);
+	for (i = 0; i < NCRTC; i++)
+		drmmode_fb_hold(&m->cache, &m->flip_fb[i], fb_id);
+	return TRUE;
+}
+
+static void
+test_flip_complete(struct test_mode *m)
+{
+	int i;
+
+	for (i = 0; i < NCRTC; i++) {
+		kms_shown[i] = m->flip_fb[i];
+		drmmode_fb_hold(&m->cache, &m->scanout_fb[i], m->flip_fb[i]);
+		drmmode_fb_hold(&m->cache, &m->flip_fb[i], 0);
+	}
+}
+
+static void
+test_init(struct test_mode *m)
+{
+	int i;
+
+	memset(m, 0, sizeof(*m));
+	memset(fb_live, 0, sizeof(fb_live));
+	memset(kms_shown, 0, sizeof(kms_shown));
+	kms_adds = kms_rms = kms_crtc_off = 0;
+	for (i = 0; i < MAX_BO; i++) {
+		memset(&bos[i], 0, sizeof(bos[i]));
+		bos[i].base.handle = i + 1;
+		bos[i].refs = 1;
+	}
+}
+
+static void
+test_fini(struct test_mode *m)
+{
+	int i;
+
+	drmmode_fb_cache_fini(&m->cache);
+	for (i = 0; i < MAX_FB; i++)
+		CHECK(!fb_live[i]);
+	for (i = 0; i < MAX_BO; i++)
+		CHECK(bos[i].refs == 1);
+}
+
+/* Flipping between a few buffers settles down to no AddFB/RmFB at all. */
+static void
+test_steady_state(void)
+{
+	struct test_mode m;
+	int i;
+
+	test_init(&m);
+	test_modeset(&m, 0);
+	for (i = 0; i < 3; i++) {
+		test_flip_queue(&m, 1 + i % 2);
+		test_flip_complete(&m);
+	}
+
+	kms_adds = kms_rms = 0;
+	for (i = 0; i < 1000; i++) {
+		test_flip_queue(&m, i % 3);
+		test_flip_complete(&m);
+	}
+	CHECK(kms_adds == 0);
+	CHECK(kms_rms == 0);
+	CHECK(m.cache.adds == 3);
+	test_fini(&m);
+}
+
+/* A full cache gives up its least recently used entry, never one that's
+ * pinned, scanned out, or being flipped to.
+ */
+static void
+test_lru(void)
+{
+	struct test_mode m;
+	uint32_t first, pinned, fb_id;
+	int i;
+
+	test_init(&m);
+	test_modeset(&m, 0);
+	pinned = test_fb(&m, 1, TRUE);
+	first = test_fb(&m, 2, FALSE);
+	for (i = 3; i < DRMMODE_FB_CACHE_SIZE; i++)
+		CHECK(test_fb(&m, i, FALSE));
+	CHECK(kms_rms == 0);
+
+	/* bo 2 is the oldest one that can go */
+	fb_id = test_fb(&m, DRMMODE_FB_CACHE_SIZE, FALSE);
+	CHECK(fb_id);
+	CHECK(!fb_live[first]);
+	CHECK(fb_live[pinned]);
+	CHECK(fb_live[m.front]);
+
+	/* a hit makes an entry the most recently used */
+	CHECK(test_fb(&m, 3, FALSE));
+	CHECK(test_fb(&m, DRMMODE_FB_CACHE_SIZE + 1, FALSE));
+	CHECK(bos[3].refs == 2);
+	CHECK(bos[4].refs == 1);
+
+	/* nothing left to evict once everything is held */
+	test_init(&m);
+	for (i = 0; i < DRMMODE_FB_CACHE_SIZE; i++)
+		CHECK(test_fb(&m, i, TRUE));
+	CHECK(!test_fb(&m, DRMMODE_FB_CACHE_SIZE, FALSE));
+	CHECK(kms_crtc_off == 0);
+	test_fini(&m);
+}
+
+/* Destroying the old front buffer's pixmap while the flip away from it is
+ * still pending mustn't RmFB it, that would turn the CRTCs off.
+ */
+static void
+test_evict_pending_flip(void)
+{
+	struct test_mode m;
+	uint32_t old;
+
+	test_init(&m);
+	test_modeset(&m, 0);
+	old = m.front;
+
+	CHECK(test_flip_queue(&m, 1));
+	drmmode_fb_evict(&m.cache, &bos[0].base, FALSE);
+	CHECK(fb_live[old]);
+	CHECK(kms_crtc_off == 0);
+
+	/* not even to make room for another buffer */
+	test_fb(&m, 2, FALSE);
+	CHECK(fb_live[old]);
+
+	test_flip_complete(&m);
+	CHECK(!fb_live[old]);
+	CHECK(bos[0].refs == 1);
+	CHECK(kms_crtc_off == 0);
+
+	/* the new front buffer is safe the same way */
+	drmmode_fb_evict(&m.cache, &bos[1].base, FALSE);
+	CHECK(fb_live[m.front]);
+	test_modeset(&m, 2);
+	CHECK(kms_crtc_off == 0);
+	CHECK(bos[1].refs == 1);
+	test_fini(&m);
+}
+
+/* Pinned entries only go when asked to, and wait for the CRTC too. */
+static void
+test_pinned(void)
+{
+	struct test_mode m;
+	uint32_t shadow;
+	int i;
+
+	test_init(&m);
+	test_modeset(&m, 0);
+	shadow = test_fb(&m, 1, TRUE);
+
+	drmmode_fb_evict(&m.cache, &bos[1].base, FALSE);
+	CHECK(fb_live[shadow]);
+
+	for (i = 0; i < NCRTC; i++) {
+		kms_shown[i] = shadow;
+		drmmode_fb_hold(&m.cache, &m.scanout_fb[i], shadow);
+	}
+	drmmode_fb_evict(&m.cache, &bos[1].base, TRUE);
+	CHECK(fb_live[shadow]);
+
+	test_modeset(&m, 0);
+	CHECK(!fb_live[shadow]);
+	CHECK(kms_crtc_off == 0);
+	test_fini(&m);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct test_mode m;
+	int flips = 1000000, buffers = 3, i;
+	double t;
+
+	if (argc > 1)
+		flips = atoi(argv[1]);
+	if (argc > 2)
+		buffers = atoi(argv[2]);
+	if (flips <= 0 || buffers < 2 || buffers > MAX_BO) {
+		fprintf(stderr, "usage: %s [flips [buffers]]\n", argv[0]);
+		return 1;
+	}
+
+	test_steady_state();
+	test_lru();
+	test_evict_pending_flip();
+	test_pinned();
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("framebuffer cache checks passed\n");
+
+	test_init(&m);
+	test_modeset(&m, 0);
+	t = now();
+	for (i = 0; i < flips; i++) {
+		if (!test_flip_queue(&m, (i + 1) % buffers))
+			break;
+		test_flip_complete(&m);
+	}
+	t = now() - t;
+
+	printf("%d flips over %d buffers: %.0f flips/s, "
+	       "%lu AddFB, %lu RmFB\n", i, buffers, i / t,
+	       kms_adds, kms_rms);
+	test_fini(&m);
+	return failures != 0;
+}
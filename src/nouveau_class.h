@@ -8054,6 +8054,8 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define  NV50TCL_LINKED_TSC								0x00001234
 #define  NV50TCL_RT_HORIZ(x)								(0x00001240+((x)*8))
 #define  NV50TCL_RT_HORIZ__SIZE								0x00000008
+#define   NV50TCL_RT_HORIZ_WIDTH_MASK							0x0007ffff
+#define   NV50TCL_RT_HORIZ_LINEAR							(1 << 31)
 #define  NV50TCL_RT_VERT(x)								(0x00001244+((x)*8))
 #define  NV50TCL_RT_VERT__SIZE								0x00000008
 #define  NV50TCL_CB_DEF_ADDRESS_HIGH							0x00001280
@@ -2,6 +2,8 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/time.h>
+#include <time.h>
 
 #include "xorg-server.h"
 #include "nv_include.h"
@@ -11,9 +13,17 @@
 #endif
 
 #if defined(DRI2) && DRI2INFOREC_VERSION >= 3
+/* A pending swap holds its own reference on both buffers, DRI2 destroys
+ * its copies when the drawable is resized even if the swap hasn't
+ * completed yet.
+ */
 struct nouveau_dri2_buffer {
 	DRI2BufferRec base;
 	PixmapPtr ppix;
+	unsigned int usage_hint;
+	int client;
+	XID draw;
+	int refcnt;
 };
 
 static inline struct nouveau_dri2_buffer *
@@ -22,6 +32,207 @@ nouveau_dri2_buffer(DRI2BufferPtr buf)
 	return (struct nouveau_dri2_buffer *)buf;
 }
 
+/* Recently released back/depth buffers, so that clients which resize or
+ * re-query their buffers don't reallocate VRAM every time.  A buffer is
+ * only handed back for a drawable of the client it came from, and dropped
+ * when that client goes away.
+ *
+ * Whoever asks for a drawable's buffers isn't necessarily its owner, and
+ * can already see that drawable's buffers but not the owner's others: a
+ * buffer going to a different drawable is cleared first.  Depth buffers
+ * can't just be filled, they only go back to the same drawable.
+ */
+#define NOUVEAU_DRI2_POOL_SIZE	8
+#define NOUVEAU_DRI2_POOL_BYTES	(64 * 1024 * 1024)
+#define NOUVEAU_DRI2_POOL_AGE	2000 /* ms */
+
+struct nouveau_dri2_pool {
+	struct {
+		PixmapPtr ppix;
+		int client;
+		unsigned int attachment;
+		unsigned int usage_hint;
+		XID draw;
+		CARD32 released;
+	} entry[NOUVEAU_DRI2_POOL_SIZE];
+	ScreenPtr pScreen;
+	OsTimerPtr timer;
+	unsigned long bytes;
+	unsigned long hits;
+	unsigned long misses;
+};
+
+static void
+nouveau_dri2_pool_drop(ScreenPtr pScreen, struct nouveau_dri2_pool *pool,
+		       int i)
+{
+	PixmapPtr ppix = pool->entry[i].ppix;
+
+	pool->bytes -= nouveau_pixmap_bo(ppix)->size;
+	pool->entry[i].ppix = NULL;
+	pScreen->DestroyPixmap(ppix);
+}
+
+static CARD32
+nouveau_dri2_pool_timer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+	struct nouveau_dri2_pool *pool = arg;
+	Bool busy = FALSE;
+	int i;
+
+	for (i = 0; i < NOUVEAU_DRI2_POOL_SIZE; i++) {
+		if (!pool->entry[i].ppix)
+			continue;
+
+		if ((CARD32)(now - pool->entry[i].released) >=
+		    NOUVEAU_DRI2_POOL_AGE)
+			nouveau_dri2_pool_drop(pool->pScreen, pool, i);
+		else
+			busy = TRUE;
+	}
+
+	return busy ? NOUVEAU_DRI2_POOL_AGE : 0;
+}
+
+static void
+nouveau_dri2_client_state(CallbackListPtr *list, pointer closure,
+			  pointer data)
+{
+	struct nouveau_dri2_pool *pool = closure;
+	ClientPtr client = ((NewClientInfoRec *)data)->client;
+	int i;
+
+	if (client->clientState != ClientStateGone)
+		return;
+
+	for (i = 0; i < NOUVEAU_DRI2_POOL_SIZE; i++) {
+		if (pool->entry[i].ppix &&
+		    pool->entry[i].client == client->index)
+			nouveau_dri2_pool_drop(pool->pScreen, pool, i);
+	}
+}
+
+static Bool
+nouveau_dri2_pool_clear(ScreenPtr pScreen, PixmapPtr ppix)
+{
+	xRectangle rect = { 0, 0, ppix->drawable.width,
+			    ppix->drawable.height };
+	GCPtr pGC;
+
+	/* a scratch GC fills solid with pixel 0 */
+	pGC = GetScratchGC(ppix->drawable.depth, pScreen);
+	if (!pGC)
+		return FALSE;
+
+	ValidateGC(&ppix->drawable, pGC);
+	pGC->ops->PolyFillRect(&ppix->drawable, pGC, 1, &rect);
+	FreeScratchGC(pGC);
+	return TRUE;
+}
+
+static PixmapPtr
+nouveau_dri2_pool_get(DrawablePtr pDraw, unsigned int attachment,
+		      unsigned int usage_hint)
+{
+	ScreenPtr pScreen = pDraw->pScreen;
+	NVPtr pNv = NVPTR(xf86Screens[pScreen->myNum]);
+	struct nouveau_dri2_pool *pool = pNv->dri2_pool;
+	PixmapPtr ppix;
+	int i;
+
+	if (!pool)
+		return NULL;
+
+	for (i = 0; i < NOUVEAU_DRI2_POOL_SIZE; i++) {
+		struct nouveau_bo *bo;
+
+		ppix = pool->entry[i].ppix;
+		if (!ppix || pool->entry[i].client != CLIENT_ID(pDraw->id) ||
+		    pool->entry[i].attachment != attachment ||
+		    pool->entry[i].usage_hint != usage_hint ||
+		    ppix->drawable.width != pDraw->width ||
+		    ppix->drawable.height != pDraw->height ||
+		    ppix->drawable.depth != pDraw->depth)
+			continue;
+
+		if (pool->entry[i].draw != pDraw->id &&
+		    (usage_hint & NOUVEAU_CREATE_PIXMAP_ZETA))
+			continue;
+
+		/* the GPU may still be reading it for a previous swap, it's
+		 * reused anyway if libdrm can't tell without waiting
+		 */
+		bo = nouveau_pixmap_bo(ppix);
+		if (NOUVEAU_BO_NOWAIT) {
+			if (nv_bo_map(pNv, bo, NOUVEAU_BO_RDWR |
+				      NOUVEAU_BO_NOWAIT))
+				continue;
+			nv_bo_unmap(pNv, bo);
+		}
+
+		if (pool->entry[i].draw != pDraw->id &&
+		    !nouveau_dri2_pool_clear(pScreen, ppix))
+			continue;
+
+		pool->bytes -= bo->size;
+		pool->entry[i].ppix = NULL;
+		pool->hits++;
+		return ppix;
+	}
+
+	pool->misses++;
+	return NULL;
+}
+
+static void
+nouveau_dri2_pool_put(ScreenPtr pScreen, struct nouveau_dri2_buffer *nvbuf)
+{
+	NVPtr pNv = NVPTR(xf86Screens[pScreen->myNum]);
+	struct nouveau_dri2_pool *pool = pNv->dri2_pool;
+	PixmapPtr ppix = nvbuf->ppix;
+	struct nouveau_bo *bo = nouveau_pixmap_bo(ppix);
+	int i, slot = -1;
+
+	if (!pool || !bo || ppix->refcnt > 1 ||
+	    bo->size > NOUVEAU_DRI2_POOL_BYTES) {
+		pScreen->DestroyPixmap(ppix);
+		return;
+	}
+
+	/* make room, oldest first */
+	for (;;) {
+		int oldest = -1;
+
+		slot = -1;
+		for (i = 0; i < NOUVEAU_DRI2_POOL_SIZE; i++) {
+			if (!pool->entry[i].ppix) {
+				if (slot < 0)
+					slot = i;
+			} else
+			if (oldest < 0 || (int)(pool->entry[i].released -
+					pool->entry[oldest].released) < 0) {
+				oldest = i;
+			}
+		}
+
+		if (slot >= 0 &&
+		    pool->bytes + bo->size <= NOUVEAU_DRI2_POOL_BYTES)
+			break;
+		nouveau_dri2_pool_drop(pScreen, pool, oldest);
+	}
+
+	pool->entry[slot].ppix = ppix;
+	pool->entry[slot].client = nvbuf->client;
+	pool->entry[slot].draw = nvbuf->draw;
+	pool->entry[slot].attachment = nvbuf->base.attachment;
+	pool->entry[slot].usage_hint = nvbuf->usage_hint;
+	pool->entry[slot].released = GetTimeInMillis();
+	pool->bytes += bo->size;
+
+	pool->timer = TimerSet(pool->timer, 0, NOUVEAU_DRI2_POOL_AGE,
+			       nouveau_dri2_pool_timer, pool);
+}
+
 DRI2BufferPtr
 nouveau_dri2_create_buffer(DrawablePtr pDraw, unsigned int attachment,
 			   unsigned int format)
@@ -31,6 +242,7 @@ nouveau_dri2_create_buffer(DrawablePtr pDraw, unsigned int attachment,
 	struct nouveau_dri2_buffer *nvbuf;
 	struct nouveau_pixmap *nvpix;
 	PixmapPtr ppix;
+	unsigned int usage_hint = 0;
 
 	nvbuf = calloc(1, sizeof(*nvbuf));
 	if (!nvbuf)
@@ -46,7 +258,7 @@ nouveau_dri2_create_buffer(DrawablePtr pDraw, unsigned int attachment,
 
 		ppix->refcnt++;
 	} else {
-		unsigned int usage_hint = NOUVEAU_CREATE_PIXMAP_TILED;
+		usage_hint = NOUVEAU_CREATE_PIXMAP_TILED;
 
 		if (attachment == DRI2BufferDepth ||
 		    attachment == DRI2BufferDepthStencil)
@@ -54,9 +266,21 @@ nouveau_dri2_create_buffer(DrawablePtr pDraw, unsigned int attachment,
 		else
 			usage_hint |= NOUVEAU_CREATE_PIXMAP_SCANOUT;
 
-		ppix = pScreen->CreatePixmap(pScreen, pDraw->width,
-					     pDraw->height, pDraw->depth,
-					     usage_hint);
+		ppix = nouveau_dri2_pool_get(pDraw, attachment, usage_hint);
+		if (!ppix)
+			ppix = pScreen->CreatePixmap(pScreen, pDraw->width,
+						     pDraw->height,
+						     pDraw->depth, usage_hint);
+
+#if DRI2INFOREC_VERSION >= 6
+		if (attachment == DRI2BufferBackLeft)
+			DRI2SwapLimit(pDraw, pNv->swap_limit);
+#endif
+	}
+
+	if (!ppix) {
+		free(nvbuf);
+		return NULL;
 	}
 
 	pNv->exa_force_cp = TRUE;
@@ -70,6 +294,10 @@ nouveau_dri2_create_buffer(DrawablePtr pDraw, unsigned int attachment,
 	nvbuf->base.format = format;
 	nvbuf->base.flags = 0;
 	nvbuf->ppix = ppix;
+	nvbuf->usage_hint = usage_hint;
+	nvbuf->client = CLIENT_ID(pDraw->id);
+	nvbuf->draw = pDraw->id;
+	nvbuf->refcnt = 1;
 
 	nvpix = nouveau_pixmap(ppix);
 	if (!nvpix || !nvpix->bo ||
@@ -82,19 +310,128 @@ nouveau_dri2_create_buffer(DrawablePtr pDraw, unsigned int attachment,
 	return &nvbuf->base;
 }
 
-void
-nouveau_dri2_destroy_buffer(DrawablePtr pDraw, DRI2BufferPtr buf)
+static void
+nouveau_dri2_buffer_unref(ScreenPtr pScreen, DRI2BufferPtr buf)
 {
-	struct nouveau_dri2_buffer *nvbuf;
+	struct nouveau_dri2_buffer *nvbuf = nouveau_dri2_buffer(buf);
 
-	nvbuf = nouveau_dri2_buffer(buf);
-	if (!nvbuf)
+	if (--nvbuf->refcnt)
 		return;
 
-	pDraw->pScreen->DestroyPixmap(nvbuf->ppix);
+	if (nvbuf->base.attachment == DRI2BufferFrontLeft)
+		pScreen->DestroyPixmap(nvbuf->ppix);
+	else
+		nouveau_dri2_pool_put(pScreen, nvbuf);
 	free(nvbuf);
 }
 
+void
+nouveau_dri2_destroy_buffer(DrawablePtr pDraw, DRI2BufferPtr buf)
+{
+	if (!buf)
+		return;
+
+	nouveau_dri2_buffer_unref(pDraw->pScreen, buf);
+}
+
+static PixmapPtr
+nouveau_dri2_drawable_pixmap(DrawablePtr pDraw, int *x, int *y)
+{
+	PixmapPtr ppix;
+
+	if (pDraw->type == DRAWABLE_PIXMAP) {
+		*x = *y = 0;
+		return (PixmapPtr)pDraw;
+	}
+
+	ppix = pDraw->pScreen->GetWindowPixmap((WindowPtr)pDraw);
+	*x = pDraw->x;
+	*y = pDraw->y;
+#ifdef COMPOSITE
+	*x -= ppix->screen_x;
+	*y -= ppix->screen_y;
+#endif
+	return ppix;
+}
+
+/* Walk the region's boxes and hand them straight to the copy engine in a
+ * single PrepareCopy/DoneCopy batch, so partial swaps cost in proportion
+ * to the damaged area.  Returns FALSE if the GC path has to do it.
+ */
+static Bool
+nouveau_dri2_copy_region_direct(DrawablePtr pDraw, RegionPtr pRegion,
+				struct nouveau_dri2_buffer *dst,
+				struct nouveau_dri2_buffer *src)
+{
+	ScreenPtr pScreen = pDraw->pScreen;
+	NVPtr pNv = NVPTR(xf86Screens[pScreen->myNum]);
+	ExaDriverPtr exa = pNv->EXADriverPtr;
+	PixmapPtr pspix = src->ppix, pdpix = dst->ppix;
+	int sx = 0, sy = 0, dx = 0, dy = 0;
+	RegionRec clip;
+	BoxPtr box;
+	int nbox;
+
+	if (!exa)
+		return FALSE;
+
+	if (src->base.attachment == DRI2BufferFrontLeft)
+		pspix = nouveau_dri2_drawable_pixmap(pDraw, &sx, &sy);
+	if (dst->base.attachment == DRI2BufferFrontLeft)
+		pdpix = nouveau_dri2_drawable_pixmap(pDraw, &dx, &dy);
+
+	if (pspix == pdpix || !nouveau_pixmap_bo(pspix) ||
+	    !nouveau_pixmap_bo(pdpix))
+		return FALSE;
+
+	REGION_NULL(pScreen, &clip);
+	if (dst->base.attachment == DRI2BufferFrontLeft &&
+	    pDraw->type == DRAWABLE_WINDOW) {
+		REGION_COPY(pScreen, &clip, pRegion);
+		REGION_TRANSLATE(pScreen, &clip, pDraw->x, pDraw->y);
+		REGION_INTERSECT(pScreen, &clip, &clip,
+				 &((WindowPtr)pDraw)->clipList);
+		REGION_TRANSLATE(pScreen, &clip, -pDraw->x, -pDraw->y);
+	} else {
+		BoxRec extents = { 0, 0, pDraw->width, pDraw->height };
+		RegionRec bounds;
+
+		REGION_INIT(pScreen, &bounds, &extents, 1);
+		REGION_INTERSECT(pScreen, &clip, pRegion, &bounds);
+		REGION_UNINIT(pScreen, &bounds);
+	}
+
+	if (!REGION_NOTEMPTY(pScreen, &clip)) {
+		REGION_UNINIT(pScreen, &clip);
+		return TRUE;
+	}
+
+	if (!exa->PrepareCopy(pspix, pdpix, 1, 1, GXcopy, FB_ALLONES)) {
+		REGION_UNINIT(pScreen, &clip);
+		return FALSE;
+	}
+
+	box = REGION_RECTS(&clip);
+	nbox = REGION_NUM_RECTS(&clip);
+	while (nbox--) {
+		exa->Copy(pdpix, box->x1 + sx, box->y1 + sy,
+			  box->x1 + dx, box->y1 + dy,
+			  box->x2 - box->x1, box->y2 - box->y1);
+		box++;
+	}
+	exa->DoneCopy(pdpix);
+
+	/* we went around the GC, so report the damage ourselves */
+	if (dst->base.attachment == DRI2BufferFrontLeft) {
+		REGION_TRANSLATE(pScreen, &clip, pDraw->x, pDraw->y);
+		DamageRegionAppend(pDraw, &clip);
+		DamageRegionProcessPending(pDraw);
+	}
+
+	REGION_UNINIT(pScreen, &clip);
+	return TRUE;
+}
+
 void
 nouveau_dri2_copy_region(DrawablePtr pDraw, RegionPtr pRegion,
 			 DRI2BufferPtr pDstBuffer, DRI2BufferPtr pSrcBuffer)
@@ -106,6 +443,9 @@ nouveau_dri2_copy_region(DrawablePtr pDraw, RegionPtr pRegion,
 	RegionPtr pCopyClip;
 	GCPtr pGC;
 
+	if (nouveau_dri2_copy_region_direct(pDraw, pRegion, dst, src))
+		return;
+
 	if (src->base.attachment == DRI2BufferFrontLeft)
 		pspix = (PixmapPtr)pDraw;
 	if (dst->base.attachment == DRI2BufferFrontLeft)
@@ -136,8 +476,50 @@ struct nouveau_dri2_vblank_state {
 	DRI2BufferPtr src;
 	DRI2SwapEventPtr func;
 	void *data;
+
+	/* swap deferred until the GPU is done with the previous frame */
+	struct nouveau_dri2_vblank_state *throttle_next;
+	CARD32 throttle_start;
+	unsigned int frame;
+	unsigned int tv_sec;
+	unsigned int tv_usec;
+
+	int pipe;
+
+	ScrnInfoPtr scrn;
+
+	/* page flips still to land, one per CRTC */
+	int flips;
+
+	/* not synced to vblank, present as soon as possible */
+	Bool async;
+
+	/* blit submitted from the target frame's vblank event */
+	Bool blit_on_vblank;
+
+	/* throttling held the swap back, it's no longer at its vblank */
+	Bool deferred;
 };
 
+static void
+nouveau_dri2_vblank_free(struct nouveau_dri2_vblank_state *s)
+{
+	if (s->action == SWAP) {
+		nouveau_dri2_buffer_unref(s->scrn->pScreen, s->dst);
+		nouveau_dri2_buffer_unref(s->scrn->pScreen, s->src);
+	}
+
+	free(s);
+}
+
+/* How often to poll a busy front buffer, backing off up to POLL_MAX while
+ * it stays busy, and how long to keep polling before giving up and
+ * waiting on it synchronously.
+ */
+#define NOUVEAU_DRI2_THROTTLE_POLL	1
+#define NOUVEAU_DRI2_THROTTLE_POLL_MAX	8
+#define NOUVEAU_DRI2_THROTTLE_TIMEOUT	100
+
 static Bool
 can_exchange(DrawablePtr draw, PixmapPtr dst_pix, PixmapPtr src_pix)
 {
@@ -174,6 +556,42 @@ can_sync_to_vblank(DrawablePtr draw)
 					  draw->width, draw->height);
 }
 
+static int
+nouveau_vblank_pipe(DrawablePtr draw)
+{
+	ScrnInfoPtr scrn = xf86Screens[draw->pScreen->myNum];
+
+	return nv_window_belongs_to_crtc(scrn, draw->x, draw->y,
+					 draw->width, draw->height) == 2;
+}
+
+/* The current time on the clock the kernel stamps vblank events with. */
+static CARD64
+nouveau_vblank_ust_now(NVPtr pNv)
+{
+	struct timeval tv;
+
+#ifdef HAVE_CLOCK_GETTIME
+	if (pNv->has_monotonic_ust) {
+		struct timespec ts;
+
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+			return (CARD64)ts.tv_sec * 1000000 +
+			       ts.tv_nsec / 1000;
+	}
+#endif
+	gettimeofday(&tv, NULL);
+	return (CARD64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void
+nouveau_dri2_vblank_reset(ScrnInfoPtr pScrn)
+{
+	NVPtr pNv = NVPTR(pScrn);
+
+	memset(pNv->vblank_model, 0, sizeof(pNv->vblank_model));
+}
+
 static int
 nouveau_wait_vblank(DrawablePtr draw, int type, CARD64 msc,
 		    CARD64 *pmsc, CARD64 *pust, void *data)
@@ -204,6 +622,177 @@ nouveau_wait_vblank(DrawablePtr draw, int type, CARD64 msc,
 	return 0;
 }
 
+static int
+nouveau_current_msc(DrawablePtr draw, CARD64 *pmsc, CARD64 *pust)
+{
+	NVPtr pNv = NVPTR(xf86Screens[draw->pScreen->myNum]);
+	int pipe = nouveau_vblank_pipe(draw);
+	CARD64 msc, ust;
+	int ret;
+
+	if (nouveau_vblank_model_predict(&pNv->vblank_model[pipe],
+					 nouveau_vblank_ust_now(pNv),
+					 pmsc, pust))
+		return 0;
+
+	ret = nouveau_wait_vblank(draw, DRM_VBLANK_RELATIVE, 0,
+				  &msc, &ust, NULL);
+	if (ret)
+		return ret;
+
+	nouveau_vblank_model_update(&pNv->vblank_model[pipe], msc, ust);
+	if (pmsc)
+		*pmsc = msc;
+	if (pust)
+		*pust = ust;
+	return 0;
+}
+
+static void
+nouveau_dri2_finish_swap(DrawablePtr draw, unsigned int frame,
+			 unsigned int tv_sec, unsigned int tv_usec,
+			 struct nouveau_dri2_vblank_state *s);
+
+/* Whether the GPU is done with the previous frame in the front buffer.
+ * Without NOUVEAU_BO_NOWAIT this waits for it, and throttling is
+ * synchronous again.
+ */
+static Bool
+nouveau_dri2_throttle_idle(NVPtr pNv, struct nouveau_bo *bo)
+{
+	if (nv_bo_map(pNv, bo, NOUVEAU_BO_RD | NOUVEAU_BO_NOWAIT))
+		return FALSE;
+
+	nv_bo_unmap(pNv, bo);
+	return TRUE;
+}
+
+/* One timer per screen polls every throttled swap, so it's only ever
+ * rearmed through its return value and never freed from under itself.
+ */
+static CARD32
+nouveau_dri2_throttle_timer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+	NVPtr pNv = NVPTR((ScrnInfoPtr)arg);
+	struct nouveau_dri2_vblank_state **ps, *s, *ready = NULL;
+	DrawablePtr draw;
+	Bool progress;
+	int ret;
+
+	/* Unlink what can go ahead before finishing any of it, the swaps
+	 * left behind are still busy and haven't timed out.
+	 */
+	ps = (struct nouveau_dri2_vblank_state **)&pNv->dri2_throttled;
+	while ((s = *ps)) {
+		struct nouveau_bo *bo =
+			nouveau_pixmap_bo(nouveau_dri2_buffer(s->dst)->ppix);
+
+		if (now - s->throttle_start < NOUVEAU_DRI2_THROTTLE_TIMEOUT &&
+		    !nouveau_dri2_throttle_idle(pNv, bo)) {
+			ps = &s->throttle_next;
+			continue;
+		}
+
+		*ps = s->throttle_next;
+		s->throttle_next = ready;
+		ready = s;
+	}
+
+	progress = ready != NULL;
+	while ((s = ready)) {
+		ready = s->throttle_next;
+		s->throttle_next = NULL;
+
+		ret = dixLookupDrawable(&draw, s->draw, serverClient,
+					M_ANY, DixWriteAccess);
+		if (ret) {
+			nouveau_dri2_vblank_free(s);
+			continue;
+		}
+
+		nouveau_dri2_finish_swap(draw, s->frame, s->tv_sec,
+					 s->tv_usec, s);
+	}
+
+	if (!pNv->dri2_throttled)
+		return 0;
+
+	if (progress)
+		pNv->dri2_throttle_poll = NOUVEAU_DRI2_THROTTLE_POLL;
+	else
+	if (pNv->dri2_throttle_poll < NOUVEAU_DRI2_THROTTLE_POLL_MAX)
+		pNv->dri2_throttle_poll *= 2;
+	return pNv->dri2_throttle_poll;
+}
+
+/* Non-blocking check of whether the GPU is done with the previous frame
+ * in the front buffer.  Returns FALSE after queueing the swap on the
+ * screen's throttle timer, so the server keeps servicing other clients in
+ * the meantime.
+ */
+static Bool
+nouveau_dri2_throttle(ScrnInfoPtr scrn, struct nouveau_bo *bo,
+		      unsigned int frame, unsigned int tv_sec,
+		      unsigned int tv_usec,
+		      struct nouveau_dri2_vblank_state *s)
+{
+	NVPtr pNv = NVPTR(scrn);
+	CARD32 now = GetTimeInMillis();
+
+	if (nouveau_dri2_throttle_idle(pNv, bo))
+		return TRUE;
+
+	if (!s->deferred) {
+		s->throttle_start = now;
+		s->deferred = TRUE;
+	}
+
+	/* don't let a wedged channel hold the swap forever */
+	if (now - s->throttle_start >= NOUVEAU_DRI2_THROTTLE_TIMEOUT)
+		goto wait;
+
+	if (!pNv->dri2_throttled) {
+		pNv->dri2_throttle_poll = NOUVEAU_DRI2_THROTTLE_POLL;
+		pNv->dri2_throttle = TimerSet(pNv->dri2_throttle, 0,
+					      pNv->dri2_throttle_poll,
+					      nouveau_dri2_throttle_timer,
+					      scrn);
+		if (!pNv->dri2_throttle)
+			goto wait;
+	}
+
+	s->frame = frame;
+	s->tv_sec = tv_sec;
+	s->tv_usec = tv_usec;
+	s->throttle_next = pNv->dri2_throttled;
+	pNv->dri2_throttled = s;
+	return FALSE;
+
+wait:
+	nv_bo_map(pNv, bo, NOUVEAU_BO_RD);
+	nv_bo_unmap(pNv, bo);
+	return TRUE;
+}
+
+/* Completes a swap that was superseded by a newer one before it could be
+ * presented.  Its buffers were never exchanged, so the client's back
+ * buffer simply still holds what it drew.
+ */
+static void
+nouveau_dri2_drop_swap(struct nouveau_dri2_vblank_state *s)
+{
+	DrawablePtr draw;
+
+	if (!s)
+		return;
+
+	if (!dixLookupDrawable(&draw, s->draw, serverClient,
+			       M_ANY, DixWriteAccess))
+		DRI2SwapComplete(s->client, draw, 0, 0, 0,
+				 DRI2_BLIT_COMPLETE, s->func, s->data);
+	nouveau_dri2_vblank_free(s);
+}
+
 static void
 nouveau_dri2_finish_swap(DrawablePtr draw, unsigned int frame,
 			 unsigned int tv_sec, unsigned int tv_usec,
@@ -217,16 +806,32 @@ nouveau_dri2_finish_swap(DrawablePtr draw, unsigned int frame,
 	struct nouveau_bo *src_bo = nouveau_pixmap_bo(src_pix);
 	struct nouveau_channel *chan = pNv->chan;
 	RegionRec reg;
-	int type, ret;
+	int type;
 
-	REGION_INIT(0, &reg, (&(BoxRec){ 0, 0, draw->width, draw->height }), 0);
-	REGION_TRANSLATE(0, &reg, draw->x, draw->y);
+	/* KMS won't queue a flip behind one that's still in flight, so an
+	 * unsynchronised swap waits in a one-deep mailbox for it to land,
+	 * newest frame wins.
+	 */
+	if (s->async && pNv->flip_pending && DRI2CanFlip(draw) &&
+	    can_exchange(draw, dst_pix, src_pix)) {
+		nouveau_dri2_drop_swap(pNv->flip_queued);
+		pNv->flip_queued = s;
+		return;
+	}
 
 	/* Throttle on the previous frame before swapping */
-	nouveau_bo_map(dst_bo, NOUVEAU_BO_RD);
-	nouveau_bo_unmap(dst_bo);
+	FIRE_RING(chan);
+	if (!nouveau_dri2_throttle(scrn, dst_bo, frame, tv_sec, tv_usec, s))
+		return;
+
+	REGION_INIT(0, &reg, (&(BoxRec){ 0, 0, draw->width, draw->height }), 0);
+	REGION_TRANSLATE(0, &reg, draw->x, draw->y);
 
-	if (can_sync_to_vblank(draw)) {
+	/* A blit sent from its vblank event has the whole blanking period to
+	 * land, one that waited on the throttle is racing the beam instead.
+	 */
+	if (can_sync_to_vblank(draw) &&
+	    (!s->blit_on_vblank || s->deferred)) {
 		/* Reference the back buffer to sync it to vblank */
 		WAIT_RING(chan, 1);
 		OUT_RELOC(chan, src_bo, 0,
@@ -240,24 +845,30 @@ nouveau_dri2_finish_swap(DrawablePtr draw, unsigned int frame,
 		FIRE_RING(chan);
 	}
 
+	type = DRI2_BLIT_COMPLETE;
 	if (can_exchange(draw, dst_pix, src_pix)) {
 		type = DRI2_EXCHANGE_COMPLETE;
-		DamageRegionAppend(draw, &reg);
 
 		if (DRI2CanFlip(draw)) {
 			type = DRI2_FLIP_COMPLETE;
-			ret = drmmode_page_flip(draw, src_pix, s);
-			if (!ret)
-				goto out;
+			s->flips = drmmode_page_flip(draw, src_pix, s,
+						     s->async &&
+						     pNv->has_async_flip);
+			if (s->flips)
+				pNv->flip_pending = s;
+			else
+				type = DRI2_BLIT_COMPLETE;
 		}
+	}
+
+	if (type != DRI2_BLIT_COMPLETE) {
+		DamageRegionAppend(draw, &reg);
 
 		SWAP(s->dst->name, s->src->name);
 		SWAP(nouveau_pixmap(dst_pix)->bo, nouveau_pixmap(src_pix)->bo);
 
 		DamageRegionProcessPending(draw);
 	} else {
-		type = DRI2_BLIT_COMPLETE;
-
 		/* Reference the front buffer to let throttling work
 		 * on occluded drawables. */
 		WAIT_RING(chan, 1);
@@ -266,20 +877,22 @@ nouveau_dri2_finish_swap(DrawablePtr draw, unsigned int frame,
 
 		REGION_TRANSLATE(0, &reg, -draw->x, -draw->y);
 		nouveau_dri2_copy_region(draw, &reg, s->dst, s->src);
+
+		/* we're racing the beam, don't wait for the block handler */
+		if (s->blit_on_vblank)
+			FIRE_RING(chan);
 	}
 
-	/*
-	 * Tell the X server buffers are already swapped even if they're
-	 * not, to prevent it from blocking the client on the next
-	 * GetBuffers request (and let the client do triple-buffering).
-	 *
-	 * XXX - The DRI2SwapLimit() API will allow us to move this to
-	 *	 the flip handler with no FPS hit.
+	/* Flips complete from nouveau_dri2_flip_handler once every CRTC
+	 * has flipped, the swap limit lets the client queue further frames
+	 * in the meantime.
 	 */
+	if (type == DRI2_FLIP_COMPLETE)
+		return;
+
 	DRI2SwapComplete(s->client, draw, frame, tv_sec, tv_usec,
 			 type, s->func, s->data);
-out:
-	free(s);
+	nouveau_dri2_vblank_free(s);
 }
 
 static Bool
@@ -299,11 +912,15 @@ nouveau_dri2_schedule_swap(ClientPtr client, DrawablePtr draw,
 
 	*s = (struct nouveau_dri2_vblank_state)
 		{ SWAP, client, draw->id, dst, src, func, data };
+	s->pipe = nouveau_vblank_pipe(draw);
+	s->scrn = xf86Screens[draw->pScreen->myNum];
+	s->async = !can_sync_to_vblank(draw);
+	nouveau_dri2_buffer(dst)->refcnt++;
+	nouveau_dri2_buffer(src)->refcnt++;
 
-	if (can_sync_to_vblank(draw)) {
+	if (!s->async) {
 		/* Get current sequence */
-		ret = nouveau_wait_vblank(draw, DRM_VBLANK_RELATIVE, 0,
-					  &current_msc, NULL, NULL);
+		ret = nouveau_current_msc(draw, &current_msc, NULL);
 		if (ret)
 			goto fail;
 
@@ -312,10 +929,19 @@ nouveau_dri2_schedule_swap(ClientPtr client, DrawablePtr draw,
 			*target_msc = current_msc + divisor
 				- (current_msc - remainder) % divisor;
 
-		/* Request a vblank event one frame before the target */
+		/* A blit is submitted straight from the target frame's
+		 * vblank event, rather than making the whole channel wait
+		 * on the vblank semaphore in front of it.  Exchanges and
+		 * flips keep the event one frame before the target.
+		 */
+		s->blit_on_vblank =
+			!can_exchange(draw, nouveau_dri2_buffer(dst)->ppix,
+				      nouveau_dri2_buffer(src)->ppix);
+
 		ret = nouveau_wait_vblank(draw, DRM_VBLANK_ABSOLUTE |
 					  DRM_VBLANK_EVENT,
-					  max(current_msc, *target_msc - 1),
+					  max(current_msc, s->blit_on_vblank ?
+					      *target_msc : *target_msc - 1),
 					  NULL, NULL, s);
 		if (ret)
 			goto fail;
@@ -328,7 +954,7 @@ nouveau_dri2_schedule_swap(ClientPtr client, DrawablePtr draw,
 	return TRUE;
 
 fail:
-	free(s);
+	nouveau_dri2_vblank_free(s);
 	return FALSE;
 }
 
@@ -351,10 +977,10 @@ nouveau_dri2_schedule_wait(ClientPtr client, DrawablePtr draw,
 		return FALSE;
 
 	*s = (struct nouveau_dri2_vblank_state) { WAIT, client, draw->id };
+	s->pipe = nouveau_vblank_pipe(draw);
 
 	/* Get current sequence */
-	ret = nouveau_wait_vblank(draw, DRM_VBLANK_RELATIVE, 0,
-				  &current_msc, NULL, NULL);
+	ret = nouveau_current_msc(draw, &current_msc, NULL);
 	if (ret)
 		goto fail;
 
@@ -390,7 +1016,7 @@ nouveau_dri2_get_msc(DrawablePtr draw, CARD64 *ust, CARD64 *msc)
 	}
 
 	/* Get current sequence */
-	ret = nouveau_wait_vblank(draw, DRM_VBLANK_RELATIVE, 0, msc, ust, NULL);
+	ret = nouveau_current_msc(draw, msc, ust);
 	if (ret)
 		return FALSE;
 
@@ -404,12 +1030,19 @@ nouveau_dri2_vblank_handler(int fd, unsigned int frame,
 {
 	struct nouveau_dri2_vblank_state *s = event_data;
 	DrawablePtr draw;
+	NVPtr pNv;
 	int ret;
 
 	ret = dixLookupDrawable(&draw, s->draw, serverClient,
 				M_ANY, DixWriteAccess);
-	if (ret)
+	if (ret) {
+		nouveau_dri2_vblank_free(s);
 		return;
+	}
+
+	pNv = NVPTR(xf86Screens[draw->pScreen->myNum]);
+	nouveau_vblank_model_update(&pNv->vblank_model[s->pipe], frame,
+				    (CARD64)tv_sec * 1000000 + tv_usec);
 
 	switch (s->action) {
 	case SWAP:
@@ -423,11 +1056,62 @@ nouveau_dri2_vblank_handler(int fd, unsigned int frame,
 	}
 }
 
+void
+nouveau_dri2_flip_handler(int fd, unsigned int frame,
+			  unsigned int tv_sec, unsigned int tv_usec,
+			  void *event_data)
+{
+	struct nouveau_dri2_vblank_state *s = event_data, *next;
+	NVPtr pNv = NVPTR(s->scrn);
+	DrawablePtr draw;
+	int ret;
+
+	/* report the timestamp of the last CRTC to flip */
+	if (s->frame < frame)
+		s->frame = frame;
+	if ((CARD64)s->tv_sec * 1000000 + s->tv_usec <
+	    (CARD64)tv_sec * 1000000 + tv_usec) {
+		s->tv_sec = tv_sec;
+		s->tv_usec = tv_usec;
+	}
+
+	if (--s->flips)
+		return;
+
+	drmmode_flip_complete(s->scrn);
+	if (pNv->flip_pending == s)
+		pNv->flip_pending = NULL;
+
+	ret = dixLookupDrawable(&draw, s->draw, serverClient,
+				M_ANY, DixWriteAccess);
+	if (!ret)
+		DRI2SwapComplete(s->client, draw, s->frame, s->tv_sec,
+				 s->tv_usec, DRI2_FLIP_COMPLETE, s->func,
+				 s->data);
+	nouveau_dri2_vblank_free(s);
+
+	/* present the newest swap that was waiting for this flip */
+	next = pNv->flip_queued;
+	if (!next)
+		return;
+	pNv->flip_queued = NULL;
+
+	ret = dixLookupDrawable(&draw, next->draw, serverClient,
+				M_ANY, DixWriteAccess);
+	if (ret) {
+		nouveau_dri2_vblank_free(next);
+		return;
+	}
+
+	nouveau_dri2_finish_swap(draw, frame, tv_sec, tv_usec, next);
+}
+
 Bool
 nouveau_dri2_init(ScreenPtr pScreen)
 {
 	ScrnInfoPtr pScrn = xf86Screens[pScreen->myNum];
 	NVPtr pNv = NVPTR(pScrn);
+	struct nouveau_dri2_pool *pool;
 	DRI2InfoRec dri2 = { 0 };
 
 	if (pNv->Architecture >= NV_ARCH_30)
@@ -446,13 +1130,57 @@ nouveau_dri2_init(ScreenPtr pScreen)
 	dri2.ScheduleWaitMSC = nouveau_dri2_schedule_wait;
 	dri2.GetMSC = nouveau_dri2_get_msc;
 
+	pool = calloc(1, sizeof(struct nouveau_dri2_pool));
+	if (pool) {
+		pool->pScreen = pScreen;
+		if (AddCallback(&ClientStateCallback,
+				nouveau_dri2_client_state, pool))
+			pNv->dri2_pool = pool;
+		else
+			free(pool);
+	}
+
 	return DRI2ScreenInit(pScreen, &dri2);
 }
 
 void
 nouveau_dri2_fini(ScreenPtr pScreen)
 {
+	ScrnInfoPtr pScrn = xf86Screens[pScreen->myNum];
+	NVPtr pNv = NVPTR(pScrn);
+	struct nouveau_dri2_pool *pool = pNv->dri2_pool;
+	struct nouveau_dri2_vblank_state *queued = pNv->flip_queued, *s;
+	int i;
+
 	DRI2CloseScreen(pScreen);
+
+	if (queued) {
+		nouveau_dri2_vblank_free(queued);
+		pNv->flip_queued = NULL;
+	}
+
+	TimerFree(pNv->dri2_throttle);
+	pNv->dri2_throttle = NULL;
+	while ((s = pNv->dri2_throttled)) {
+		pNv->dri2_throttled = s->throttle_next;
+		nouveau_dri2_vblank_free(s);
+	}
+
+	if (!pool)
+		return;
+	pNv->dri2_pool = NULL;
+	DeleteCallback(&ClientStateCallback, nouveau_dri2_client_state, pool);
+	TimerFree(pool->timer);
+
+	xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 3,
+		       "DRI2 buffer pool: %lu hits, %lu misses\n",
+		       pool->hits, pool->misses);
+
+	for (i = 0; i < NOUVEAU_DRI2_POOL_SIZE; i++) {
+		if (pool->entry[i].ppix)
+			nouveau_dri2_pool_drop(pScreen, pool, i);
+	}
+	free(pool);
 }
 #else
 Bool
@@ -461,6 +1189,11 @@ nouveau_dri2_init(ScreenPtr pScreen)
 	return TRUE;
 }
 
+void
+nouveau_dri2_vblank_reset(ScrnInfoPtr pScrn)
+{
+}
+
 void
 nouveau_dri2_fini(ScreenPtr pScreen)
 {
@@ -129,7 +129,7 @@ NVAccelDownloadM2MF(PixmapPtr pspix, int x, int y, int w, int h,
 		OUT_RING  (chan, (1<<8)|1);
 		OUT_RING  (chan, 0);
 
-		if (nouveau_bo_map(pNv->GART, NOUVEAU_BO_RD)) {
+		if (nv_bo_map(pNv, pNv->GART, NOUVEAU_BO_RD)) {
 			MARK_UNDO(chan);
 			return FALSE;
 		}
@@ -144,7 +144,7 @@ NVAccelDownloadM2MF(PixmapPtr pspix, int x, int y, int w, int h,
 				dst += dst_pitch;
 			}
 		}
-		nouveau_bo_unmap(pNv->GART);
+		nv_bo_unmap(pNv, pNv->GART);
 
 		if (linear)
 			src_offset += line_count * src_pitch;
@@ -188,7 +188,7 @@ NVAccelUploadM2MF(PixmapPtr pdpix, int x, int y, int w, int h,
 			line_count = h;
 
 		/* Upload to GART */
-		if (nouveau_bo_map(pNv->GART, NOUVEAU_BO_WR))
+		if (nv_bo_map(pNv, pNv->GART, NOUVEAU_BO_WR))
 			return FALSE;
 		dst = pNv->GART->map;
 		if (src_pitch == line_len) {
@@ -201,7 +201,7 @@ NVAccelUploadM2MF(PixmapPtr pdpix, int x, int y, int w, int h,
 				dst += line_len;
 			}
 		}
-		nouveau_bo_unmap(pNv->GART);
+		nv_bo_unmap(pNv, pNv->GART);
 
 		if (MARK_RING(chan, 32, 6))
 			return FALSE;
@@ -289,7 +289,7 @@ nouveau_exa_prepare_access(PixmapPtr ppix, int index)
 
 	if (nv50_style_tiled_pixmap(ppix) && !pNv->wfb_enabled)
 		return FALSE;
-	if (nouveau_bo_map(bo, NOUVEAU_BO_RDWR))
+	if (nv_bo_map(pNv, bo, NOUVEAU_BO_RDWR))
 		return FALSE;
 	ppix->devPrivate.ptr = bo->map;
 	return TRUE;
@@ -299,8 +299,9 @@ static void
 nouveau_exa_finish_access(PixmapPtr ppix, int index)
 {
 	struct nouveau_bo *bo = nouveau_pixmap_bo(ppix);
+	NVPtr pNv = NVPTR(xf86Screens[ppix->drawable.pScreen->myNum]);
 
-	nouveau_bo_unmap(bo);
+	nv_bo_unmap(pNv, bo);
 }
 
 static Bool
@@ -347,6 +348,7 @@ nouveau_exa_destroy_pixmap(ScreenPtr pScreen, void *priv)
 	if (!nvpix)
 		return;
 
+	drmmode_fb_release(xf86Screens[pScreen->myNum], nvpix->bo);
 	nouveau_bo_ref(NULL, &nvpix->bo);
 	free(nvpix);
 }
@@ -362,6 +364,153 @@ nv50_style_tiled_pixmap(PixmapPtr ppix)
 		 NOUVEAU_BO_TILE_LAYOUT_MASK);
 }
 
+/* Pictures without a drawable (solid fills and linear gradients) are
+ * sampled from a 1-texel or NOUVEAU_SOURCE_RAMP_SIZE-texel wide ramp,
+ * with the ramp coordinate computed per-vertex from the picture space
+ * position: s = coeff[0] * x + coeff[1] * y + coeff[2].
+ */
+static Bool
+nouveau_exa_source_pict_clamped(PicturePtr ppict)
+{
+	return ppict->pSourcePict->type != SourcePictTypeSolidFill &&
+	       (!ppict->repeat || ppict->repeatType == RepeatNone);
+}
+
+Bool
+nouveau_exa_source_pict_check(PicturePtr ppict)
+{
+	SourcePictPtr sp = ppict->pSourcePict;
+	PictTransformPtr t = ppict->transform;
+
+	switch (sp->type) {
+	case SourcePictTypeSolidFill:
+		return TRUE;
+	case SourcePictTypeLinear:
+		if (sp->linear.p1.x == sp->linear.p2.x &&
+		    sp->linear.p1.y == sp->linear.p2.y)
+			NOUVEAU_FALLBACK("degenerate linear gradient\n");
+		if (sp->gradient.nstops < 1)
+			NOUVEAU_FALLBACK("gradient without stops\n");
+		break;
+	default:
+		NOUVEAU_FALLBACK("gradient type %d\n", sp->type);
+	}
+
+	/* the ramp coordinate is interpolated linearly across the primitive */
+	if (t && (t->matrix[2][0] || t->matrix[2][1] ||
+		  t->matrix[2][2] != xFixed1))
+		NOUVEAU_FALLBACK("projective gradient transform\n");
+
+	return TRUE;
+}
+
+static inline uint32_t
+nouveau_exa_premultiply(const xRenderColor *c0, const xRenderColor *c1,
+			float f)
+{
+	float a = c0->alpha + (c1->alpha - c0->alpha) * f;
+	float r = c0->red   + (c1->red   - c0->red  ) * f;
+	float g = c0->green + (c1->green - c0->green) * f;
+	float b = c0->blue  + (c1->blue  - c0->blue ) * f;
+
+	r = r * a / 65535.0;
+	g = g * a / 65535.0;
+	b = b * a / 65535.0;
+
+	return ((uint32_t)a >> 8) << 24 | ((uint32_t)r >> 8) << 16 |
+	       ((uint32_t)g >> 8) << 8 | ((uint32_t)b >> 8);
+}
+
+int
+nouveau_exa_source_pict_ramp(PicturePtr ppict, uint32_t *ramp)
+{
+	SourcePictPtr sp = ppict->pSourcePict;
+	PictGradientStopPtr stop;
+	int nstops, i, s = 0, first = 0, n = NOUVEAU_SOURCE_RAMP_SIZE;
+	Bool clamped = nouveau_exa_source_pict_clamped(ppict);
+
+	if (sp->type == SourcePictTypeSolidFill) {
+		ramp[0] = sp->solidFill.color;
+		return 1;
+	}
+
+	stop = sp->gradient.stops;
+	nstops = sp->gradient.nstops;
+
+	/* texel i holds the colour at t = (i + 0.5) / size, so that the
+	 * sampler's wrap modes match Render's repeat semantics.
+	 *
+	 * Without repeat the gradient is transparent outside [0, 1]: the
+	 * end texels are, the stops span the ones in between centre to
+	 * centre, and the sampler clamps to the edge.  Filtering then only
+	 * blends transparency in outside the gradient, never into its ends.
+	 */
+	if (clamped) {
+		ramp[0] = 0;
+		ramp[NOUVEAU_SOURCE_RAMP_SIZE - 1] = 0;
+		first = 1;
+		n = NOUVEAU_SOURCE_RAMP_SIZE - 2;
+	}
+
+	for (i = 0; i < n; i++) {
+		xFixed x = clamped ? (i << 16) / (n - 1) :
+				     ((i << 16) + 0x8000) / n;
+
+		while (s < nstops - 1 && stop[s + 1].x <= x)
+			s++;
+
+		if (x <= stop[0].x || s == nstops - 1) {
+			ramp[first + i] =
+				nouveau_exa_premultiply(&stop[s].color,
+							&stop[s].color, 0.0);
+		} else {
+			float f = (float)(x - stop[s].x) /
+				  (float)(stop[s + 1].x - stop[s].x);
+
+			ramp[first + i] =
+				nouveau_exa_premultiply(&stop[s].color,
+							&stop[s + 1].color, f);
+		}
+	}
+
+	return NOUVEAU_SOURCE_RAMP_SIZE;
+}
+
+void
+nouveau_exa_source_pict_coeffs(PicturePtr ppict, float *coeff)
+{
+	SourcePictPtr sp = ppict->pSourcePict;
+	float x1, y1, dx, dy, l;
+
+	if (sp->type == SourcePictTypeSolidFill) {
+		coeff[0] = 0.0;
+		coeff[1] = 0.0;
+		coeff[2] = 0.5;
+		return;
+	}
+
+	x1 = sp->linear.p1.x / 65536.0;
+	y1 = sp->linear.p1.y / 65536.0;
+	dx = sp->linear.p2.x / 65536.0 - x1;
+	dy = sp->linear.p2.y / 65536.0 - y1;
+	l  = dx * dx + dy * dy;
+
+	coeff[0] = dx / l;
+	coeff[1] = dy / l;
+	coeff[2] = -(x1 * dx + y1 * dy) / l;
+
+	/* t = 0 and t = 1 land on the centres of the first and last stop
+	 * texels, see nouveau_exa_source_pict_ramp()
+	 */
+	if (nouveau_exa_source_pict_clamped(ppict)) {
+		const float n = NOUVEAU_SOURCE_RAMP_SIZE;
+
+		coeff[0] *= (n - 3.0) / n;
+		coeff[1] *= (n - 3.0) / n;
+		coeff[2]  = coeff[2] * (n - 3.0) / n + 1.5 / n;
+	}
+}
+
 static Bool
 nouveau_exa_download_from_screen(PixmapPtr pspix, int x, int y, int w, int h,
 				 char *dst, int dst_pitch)
@@ -390,11 +539,11 @@ nouveau_exa_download_from_screen(PixmapPtr pspix, int x, int y, int w, int h,
 	}
 
 	bo = nouveau_pixmap_bo(pspix);
-	if (nouveau_bo_map(bo, NOUVEAU_BO_RD))
+	if (nv_bo_map(pNv, bo, NOUVEAU_BO_RD))
 		return FALSE;
 	src = (char *)bo->map + offset;
 	ret = NVAccelMemcpyRect(dst, src, h, dst_pitch, src_pitch, w*cpp);
-	nouveau_bo_unmap(bo);
+	nv_bo_unmap(pNv, bo);
 	return ret;
 }
 
@@ -455,11 +604,11 @@ nouveau_exa_upload_to_screen(PixmapPtr pdpix, int x, int y, int w, int h,
 
 	/* fallback to memcpy-based transfer */
 	bo = nouveau_pixmap_bo(pdpix);
-	if (nouveau_bo_map(bo, NOUVEAU_BO_WR))
+	if (nv_bo_map(pNv, bo, NOUVEAU_BO_WR))
 		return FALSE;
 	dst = (char *)bo->map + (y * dst_pitch) + (x * cpp);
 	ret = NVAccelMemcpyRect(dst, src, h, dst_pitch, src_pitch, w*cpp);
-	nouveau_bo_unmap(bo);
+	nv_bo_unmap(pNv, bo);
 	return ret;
 }
 
@@ -41,8 +41,23 @@
 } while(0)
 #endif
 
+/* older libdrm always synchronises in nouveau_bo_map() */
+#ifndef NOUVEAU_BO_NOSYNC
+#define NOUVEAU_BO_NOSYNC 0
+#endif
+
+/* ... and can't tell whether a buffer is busy without waiting for it, a
+ * NOWAIT map just waits there.  Paths that only probe test the flag first.
+ */
+#ifndef NOUVEAU_BO_NOWAIT
+#define NOUVEAU_BO_NOWAIT 0
+#endif
+
 #define NOUVEAU_ALIGN(x,bytes) (((x) + ((bytes) - 1)) & ~((bytes) - 1))
 
+/* Texels in the ramp used to sample solid-fill and gradient pictures */
+#define NOUVEAU_SOURCE_RAMP_SIZE 256
+
 #define NVC0_TILE_PITCH(m) (64 << ((m) & 0xf))
 #define NVC0_TILE_HEIGHT(m) (8 << ((m) >> 4))
 
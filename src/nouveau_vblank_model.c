@@ -0,0 +1,80 @@
+/*
+ * Copyright 2009 Nouveau Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "nouveau_vblank_model.h"
+
+void
+nouveau_vblank_model_update(struct nouveau_vblank_model *m, CARD64 msc,
+			    CARD64 ust)
+{
+	if (m->ust && msc == m->msc)
+		return;
+
+	if (m->ust && msc > m->msc && ust > m->ust) {
+		CARD32 period = (ust - m->ust) / (msc - m->msc);
+
+		if (m->period)
+			m->period = (3 * m->period + period) / 4;
+		else
+			m->period = period;
+	} else {
+		m->period = 0;
+	}
+
+	m->msc = msc;
+	m->ust = ust;
+}
+
+/* now is on the clock the kernel stamps vblank events with */
+Bool
+nouveau_vblank_model_predict(struct nouveau_vblank_model *m, CARD64 now,
+			     CARD64 *msc, CARD64 *ust)
+{
+	CARD64 elapsed, n;
+	CARD32 phase;
+
+	if (!m->period)
+		return FALSE;
+
+	if (now < m->ust)
+		return FALSE;
+
+	elapsed = now - m->ust;
+	if (elapsed > NOUVEAU_VBLANK_MODEL_STALE)
+		return FALSE;
+
+	n = elapsed / m->period;
+	phase = elapsed % m->period;
+	if (phase < NOUVEAU_VBLANK_MODEL_SLACK ||
+	    m->period - phase < NOUVEAU_VBLANK_MODEL_SLACK)
+		return FALSE;
+
+	if (msc)
+		*msc = m->msc + n;
+	if (ust)
+		*ust = m->ust + n * m->period;
+	return TRUE;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2009 Nouveau Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __NOUVEAU_VBLANK_MODEL_H__
+#define __NOUVEAU_VBLANK_MODEL_H__
+
+/* The vblank timing model predicts a CRTC's current MSC/UST from the last
+ * vblank it saw and the measured refresh period, so scheduling a swap or
+ * answering GetMSC doesn't have to ask the kernel.  It gives up, and we
+ * ask anyway, once it's more than STALE old or when it can't tell which
+ * side of a vblank we're on.
+ *
+ * Nothing here needs the server's headers, so vblank_model_test builds it
+ * on its own.
+ */
+
+#include <X11/Xmd.h>
+#include <X11/Xdefs.h>
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define NOUVEAU_VBLANK_MODEL_STALE	1000000 /* us */
+#define NOUVEAU_VBLANK_MODEL_SLACK	1000 /* us */
+
+/* Per-CRTC vblank timing, fed from delivered vblank events */
+struct nouveau_vblank_model {
+	CARD64 msc;
+	CARD64 ust;
+	CARD32 period; /* us, 0 until there's a second sample */
+};
+
+void nouveau_vblank_model_update(struct nouveau_vblank_model *m,
+				 CARD64 msc, CARD64 ust);
+Bool nouveau_vblank_model_predict(struct nouveau_vblank_model *m,
+				  CARD64 now, CARD64 *msc, CARD64 *ust);
+
+#endif
@@ -38,6 +38,7 @@
 #include "nv04_pushbuf.h"
 
 #include "vl_hwmc.h"
+#include "nouveau_xv_copy.h"
 
 #define IMAGE_MAX_W 2046
 #define IMAGE_MAX_H 2046
@@ -58,22 +59,12 @@
 and attempt no other allocation afterwards (performance reasons) */
 #define NO_PRIV_HOST_BUFFER_AVAILABLE 9999
 
-/* NVPutImage action flags */
-enum {
-	IS_YV12 = 1,
-	IS_YUY2 = 2,
-	CONVERT_TO_YUY2=4,
-	USE_OVERLAY=8,
-	USE_TEXTURE=16,
-	SWAP_UV=32,
-	IS_RGB=64, //I am not sure how long we will support it
-};
-
 #define MAKE_ATOM(a) MakeAtom(a, sizeof(a) - 1, TRUE)
 
 Atom xvBrightness, xvContrast, xvColorKey, xvSaturation;
 Atom xvHue, xvAutopaintColorKey, xvSetDefaults, xvDoubleBuffer;
-Atom xvITURBT709, xvSyncToVBlank, xvOnCRTCNb;
+Atom xvITURBT709, xvSyncToVBlank, xvOnCRTCNb, xvDeinterlace;
+Atom xvFilterSharpness;
 
 /* client libraries expect an encoding */
 static XF86VideoEncodingRec DummyEncoding =
@@ -132,18 +123,45 @@ XF86AttributeRec NVBlitAttributes[NUM_BLIT_ATTRIBUTES] =
 	{XvSettable | XvGettable, 0, 1, "XV_SYNC_TO_VBLANK"}
 };
 
-#define NUM_TEXTURED_ATTRIBUTES 2
+#define NUM_TEXTURED_ATTRIBUTES 3
 XF86AttributeRec NVTexturedAttributes[NUM_TEXTURED_ATTRIBUTES] =
 {
 	{XvSettable             , 0, 0, "XV_SET_DEFAULTS"},
-	{XvSettable | XvGettable, 0, 1, "XV_SYNC_TO_VBLANK"}
+	{XvSettable | XvGettable, 0, 1, "XV_SYNC_TO_VBLANK"},
+	{XvSettable | XvGettable, 0, 2, "XV_DEINTERLACE"}
+};
+
+#define NUM_BICUBIC_ATTRIBUTES 4
+XF86AttributeRec NVBicubicAttributes[NUM_BICUBIC_ATTRIBUTES] =
+{
+	{XvSettable             , 0, 0, "XV_SET_DEFAULTS"},
+	{XvSettable | XvGettable, 0, 1, "XV_SYNC_TO_VBLANK"},
+	{XvSettable | XvGettable, 0, 2, "XV_DEINTERLACE"},
+	{XvSettable | XvGettable, 0, 4, "XV_FILTER_SHARPNESS"}
+};
+
+/* NV40 also has the motion-adaptive XV_DEINTERLACE modes */
+XF86AttributeRec NVTexturedAttributesNV40[NUM_TEXTURED_ATTRIBUTES] =
+{
+	{XvSettable             , 0, 0, "XV_SET_DEFAULTS"},
+	{XvSettable | XvGettable, 0, 1, "XV_SYNC_TO_VBLANK"},
+	{XvSettable | XvGettable, 0, 4, "XV_DEINTERLACE"}
 };
 
-#define NUM_TEXTURED_ATTRIBUTES_NV50 7
+XF86AttributeRec NVBicubicAttributesNV40[NUM_BICUBIC_ATTRIBUTES] =
+{
+	{XvSettable             , 0, 0, "XV_SET_DEFAULTS"},
+	{XvSettable | XvGettable, 0, 1, "XV_SYNC_TO_VBLANK"},
+	{XvSettable | XvGettable, 0, 4, "XV_DEINTERLACE"},
+	{XvSettable | XvGettable, 0, 4, "XV_FILTER_SHARPNESS"}
+};
+
+#define NUM_TEXTURED_ATTRIBUTES_NV50 8
 XF86AttributeRec NVTexturedAttributesNV50[NUM_TEXTURED_ATTRIBUTES_NV50] =
 {
 	{ XvSettable             , 0, 0, "XV_SET_DEFAULTS" },
 	{ XvSettable | XvGettable, 0, 1, "XV_SYNC_TO_VBLANK" },
+	{ XvSettable | XvGettable, 0, 2, "XV_DEINTERLACE" },
 	{ XvSettable | XvGettable, -1000, 1000, "XV_BRIGHTNESS" },
 	{ XvSettable | XvGettable, -1000, 1000, "XV_CONTRAST" },
 	{ XvSettable | XvGettable, -1000, 1000, "XV_SATURATION" },
@@ -174,6 +192,27 @@ XF86AttributeRec NVTexturedAttributesNV50[NUM_TEXTURED_ATTRIBUTES_NV50] =
         XvTopToBottom \
    }
 
+#ifndef XVIMAGE_NV12
+#define XVIMAGE_NV12 \
+   { \
+        FOURCC_NV12, \
+        XvYUV, \
+        LSBFirst, \
+        {'N','V','1','2', \
+          0x00,0x00,0x00,0x10,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}, \
+        12, \
+        XvPlanar, \
+        2, \
+        0, 0, 0, 0, \
+        8, 8, 8, \
+        1, 2, 2, \
+        1, 2, 2, \
+        {'Y','U','V', \
+          0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, \
+        XvTopToBottom \
+   }
+#endif
+
 static XF86ImageRec NVImages[NUM_IMAGES_ALL] =
 {
 	XVIMAGE_YUY2,
@@ -230,20 +269,230 @@ NVSetPortDefaults (ScrnInfoPtr pScrn, NVPortPrivPtr pPriv)
 	pPriv->currentHostBuffer	= 0;
 }
 
+/* Video memory pool
+ *
+ * Buffers a port gives up, on a size change, after FREE_DELAY or when
+ * the video stops, are kept per screen for any port of any adapter to
+ * pick up again.  That way resizing a window, toggling fullscreen or
+ * switching streams doesn't turn into an allocation per frame.  New
+ * buffers are rounded up to a size class, so growing a little reuses
+ * what's there.  Pooled buffers are only freed once they've sat unused
+ * for NOUVEAU_XV_POOL_IDLE, or to keep the pool under its byte limit.
+ */
+#define NOUVEAU_XV_POOL_SIZE	8
+#define NOUVEAU_XV_POOL_BYTES	(32 << 20)
+#define NOUVEAU_XV_POOL_IDLE	FREE_DELAY
+
+struct nouveau_xv_pool {
+	struct {
+		struct nouveau_bo *bo;
+		unsigned flags;
+		CARD32 released;
+	} entry[NOUVEAU_XV_POOL_SIZE];
+	OsTimerPtr timer;
+	unsigned long bytes;
+	CARD32 start;
+	unsigned long allocs;
+	unsigned long alloc_bytes;
+	unsigned long hits;
+	unsigned long frees;
+};
+
+/* Rounds up to a multiple of a quarter of the size's power of two, at
+ * least 64KiB, so a class is never more than 25% bigger than asked for.
+ */
+static unsigned
+nouveau_xv_pool_class(unsigned size)
+{
+	unsigned step = 64 * 1024;
+
+	while (step < size / 4)
+		step <<= 1;
+	return (size + step - 1) & ~(step - 1);
+}
+
+static void
+nouveau_xv_pool_drop(struct nouveau_xv_pool *pool, int i)
+{
+	pool->bytes -= pool->entry[i].bo->size;
+	pool->frees++;
+	nouveau_bo_ref(NULL, &pool->entry[i].bo);
+}
+
+static CARD32
+nouveau_xv_pool_timer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+	struct nouveau_xv_pool *pool = arg;
+	Bool busy = FALSE;
+	int i;
+
+	for (i = 0; i < NOUVEAU_XV_POOL_SIZE; i++) {
+		if (!pool->entry[i].bo)
+			continue;
+
+		if ((CARD32)(now - pool->entry[i].released) >=
+		    NOUVEAU_XV_POOL_IDLE)
+			nouveau_xv_pool_drop(pool, i);
+		else
+			busy = TRUE;
+	}
+
+	return busy ? NOUVEAU_XV_POOL_IDLE : 0;
+}
+
+static void
+nouveau_xv_pool_put(NVPtr pNv, unsigned flags, struct nouveau_bo **pbo)
+{
+	struct nouveau_xv_pool *pool = pNv->xv_pool;
+	int i, slot = -1, oldest = -1;
+
+	if (!*pbo)
+		return;
+
+	if (!pool || (*pbo)->size > NOUVEAU_XV_POOL_BYTES) {
+		nouveau_bo_ref(NULL, pbo);
+		return;
+	}
+
+	for (i = 0; i < NOUVEAU_XV_POOL_SIZE; i++) {
+		if (!pool->entry[i].bo) {
+			slot = i;
+			continue;
+		}
+
+		if (oldest < 0 || (CARD32)(pool->entry[oldest].released -
+					   pool->entry[i].released) < 0x80000000)
+			oldest = i;
+	}
+
+	if (slot < 0) {
+		nouveau_xv_pool_drop(pool, oldest);
+		slot = oldest;
+	}
+
+	pool->entry[slot].bo = *pbo;
+	pool->entry[slot].flags = flags;
+	pool->entry[slot].released = GetTimeInMillis();
+	pool->bytes += (*pbo)->size;
+	*pbo = NULL;
+
+	/* over the limit, give up what's been unused the longest */
+	while (pool->bytes > NOUVEAU_XV_POOL_BYTES) {
+		oldest = -1;
+		for (i = 0; i < NOUVEAU_XV_POOL_SIZE; i++) {
+			if (!pool->entry[i].bo || i == slot)
+				continue;
+			if (oldest < 0 ||
+			    (CARD32)(pool->entry[oldest].released -
+				     pool->entry[i].released) < 0x80000000)
+				oldest = i;
+		}
+		if (oldest < 0)
+			break;
+		nouveau_xv_pool_drop(pool, oldest);
+	}
+
+	pool->timer = TimerSet(pool->timer, 0, NOUVEAU_XV_POOL_IDLE,
+			       nouveau_xv_pool_timer, pool);
+}
+
+/* Best fit, but not more than twice the size needed, a small video
+ * shouldn't sit on the buffer a big one will want next.
+ */
+static struct nouveau_bo *
+nouveau_xv_pool_get(NVPtr pNv, unsigned flags, unsigned size)
+{
+	struct nouveau_xv_pool *pool = pNv->xv_pool;
+	struct nouveau_bo *bo;
+	int i, best = -1;
+
+	if (!pool)
+		return NULL;
+
+	for (i = 0; i < NOUVEAU_XV_POOL_SIZE; i++) {
+		bo = pool->entry[i].bo;
+
+		if (!bo || pool->entry[i].flags != flags ||
+		    bo->size < size || bo->size / 2 > size)
+			continue;
+
+		if (best < 0 || bo->size < pool->entry[best].bo->size)
+			best = i;
+	}
+
+	if (best < 0)
+		return NULL;
+
+	bo = pool->entry[best].bo;
+	pool->entry[best].bo = NULL;
+	pool->bytes -= bo->size;
+	pool->hits++;
+	return bo;
+}
+
+static void
+nouveau_xv_pool_init(ScrnInfoPtr pScrn)
+{
+	NVPtr pNv = NVPTR(pScrn);
+	struct nouveau_xv_pool *pool;
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return;
+
+	pool->start = GetTimeInMillis();
+	pNv->xv_pool = pool;
+}
+
+static void
+nouveau_xv_pool_fini(ScrnInfoPtr pScrn)
+{
+	NVPtr pNv = NVPTR(pScrn);
+	struct nouveau_xv_pool *pool = pNv->xv_pool;
+	CARD32 secs;
+	int i;
+
+	if (!pool)
+		return;
+
+	TimerFree(pool->timer);
+	for (i = 0; i < NOUVEAU_XV_POOL_SIZE; i++) {
+		if (pool->entry[i].bo)
+			nouveau_xv_pool_drop(pool, i);
+	}
+
+	secs = (GetTimeInMillis() - pool->start) / 1000;
+	xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 3,
+		       "Xv memory: %lu allocations (%lu KiB, %lu/min), "
+		       "%lu reused, %lu freed\n", pool->allocs,
+		       pool->alloc_bytes >> 10,
+		       secs ? pool->allocs * 60 / secs : pool->allocs,
+		       pool->hits, pool->frees);
+
+	free(pool);
+	pNv->xv_pool = NULL;
+}
+
 static int
 nouveau_xv_bo_realloc(ScrnInfoPtr pScrn, unsigned flags, unsigned size,
 		      struct nouveau_bo **pbo)
 {
 	NVPtr pNv = NVPTR(pScrn);
+	struct nouveau_xv_pool *pool = pNv->xv_pool;
 	uint32_t tile_flags;
 	int ret;
 
 	if (*pbo) {
 		if ((*pbo)->size >= size)
 			return 0;
-		nouveau_bo_ref(NULL, pbo);
+		nouveau_xv_pool_put(pNv, flags, pbo);
 	}
 
+	*pbo = nouveau_xv_pool_get(pNv, flags, size);
+	if (*pbo)
+		return 0;
+
+	size = nouveau_xv_pool_class(size);
 	tile_flags = 0;
 	if (flags & NOUVEAU_BO_VRAM) {
 		if (pNv->Architecture == NV_ARCH_50)
@@ -258,22 +507,251 @@ nouveau_xv_bo_realloc(ScrnInfoPtr pScrn, unsigned flags, unsigned size,
 	if (ret)
 		return ret;
 
+	if (pool) {
+		pool->allocs++;
+		pool->alloc_bytes += size;
+	}
 	return 0;
 }
 
+/* With XV_SYNC_TO_VBLANK on, frames headed for the screen are rendered
+ * into a per-port intermediate and copied into place from a vblank event,
+ * rather than stalling the whole channel on the scanline. A port has at
+ * most one frame queued; a newer one simply replaces its contents.
+ *
+ * The vblank event carries this rather than the port, so that it can
+ * still be delivered safely after the port has let go of it.
+ */
+struct nouveau_xv_present {
+	int refcnt;
+	NVPortPrivPtr pPriv; /* NULL once the port is done with it */
+};
+
+static void
+nouveau_xv_present_unref(struct nouveau_xv_present *present)
+{
+	if (--present->refcnt == 0)
+		free(present);
+}
+
+/* Detaches the port from its event state, a pending event finds nothing */
+static void
+nouveau_xv_present_release(NVPortPrivPtr pPriv)
+{
+	struct nouveau_xv_present *present = pPriv->present;
+
+	if (!present)
+		return;
+
+	present->pPriv = NULL;
+	nouveau_xv_present_unref(present);
+	pPriv->present = NULL;
+	pPriv->present_pending = FALSE;
+}
+
+/**
+ * nouveau_xv_present_cancel
+ * drops the frame a port has waiting for vblank, if any
+ *
+ * @param pPriv port being stopped
+ */
+void
+nouveau_xv_present_cancel(NVPortPrivPtr pPriv)
+{
+	if (pPriv->present_pix)
+		REGION_EMPTY(pPriv->present_pix->drawable.pScreen,
+			     &pPriv->present_clip);
+}
+
+static void
+nouveau_xv_present_free(ScreenPtr pScreen, NVPortPrivPtr pPriv)
+{
+	if (!pPriv->present_pix)
+		return;
+
+	REGION_UNINIT(pScreen, &pPriv->present_clip);
+	pScreen->DestroyPixmap(pPriv->present_pix);
+	pPriv->present_pix = NULL;
+}
+
+static Bool
+nouveau_xv_present_setup(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv,
+			 PixmapPtr ppix, RegionPtr clipBoxes)
+{
+	ScreenPtr pScreen = pScrn->pScreen;
+	NVPtr pNv = NVPTR(pScrn);
+	PixmapPtr pix = pPriv->present_pix;
+	BoxPtr ext = REGION_EXTENTS(pScreen, clipBoxes);
+	int w = ext->x2 - ext->x1, h = ext->y2 - ext->y1;
+
+	if (!nouveau_exa_pixmap_is_onscreen(ppix) ||
+	    !REGION_NOTEMPTY(pScreen, clipBoxes))
+		return FALSE;
+
+	pPriv->present_crtcs = nv_window_belongs_to_crtc(pScrn, ext->x1,
+							 ext->y1, w, h);
+	if (!pPriv->present_crtcs)
+		return FALSE;
+
+	if (!pPriv->present) {
+		struct nouveau_xv_present *present;
+
+		present = calloc(1, sizeof(*present));
+		if (!present)
+			return FALSE;
+		present->refcnt = 1;
+		present->pPriv = pPriv;
+		pPriv->present = present;
+	}
+
+	/* nothing references the old one on the channel until it's copied */
+	if (pix && (pix->drawable.width != w || pix->drawable.height != h ||
+		    pix->drawable.depth != ppix->drawable.depth)) {
+		nouveau_xv_present_free(pScreen, pPriv);
+		pix = NULL;
+	}
+
+	if (!pix) {
+		pix = pScreen->CreatePixmap(pScreen, w, h,
+					    ppix->drawable.depth, 0);
+		if (!pix)
+			return FALSE;
+
+		pNv->exa_force_cp = TRUE;
+		exaMoveInPixmap(pix);
+		pNv->exa_force_cp = FALSE;
+
+		if (!exaGetPixmapDriverPrivate(pix)) {
+			pScreen->DestroyPixmap(pix);
+			return FALSE;
+		}
+
+		pPriv->present_pix = pix;
+		REGION_NULL(pScreen, &pPriv->present_clip);
+	}
+
+	pPriv->present_x = ext->x1;
+	pPriv->present_y = ext->y1;
+	return TRUE;
+}
+
+static void
+nouveau_xv_present_copy(NVPortPrivPtr pPriv)
+{
+	PixmapPtr src = pPriv->present_pix;
+	ScreenPtr pScreen = src->drawable.pScreen;
+	NVPtr pNv = NVPTR(xf86Screens[pScreen->myNum]);
+	ExaDriverPtr exa = pNv->EXADriverPtr;
+	PixmapPtr dst = pScreen->GetScreenPixmap(pScreen);
+	BoxRec bounds = { 0, 0, dst->drawable.width, dst->drawable.height };
+	RegionRec region;
+	DrawablePtr pDraw;
+	BoxPtr box;
+	int nbox;
+
+	/* The screen may have been resized, and the window moved, unmapped
+	 * or covered since the frame was queued: only paint where it's
+	 * still visible now.
+	 */
+	REGION_INIT(pScreen, &region, &bounds, 1);
+	REGION_INTERSECT(pScreen, &region, &region, &pPriv->present_clip);
+	REGION_EMPTY(pScreen, &pPriv->present_clip);
+
+	if (dixLookupDrawable(&pDraw, pPriv->present_draw, serverClient,
+			      M_ANY, DixWriteAccess) ||
+	    pDraw->type != DRAWABLE_WINDOW || !((WindowPtr)pDraw)->viewable)
+		REGION_EMPTY(pScreen, &region);
+	else
+		REGION_INTERSECT(pScreen, &region, &region,
+				 &((WindowPtr)pDraw)->clipList);
+
+	box = REGION_RECTS(&region);
+	nbox = REGION_NUM_RECTS(&region);
+	if (nbox && exa->PrepareCopy(src, dst, 1, 1, GXcopy, FB_ALLONES)) {
+		while (nbox--) {
+			exa->Copy(dst, box->x1 - pPriv->present_x,
+				  box->y1 - pPriv->present_y, box->x1, box->y1,
+				  box->x2 - box->x1, box->y2 - box->y1);
+			box++;
+		}
+		exa->DoneCopy(dst);
+		FIRE_RING(pNv->chan);
+
+#ifdef COMPOSITE
+		DamageDamageRegion(&dst->drawable, &region);
+#endif
+	}
+
+	REGION_UNINIT(pScreen, &region);
+}
+
+static int
+nouveau_xv_present_queue(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv,
+			 DrawablePtr pDraw, RegionPtr clipBoxes)
+{
+	NVPtr pNv = NVPTR(pScrn);
+	drmVBlank vbl;
+
+	REGION_COPY(pScrn->pScreen, &pPriv->present_clip, clipBoxes);
+	pPriv->present_draw = pDraw->id;
+	FIRE_RING(pNv->chan);
+
+	if (pPriv->present_pending)
+		return Success;
+
+	vbl.request.type = DRM_VBLANK_RELATIVE | DRM_VBLANK_EVENT |
+		(pPriv->present_crtcs == 2 ? DRM_VBLANK_SECONDARY : 0);
+	vbl.request.sequence = 1;
+	vbl.request.signal =
+		(unsigned long)NOUVEAU_XV_PRESENT_EVENT(pPriv->present);
+
+	if (drmWaitVBlank(nouveau_device(pNv->dev)->fd, &vbl)) {
+		/* no event coming, show it now rather than never */
+		nouveau_xv_present_copy(pPriv);
+		return Success;
+	}
+
+	((struct nouveau_xv_present *)pPriv->present)->refcnt++;
+	pPriv->present_pending = TRUE;
+	return Success;
+}
+
+void
+nouveau_xv_present_handler(int fd, unsigned int frame, unsigned int tv_sec,
+			   unsigned int tv_usec, void *event_data)
+{
+	struct nouveau_xv_present *present =
+		NOUVEAU_XV_PRESENT_DATA(event_data);
+	NVPortPrivPtr pPriv = present->pPriv;
+
+	/* the port may have been freed or stopped in the meantime */
+	if (pPriv) {
+		pPriv->present_pending = FALSE;
+		if (pPriv->present_pix)
+			nouveau_xv_present_copy(pPriv);
+	}
+
+	nouveau_xv_present_unref(present);
+}
+
 /**
  * NVFreePortMemory
- * frees memory held by a given port
+ * frees memory held by a given port, back into the video memory pool
  *
  * @param pScrn screen whose port wants to free memory
  * @param pPriv port to free memory of
  */
-static void
+void
 NVFreePortMemory(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv)
 {
-	nouveau_bo_ref(NULL, &pPriv->video_mem);
-	nouveau_bo_ref(NULL, &pPriv->TT_mem_chunk[0]);
-	nouveau_bo_ref(NULL, &pPriv->TT_mem_chunk[1]);
+	NVPtr pNv = NVPTR(pScrn);
+
+	nouveau_xv_pool_put(pNv, NOUVEAU_BO_VRAM, &pPriv->video_mem);
+	pPriv->deint_prev = -1;
+	nouveau_xv_pool_put(pNv, NOUVEAU_BO_GART, &pPriv->TT_mem_chunk[0]);
+	nouveau_xv_pool_put(pNv, NOUVEAU_BO_GART, &pPriv->TT_mem_chunk[1]);
+	nouveau_xv_present_free(pScrn->pScreen, pPriv);
+	nouveau_xv_present_release(pPriv);
 }
 
 /**
@@ -289,6 +767,8 @@ NVFreeOverlayMemory(ScrnInfoPtr pScrn)
 	NVPortPrivPtr pPriv = GET_OVERLAY_PRIVATE(pNv);
 
 	NVFreePortMemory(pScrn, pPriv);
+	pPriv->overlaySlot[0] = -1;
+	pPriv->overlaySlot[1] = -1;
 #if NVOVL_SUPPORT
 	/* "power cycle" the overlay */
 	nvWriteMC(pNv, NV_PMC_ENABLE,
@@ -438,126 +918,133 @@ NVQueryBestSize(ScrnInfoPtr pScrn, Bool motion,
 	*p_h = drw_h;
 }
 
-/**
- * NVCopyData420
- * used to convert YV12 to YUY2 for the blitter and NV04 overlay.
- * The U and V samples generated are linearly interpolated on the vertical
- * axis for better quality
- *
- * @param src1 source buffer of luma
- * @param src2 source buffer of chroma1
- * @param src3 source buffer of chroma2
- * @param dst1 destination buffer
- * @param srcPitch pitch of src1
- * @param srcPitch2 pitch of src2, src3
- * @param dstPitch pitch of dst1
- * @param h number of lines to copy
- * @param w length of lines to copy
- */
-static inline void
-NVCopyData420(unsigned char *src1, unsigned char *src2, unsigned char *src3,
-	      unsigned char *dst1, int srcPitch, int srcPitch2, int dstPitch,
-	      int h, int w)
-{
-	CARD32 *dst;
-	CARD8 *s1, *s2, *s3;
-	int i, j;
-
-#define su(X) (((j & 1) && j < (h-1)) ? ((unsigned)((signed int)s2[X] +        \
-		(signed int)(s2 + srcPitch2)[X]) / 2) : (s2[X]))
-#define sv(X) (((j & 1) && j < (h-1)) ? ((unsigned)((signed int)s3[X] +        \
-		(signed int)(s3 + srcPitch2)[X]) / 2) : (s3[X]))
-
-	w >>= 1;
-
-	for (j = 0; j < h; j++) {
-		dst = (CARD32*)dst1;
-		s1 = src1;  s2 = src2;  s3 = src3;
-		i = w;
-
-		while (i > 4) {
-#if X_BYTE_ORDER == X_BIG_ENDIAN
-		dst[0] = (s1[0] << 24) | (s1[1] << 8) | (sv(0) << 16) | su(0);
-		dst[1] = (s1[2] << 24) | (s1[3] << 8) | (sv(1) << 16) | su(1);
-		dst[2] = (s1[4] << 24) | (s1[5] << 8) | (sv(2) << 16) | su(2);
-		dst[3] = (s1[6] << 24) | (s1[7] << 8) | (sv(3) << 16) | su(3);
-#else
-		dst[0] = s1[0] | (s1[1] << 16) | (sv(0) << 8) | (su(0) << 24);
-		dst[1] = s1[2] | (s1[3] << 16) | (sv(1) << 8) | (su(1) << 24);
-		dst[2] = s1[4] | (s1[5] << 16) | (sv(2) << 8) | (su(2) << 24);
-		dst[3] = s1[6] | (s1[7] << 16) | (sv(3) << 8) | (su(3) << 24);
-#endif
-		dst += 4; s2 += 4; s3 += 4; s1 += 8;
-		i -= 4;
-		}
+#ifdef HAVE_PTHREAD
+static void
+nouveau_xv_workers_init(ScrnInfoPtr pScrn)
+{
+	NVPtr pNv = NVPTR(pScrn);
+	struct nouveau_xv_workers *w;
 
-		while (i--) {
-#if X_BYTE_ORDER == X_BIG_ENDIAN
-		dst[0] = (s1[0] << 24) | (s1[1] << 8) | (sv(0) << 16) | su(0);
-#else
-		dst[0] = s1[0] | (s1[1] << 16) | (sv(0) << 8) | (su(0) << 24);
-#endif
-		dst++; s2++; s3++;
-		s1 += 2;
-		}
+	if (!pNv->xv_threads)
+		return;
 
-		dst1 += dstPitch;
-		src1 += srcPitch;
-		if (j & 1) {
-			src2 += srcPitch2;
-			src3 += srcPitch2;
-		}
+	w = nouveau_xv_workers_start(pNv->xv_threads);
+	if (!w)
+		return;
+
+	if (w->nthreads < pNv->xv_threads) {
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			   "Only started %d of %d Xv copy threads\n",
+			   w->nthreads, pNv->xv_threads);
 	}
+
+	pNv->xv_workers = w;
+}
+
+static void
+nouveau_xv_workers_fini(ScrnInfoPtr pScrn)
+{
+	NVPtr pNv = NVPTR(pScrn);
+	struct nouveau_xv_workers *w = pNv->xv_workers;
+
+	if (!w)
+		return;
+
+	xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 3,
+		       "Xv copy threads: %lu frames split %d ways\n",
+		       w->frames, w->nthreads + 1);
+
+	nouveau_xv_workers_stop(w);
+	pNv->xv_workers = NULL;
+}
+#endif
+
+static Bool
+NVM2MFCopy(NVPtr pNv, struct nouveau_bo *src, int src_offset, int src_pitch,
+	   struct nouveau_bo *dst, int dst_offset, int dst_pitch,
+	   int line_len, int nlines, int out_inc)
+{
+	struct nouveau_channel *chan = pNv->chan;
+	struct nouveau_grobj *m2mf = pNv->NvMemFormat;
+
+	BEGIN_RING(chan, m2mf, NV04_MEMORY_TO_MEMORY_FORMAT_OFFSET_IN, 8);
+	if (OUT_RELOCl(chan, src, src_offset,
+		       NOUVEAU_BO_GART | NOUVEAU_BO_RD) ||
+	    OUT_RELOCl(chan, dst, dst_offset,
+		       NOUVEAU_BO_VRAM | NOUVEAU_BO_WR))
+		return FALSE;
+	OUT_RING  (chan, src_pitch);
+	OUT_RING  (chan, dst_pitch);
+	OUT_RING  (chan, line_len);
+	OUT_RING  (chan, nlines);
+	OUT_RING  (chan, (out_inc << 8) | 1); /* output, input byte steps */
+	OUT_RING  (chan, 0);
+	return TRUE;
 }
 
 /**
- * NVCopyNV12ColorPlanes
- * Used to convert YV12 color planes to NV12 (interleaved UV) for the overlay
+ * NVUploadPlanes
+ * uploads YV12 planes packed in the staging buffer by NVCopyStripe, and
+ * has the M2MF interleave them on the way.  Writing each source byte 2
+ * or 4 bytes apart makes the chroma of NV12, or all of YUY2.  For YUY2
+ * each chroma line goes to two lines, where the CPU conversion would
+ * interpolate.
  *
- * @param src1 source buffer of chroma1
- * @param dst1 destination buffer
- * @param h number of lines to copy
- * @param w length of lines to copy
- * @param id source pixel format (YV12 or I420)
+ * @param w width of the luma plane, its pitch in the staging buffer
+ * @param h number of lines of luma
  */
-static inline void
-NVCopyNV12ColorPlanes(unsigned char *src1, unsigned char *src2,
-		      unsigned char *dst, int dstPitch, int srcPitch2,
-		      int h, int w)
-{
-	int i, j, l, e;
-
-	w >>= 1;
-	h >>= 1;
-	l = w >> 1;
-	e = w & 1;
-
-	for (j = 0; j < h; j++) {
-		unsigned char *us = src1;
-		unsigned char *vs = src2;
-		unsigned int *vuvud = (unsigned int *) dst;
-
-		for (i = 0; i < l; i++) {
-#if X_BYTE_ORDER == X_BIG_ENDIAN
-			*vuvud++ = (vs[0]<<24) | (us[0]<<16) | (vs[1]<<8) | us[1];
-#else
-			*vuvud++ = vs[0] | (us[0]<<8) | (vs[1]<<16) | (us[1]<<24);
-#endif
-			us+=2;
-			vs+=2;
-		}
+static Bool
+NVUploadPlanes(NVPtr pNv, struct nouveau_bo *src, struct nouveau_bo *dst,
+	       int offset, int uv_offset, int dstPitch, int w, int h,
+	       Bool yuy2)
+{
+	int cw = w >> 1, ch = h >> 1;
+	int a = w * h, b = a + cw * ch;
+
+	if (yuy2) {
+		/* Y0 U Y1 V, U is the plane at a */
+		return NVM2MFCopy(pNv, src, 0, w, dst, offset,
+				  dstPitch, w, h, 2) &&
+		       NVM2MFCopy(pNv, src, a, cw, dst, offset + 1,
+				  dstPitch * 2, cw, ch, 4) &&
+		       NVM2MFCopy(pNv, src, a, cw, dst, offset + dstPitch + 1,
+				  dstPitch * 2, cw, ch, 4) &&
+		       NVM2MFCopy(pNv, src, b, cw, dst, offset + 3,
+				  dstPitch * 2, cw, ch, 4) &&
+		       NVM2MFCopy(pNv, src, b, cw, dst, offset + dstPitch + 3,
+				  dstPitch * 2, cw, ch, 4);
+	}
 
-		if (e) {
-			unsigned short *vud = (unsigned short *) vuvud;
+	return NVM2MFCopy(pNv, src, 0, w, dst, offset, dstPitch, w, h, 1) &&
+	       NVM2MFCopy(pNv, src, a, cw, dst, offset + uv_offset,
+			  dstPitch, cw, ch, 2) &&
+	       NVM2MFCopy(pNv, src, b, cw, dst, offset + uv_offset + 1,
+			  dstPitch, cw, ch, 2);
+}
 
-			*vud = vs[0] | (us[0]<<8);
-		}
+/**
+ * NVCopyFrame
+ * does the CPU side of an upload, spread over the copy threads if the
+ * image is bigger than XvThreadPixels
+ */
+static void
+NVCopyFrame(ScrnInfoPtr pScrn, struct nv_xv_copy *c, int nlines)
+{
+#ifdef HAVE_PTHREAD
+	struct nouveau_xv_workers *w = NVPTR(pScrn)->xv_workers;
+#endif
+
+	c->nlines = nlines;
 
-		dst += dstPitch;
-		src1 += srcPitch2;
-		src2 += srcPitch2;
+#ifdef HAVE_PTHREAD
+	if (w && w->nthreads &&
+	    c->npixels * nlines > NVPTR(pScrn)->xv_thread_pixels) {
+		nouveau_xv_workers_copy(w, c);
+		return;
 	}
+#endif
 
+	NVCopyStripe(c, 0, nlines);
 }
 
 
@@ -707,6 +1194,17 @@ NV_calculate_pitches_and_mem_size(NVPtr pNv, int action_flags, int *srcPitch,
 		nlines = (nlines + 7) & ~7;
 	}
 
+	if (action_flags & IS_NV12) {
+		*srcPitch = (width + 3) & ~3;	/* of luma */
+		*s2offset = *srcPitch * height;
+		*srcPitch2 = *srcPitch; /* of interleaved chroma */
+		*s3offset = *s2offset;
+		*dstPitch = (npixels + 63) & ~63; /*luma and chroma pitch*/
+		*line_len = npixels;
+		*uv_offset = nlines * *dstPitch;
+		*newFBSize = *uv_offset + (nlines >> 1) * *dstPitch;
+		*newTTSize = *uv_offset + (nlines >> 1) * *dstPitch;
+	} else
 	if (action_flags & IS_YV12) {
 		*srcPitch = (width + 3) & ~3;	/* of luma */
 		*s2offset = *srcPitch * height;
@@ -749,9 +1247,9 @@ NV_calculate_pitches_and_mem_size(NVPtr pNv, int action_flags, int *srcPitch,
 		*s3offset = tmp;
 	}
 
-	/* Overlay double buffering... */
+	/* Overlay frame ring... */
 	if (action_flags & USE_OVERLAY)
-                (*newFBSize) <<= 1;
+                (*newFBSize) *= NV_OVERLAY_BUFFERS;
 
 	return 0;
 }
@@ -785,6 +1283,9 @@ NV_set_action_flags(ScrnInfoPtr pScrn, DrawablePtr pDraw, NVPortPrivPtr pPriv,
 	if (id == FOURCC_YV12 || id == FOURCC_I420)
 		*action_flags |= IS_YV12;
 
+	if (id == FOURCC_NV12) /* same 4:2:0 geometry as YV12 */
+		*action_flags |= IS_YV12 | IS_NV12;
+
 	if (id == FOURCC_RGB) /*How long will we support it?*/
 		*action_flags |= IS_RGB;
 
@@ -936,16 +1437,24 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 	 * and lines we are interested in
 	 */
 	int top = 0, left = 0, right = 0, bottom = 0, npixels = 0, nlines = 0;
+	/* deinterlacing: field shown, height the source planes are laid out
+	 * for, and the field's vertical offset in the source coordinates
+	 */
+	int field = pPriv->deinterlace, frame_height = height;
+	INT32 field_y = 0;
+	/* motion-adaptive deinterlacing: size of one of the two frames */
+	int frame_size = 0;
 	struct nouveau_channel *chan = pNv->chan;
 	struct nouveau_grobj *m2mf = pNv->NvMemFormat;
-	Bool skip = FALSE;
+	Bool present = FALSE;
 	BoxRec dstBox;
 	CARD32 tmp = 0;
 	int line_len = 0; /* length of a line, like npixels, but in bytes */
 	struct nouveau_bo *destination_buffer = NULL;
 	int action_flags; /* what shall we do? */
+	struct nv_xv_copy copy; /* the CPU side of the upload */
 	unsigned char *map;
-	int ret, i;
+	int ret;
 
 	if (pPriv->grabbedByV4L)
 		return Success;
@@ -954,6 +1463,20 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 	NV_set_action_flags(pScrn, pDraw, pPriv, id, drw_x, drw_y, drw_w,
 			    drw_h, &action_flags);
 
+	/* Bob deinterlacing: only the chosen field is uploaded, as an image
+	 * of half the height, and the scaler stretches it back over the
+	 * frame. The bottom field is moved down by half a field line.
+	 */
+	if (action_flags & IS_RGB)
+		field = NV_DEINTERLACE_WEAVE;
+	if (field == NV_DEINTERLACE_TOP || field == NV_DEINTERLACE_BOTTOM) {
+		height >>= 1;
+		src_y >>= 1;
+		src_h >>= 1;
+		if (field == NV_DEINTERLACE_BOTTOM)
+			field_y = -0x8000;
+	}
+
 	if (NV_set_dimensions(pScrn, action_flags, &xa, &xb, &ya, &yb,
 			      &src_x,  &src_y, &src_w, &src_h,
 			      &drw_x, &drw_y, &drw_w, &drw_h,
@@ -966,9 +1489,33 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 					      &s3offset, &uv_offset,
 					      &newFBSize, &newTTSize,
 					      &line_len, npixels, nlines,
-					      width, height))
+					      width, frame_height))
 		return BadImplementation;
 
+	/* Motion-adaptive deinterlacing uploads whole frames like weave, but
+	 * the shader also reads the previous one: frames alternate between
+	 * the two halves of video_mem.
+	 */
+	if (field == NV_DEINTERLACE_ADAPTIVE_TOP ||
+	    field == NV_DEINTERLACE_ADAPTIVE_BOTTOM) {
+		frame_size = (newFBSize + 255) & ~255;
+		newFBSize = frame_size * 2;
+	}
+
+	/* The planes are laid out for the whole frame, step over the other
+	 * field's lines. buf moves to the bottom field's first luma line,
+	 * the chroma offsets are relative to it.
+	 */
+	if (field == NV_DEINTERLACE_TOP || field == NV_DEINTERLACE_BOTTOM) {
+		if (field == NV_DEINTERLACE_BOTTOM) {
+			buf += srcPitch;
+			s2offset += srcPitch2 - srcPitch;
+			s3offset += srcPitch2 - srcPitch;
+		}
+		srcPitch <<= 1;
+		srcPitch2 <<= 1;
+	}
+
 	/* There are some cases (tvtime with overscan for example) where the
 	 * input image is larger (width/height) than the source rectangle for
 	 * the overlay (src_w, src_h). In those cases, we try to do something
@@ -977,12 +1524,29 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 	if (action_flags & IS_YUY2 || action_flags & IS_RGB)
 		buf += (top * srcPitch) + left;
 
+	if (action_flags & IS_NV12) {
+		/* "left" is even, so this lands on a U sample */
+		tmp = ((top >> 1) * srcPitch2) + left;
+		s2offset += tmp;
+		s3offset += tmp;
+	} else
 	if (action_flags & IS_YV12) {
 		tmp = ((top >> 1) * srcPitch2) + (left >> 1);
 		s2offset += tmp;
 		s3offset += tmp;
 	}
 
+	copy.action_flags = action_flags;
+	copy.src = buf;
+	if (action_flags & IS_YV12)
+		copy.src += (top * srcPitch) + left;
+	copy.src2 = buf + s2offset;
+	copy.src3 = buf + s3offset;
+	copy.src_pitch = srcPitch;
+	copy.src_pitch2 = srcPitch2;
+	copy.line_len = line_len;
+	copy.npixels = npixels;
+
 	ret = nouveau_xv_bo_realloc(pScrn, NOUVEAU_BO_VRAM, newFBSize,
 				    &pPriv->video_mem);
 	if (ret)
@@ -998,24 +1562,53 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 	}
 #endif
 
-	/* The overlay supports hardware double buffering. We handle this here*/
+	/* The overlay flips between two hardware buffers, which we point
+	 * into a ring of NV_OVERLAY_BUFFERS frames. We handle this here.
+	 */
 	offset = 0;
 #ifdef NVOVL_SUPPORT
 	if (pPriv->doubleBuffer) {
 		int mask = 1 << (pPriv->currentBuffer << 2);
+		int slot;
 
-		/* overwrite the newest buffer if there's not one free */
-		if (nvReadVIDEO(pNv, NV_PVIDEO_BUFFER) & mask) {
-			if (!pPriv->currentBuffer)
-				offset += newFBSize >> 1;
-			skip = TRUE;
-		} else {
-			if (pPriv->currentBuffer)
-				offset += newFBSize >> 1;
+		/* upload to a frame neither buffer shows, it's never busy */
+		for (slot = 0; slot < NV_OVERLAY_BUFFERS; slot++) {
+			if (slot != pPriv->overlaySlot[0] &&
+			    slot != pPriv->overlaySlot[1])
+				break;
 		}
+		offset += slot * (newFBSize / NV_OVERLAY_BUFFERS);
+
+		/* If the buffer due next is still in use, the newest one hasn't
+		 * flipped in yet: repoint that one, dropping its older frame.
+		 */
+		if (nvReadVIDEO(pNv, NV_PVIDEO_BUFFER) & mask)
+			pPriv->currentBuffer ^= 1;
+		pPriv->overlaySlot[pPriv->currentBuffer] = slot;
 	}
 #endif
 
+	if (frame_size) {
+		/* The previous frame is only worth comparing against if it
+		 * covers the same source area. "top" is even for the planar
+		 * formats, so row parity, and with it the field, holds.
+		 */
+		if (pPriv->deint_prev >= 0 &&
+		    (pPriv->deint_box.x1 != left ||
+		     pPriv->deint_box.y1 != top ||
+		     pPriv->deint_box.x2 != left + npixels ||
+		     pPriv->deint_box.y2 != top + nlines))
+			pPriv->deint_prev = -1;
+
+		if (pPriv->deint_prev == 0)
+			offset = frame_size;
+		pPriv->deint_box.x1 = left;
+		pPriv->deint_box.y1 = top;
+		pPriv->deint_box.x2 = left + npixels;
+		pPriv->deint_box.y2 = top + nlines;
+	} else
+		pPriv->deint_prev = -1;
+
 	/* Now we take a decision regarding the way we send the data to the
 	 * card.
 	 *
@@ -1040,7 +1633,8 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 						    newTTSize,
 						    &pPriv->TT_mem_chunk[1]);
 			if (ret) {
-				nouveau_bo_ref(NULL, &pPriv->TT_mem_chunk[0]);
+				nouveau_xv_pool_put(pNv, NOUVEAU_BO_GART,
+						    &pPriv->TT_mem_chunk[0]);
 				pPriv->currentHostBuffer =
 					NO_PRIV_HOST_BUFFER_AVAILABLE;
 			}
@@ -1070,46 +1664,29 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 
 	if (newTTSize <= destination_buffer->size) {
 		unsigned char *dst;
-		int i = 0;
 
 		/* Upload to GART */
-		nouveau_bo_map(destination_buffer, NOUVEAU_BO_WR);
+		nv_bo_map(pNv, destination_buffer, NOUVEAU_BO_WR);
 		dst = destination_buffer->map;
 
-		if (action_flags & IS_YV12) {
-			if (action_flags & CONVERT_TO_YUY2) {
-				NVCopyData420(buf + (top * srcPitch) + left,
-					      buf + s2offset, buf + s3offset,
-					      dst, srcPitch, srcPitch2,
-					      line_len, nlines, npixels);
-			} else {
-				/* Native YV12 */
-				unsigned char *tbuf = buf + top *
-						      srcPitch + left;
-				unsigned char *tdst = dst;
-
-				/* luma upload */
-				for (i = 0; i < nlines; i++) {
-					memcpy(tdst, tbuf, line_len);
-					tdst += line_len;
-					tbuf += srcPitch;
-				}
-				dst += line_len * nlines;
+		copy.dst = dst;
+		copy.dst_uv = dst + line_len * nlines;
+		copy.dst_pitch = line_len;
 
-				NVCopyNV12ColorPlanes(buf + s2offset,
-						      buf + s3offset, dst,
-						      line_len, srcPitch2,
-						      nlines, line_len);
-			}
-		} else {
-			for (i = 0; i < nlines; i++) {
-				memcpy(dst, buf, line_len);
-				dst += line_len;
-				buf += srcPitch;
-			}
+		/* Before NV50 the destination is linear, and the M2MF can
+		 * do the interleaving, leaving the CPU straight plane copies.
+		 */
+		if ((action_flags & IS_YV12) && !(action_flags & IS_NV12) &&
+		    pNv->Architecture < NV_ARCH_50) {
+			copy.action_flags |= PLANAR_UPLOAD;
+			copy.line_len = npixels;
+			copy.dst_pitch = npixels;
+			copy.dst_uv = dst + npixels * nlines;
 		}
 
-		nouveau_bo_unmap(destination_buffer);
+		NVCopyFrame(pScrn, &copy, nlines);
+
+		nv_bo_unmap(pNv, destination_buffer);
 
 		if (pNv->Architecture >= NV_ARCH_C0) {
 			nvc0_xv_m2mf(m2mf, pPriv->video_mem, uv_offset, dstPitch,
@@ -1117,7 +1694,7 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 			goto put_image;
 		}
 
-		if (MARK_RING(chan, 64, 4))
+		if (MARK_RING(chan, 64, 10))
 			return FALSE;
 
 		BEGIN_RING(chan, m2mf,
@@ -1140,17 +1717,44 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 		}
 
 		/* DMA to VRAM */
-		if ( (action_flags & IS_YV12) &&
-		    !(action_flags & CONVERT_TO_YUY2)) {
-			/* we start the color plane transfer separately */
+		if (copy.action_flags & PLANAR_UPLOAD) {
+			if (!NVUploadPlanes(pNv, destination_buffer,
+					    pPriv->video_mem, offset,
+					    uv_offset, dstPitch, npixels,
+					    nlines, action_flags &
+					    CONVERT_TO_YUY2)) {
+				MARK_UNDO(chan);
+				return BadAlloc;
+			}
+		} else {
+			if ( (action_flags & IS_YV12) &&
+			    !(action_flags & CONVERT_TO_YUY2)) {
+				/* we start the color plane transfer separately */
+
+				BEGIN_RING(chan, m2mf,
+					   NV04_MEMORY_TO_MEMORY_FORMAT_OFFSET_IN, 8);
+				if (OUT_RELOCl(chan, destination_buffer,
+					       line_len * nlines,
+					       NOUVEAU_BO_GART | NOUVEAU_BO_RD) ||
+				    OUT_RELOCl(chan, pPriv->video_mem,
+					       offset + uv_offset,
+					       NOUVEAU_BO_VRAM | NOUVEAU_BO_WR)) {
+					MARK_UNDO(chan);
+					return BadAlloc;
+				}
+				OUT_RING  (chan, line_len);
+				OUT_RING  (chan, dstPitch);
+				OUT_RING  (chan, line_len);
+				OUT_RING  (chan, (nlines >> 1));
+				OUT_RING  (chan, (1<<8)|1);
+				OUT_RING  (chan, 0);
+			}
 
 			BEGIN_RING(chan, m2mf,
 				   NV04_MEMORY_TO_MEMORY_FORMAT_OFFSET_IN, 8);
-			if (OUT_RELOCl(chan, destination_buffer,
-				       line_len * nlines,
+			if (OUT_RELOCl(chan, destination_buffer, 0,
 				       NOUVEAU_BO_GART | NOUVEAU_BO_RD) ||
-			    OUT_RELOCl(chan, pPriv->video_mem,
-				       offset + uv_offset,
+			    OUT_RELOCl(chan, pPriv->video_mem, offset,
 				       NOUVEAU_BO_VRAM | NOUVEAU_BO_WR)) {
 				MARK_UNDO(chan);
 				return BadAlloc;
@@ -1158,101 +1762,23 @@ NVPutImage(ScrnInfoPtr pScrn, short src_x, short src_y, short drw_x,
 			OUT_RING  (chan, line_len);
 			OUT_RING  (chan, dstPitch);
 			OUT_RING  (chan, line_len);
-			OUT_RING  (chan, (nlines >> 1));
+			OUT_RING  (chan, nlines);
 			OUT_RING  (chan, (1<<8)|1);
 			OUT_RING  (chan, 0);
 		}
-
-		BEGIN_RING(chan, m2mf,
-			   NV04_MEMORY_TO_MEMORY_FORMAT_OFFSET_IN, 8);
-		if (OUT_RELOCl(chan, destination_buffer, 0,
-			       NOUVEAU_BO_GART | NOUVEAU_BO_RD) ||
-		    OUT_RELOCl(chan, pPriv->video_mem, offset,
-			       NOUVEAU_BO_VRAM | NOUVEAU_BO_WR)) {
-			MARK_UNDO(chan);
-			return BadAlloc;
-		}
-		OUT_RING  (chan, line_len);
-		OUT_RING  (chan, dstPitch);
-		OUT_RING  (chan, line_len);
-		OUT_RING  (chan, nlines);
-		OUT_RING  (chan, (1<<8)|1);
-		OUT_RING  (chan, 0);
 	} else {
 CPU_copy:
-		nouveau_bo_map(pPriv->video_mem, NOUVEAU_BO_WR);
+		nv_bo_map(pNv, pPriv->video_mem, NOUVEAU_BO_WR);
 		map = pPriv->video_mem->map + offset;
 
-		if (action_flags & IS_YV12) {
-			if (action_flags & CONVERT_TO_YUY2) {
-				NVCopyData420(buf + (top * srcPitch) + left,
-					      buf + s2offset, buf + s3offset,
-					      map, srcPitch, srcPitch2,
-					      dstPitch, nlines, npixels);
-			} else {
-				unsigned char *tbuf =
-					buf + left + top * srcPitch;
-
-				for (i = 0; i < nlines; i++) {
-					int dwords = npixels << 1;
-
-					while (dwords & ~0x03) {
-						*map = *tbuf;
-						*(map + 1) = *(tbuf + 1);
-						*(map + 2) = *(tbuf + 2);
-						*(map + 3) = *(tbuf + 3);
-						map += 4;
-						tbuf += 4;
-						dwords -= 4;
-					}
-
-					switch (dwords) {
-					case 3: *(map + 2) = *(tbuf + 2);
-					case 2: *(map + 1) = *(tbuf + 1);
-					case 1: *map = *tbuf;
-					}
-
-					map += dstPitch - (npixels << 1);
-					tbuf += srcPitch - (npixels << 1);
-				}
-
-				NVCopyNV12ColorPlanes(buf + s2offset,
-						      buf + s3offset,
-						      map, dstPitch, srcPitch2,
-						      nlines, line_len);
-			}
-		} else {
-			/* YUY2 and RGB */
-			for (i = 0; i < nlines; i++) {
-				int dwords = npixels << 1;
-
-				while (dwords & ~0x03) {
-					*map = *buf;
-					*(map + 1) = *(buf + 1);
-					*(map + 2) = *(buf + 2);
-					*(map + 3) = *(buf + 3);
-					map += 4;
-					buf += 4;
-					dwords -= 4;
-				}
-
-				switch (dwords) {
-				case 3: *(map + 2) = *(buf + 2);
-				case 2: *(map + 1) = *(buf + 1);
-				case 1: *map = *buf;
-				}
-
-				map += dstPitch - (npixels << 1);
-				buf += srcPitch - (npixels << 1);
-			}
-		}
+		copy.dst = map;
+		copy.dst_uv = map + uv_offset;
+		copy.dst_pitch = dstPitch;
+		NVCopyFrame(pScrn, &copy, nlines);
 
-		nouveau_bo_unmap(pPriv->video_mem);
+		nv_bo_unmap(pNv, pPriv->video_mem);
 	}
 
-	if (skip)
-		return Success;
-
 	if (pPriv->currentHostBuffer != NO_PRIV_HOST_BUFFER_AVAILABLE)
 		pPriv->currentHostBuffer ^= 1;
 
@@ -1282,6 +1808,19 @@ put_image:
 			dstBox.y2 -= ppix->screen_y;
 		}
 #endif
+
+		/* Render off to the side, to be copied over at vblank */
+		if (pPriv->SyncToVBlank &&
+		    nouveau_xv_present_setup(pScrn, pPriv, ppix, clipBoxes)) {
+			REGION_TRANSLATE(pScrn->pScreen, clipBoxes,
+					 -pPriv->present_x, -pPriv->present_y);
+			dstBox.x1 -= pPriv->present_x;
+			dstBox.x2 -= pPriv->present_x;
+			dstBox.y1 -= pPriv->present_y;
+			dstBox.y2 -= pPriv->present_y;
+			ppix = pPriv->present_pix;
+			present = TRUE;
+		}
 	}
 
 	if (action_flags & USE_OVERLAY) {
@@ -1304,40 +1843,46 @@ put_image:
 	if (action_flags & USE_TEXTURE) {
 		int ret = BadImplementation;
 
+		if (!NVAccelInit3D(pScrn))
+			return BadAlloc;
+
 		if (pNv->Architecture == NV_ARCH_30) {
 			ret = NV30PutTextureImage(pScrn, pPriv->video_mem,
 						  offset, uv_offset,
-						  id, dstPitch, &dstBox, 0, 0,
-						  xb, yb, npixels, nlines,
+						  id, dstPitch, &dstBox, 0, field_y,
+						  xb, yb + field_y, npixels, nlines,
 						  src_w, src_h, drw_w, drw_h,
 						  clipBoxes, ppix, pPriv);
 		} else
 		if (pNv->Architecture == NV_ARCH_40) {
 			ret = NV40PutTextureImage(pScrn, pPriv->video_mem, 
 						  offset, uv_offset,
-						  id, dstPitch, &dstBox, 0, 0,
-						  xb, yb, npixels, nlines,
+						  id, dstPitch, &dstBox, 0, field_y,
+						  xb, yb + field_y, npixels, nlines,
 						  src_w, src_h, drw_w, drw_h,
 						  clipBoxes, ppix, pPriv);
 		} else
 		if (pNv->Architecture == NV_ARCH_50) {
 			ret = nv50_xv_image_put(pScrn, pPriv->video_mem,
 						offset, uv_offset,
-						id, dstPitch, &dstBox, 0, 0,
-						xb, yb, npixels, nlines,
+						id, dstPitch, &dstBox, 0, field_y,
+						xb, yb + field_y, npixels, nlines,
 						src_w, src_h, drw_w, drw_h,
 						clipBoxes, ppix, pPriv);
 		} else {
 			ret = nvc0_xv_image_put(pScrn, pPriv->video_mem,
 						offset, uv_offset,
-						id, dstPitch, &dstBox, 0, 0,
-						xb, yb, npixels, nlines,
+						id, dstPitch, &dstBox, 0, field_y,
+						xb, yb + field_y, npixels, nlines,
 						src_w, src_h, drw_w, drw_h,
 						clipBoxes, ppix, pPriv);
 		}
 
 		if (ret != Success)
 			return ret;
+
+		if (frame_size)
+			pPriv->deint_prev = offset;
 	} else {
 		ret = NVPutBlitImage(pScrn, pPriv->video_mem, offset, id,
 				     dstPitch, &dstBox, 0, 0, xb, yb, npixels,
@@ -1347,6 +1892,13 @@ put_image:
 			return ret;
 	}
 
+	if (present) {
+		REGION_TRANSLATE(pScrn->pScreen, clipBoxes,
+				 pPriv->present_x, pPriv->present_y);
+		return nouveau_xv_present_queue(pScrn, pPriv, pDraw,
+						clipBoxes);
+	}
+
 #ifdef COMPOSITE
 	/* Damage tracking */
 	if (!(action_flags & USE_OVERLAY))
@@ -1413,6 +1965,16 @@ NVQueryImageAttributes(ScrnInfoPtr pScrn, int id,
 			offsets[2] = size; // 5/4*number of pixels in "rounded up" image
 		size += tmp; // = 3/2*number of pixels in "rounded up" image
 		break;
+	case FOURCC_NV12:
+		*h = (*h + 1) & ~1; // height rounded up to an even number
+		size = (*w + 3) & ~3; // width rounded up to a multiple of 4
+		if (pitches)
+			pitches[0] = pitches[1] = size; // UV pairs, same pitch as Y
+		size *= *h;
+		if (offsets)
+			offsets[1] = size; // number of pixels in "rounded up" image
+		size += size >> 1; // = 3/2*number of pixels in "rounded up" image
+		break;
 	case FOURCC_UYVY:
 	case FOURCC_YUY2:
 		size = *w << 1; // 2*width
@@ -1570,6 +2132,7 @@ NVDisplaySurface(XF86SurfacePtr surface,
 	dstBox.y2 -= pScrn->frameY0;
 
 	pPriv->currentBuffer = 0;
+	pPriv->overlaySlot[0] = -1;
 
 	NV10PutOverlayImage(pScrn, pPriv->video_mem, surface->offsets[0],
 			    0, surface->id, surface->pitches[0], &dstBox,
@@ -1698,6 +2261,8 @@ NVSetupOverlayVideoAdapter(ScreenPtr pScreen)
 
 	pPriv->videoStatus		= 0;
 	pPriv->currentBuffer		= 0;
+	pPriv->overlaySlot[0]		= -1;
+	pPriv->overlaySlot[1]		= -1;
 	pPriv->grabbedByV4L		= FALSE;
 	pPriv->blitter			= FALSE;
 	pPriv->texture			= FALSE;
@@ -1831,6 +2396,114 @@ NVSetupOverlayVideo(ScreenPtr pScreen)
 	return overlayAdaptor;
 }
 
+/*
+ * Weight tables for the bicubic adapters, one per sharpness setting. They
+ * are all built at once into xv_filtertable_mem, so that a port changing
+ * its sharpness only points its texture somewhere else.
+ */
+#define NV_FILTER_TABLES	(NV_FILTER_SHARPNESS_MAX + 1)
+#define NV_FILTER_TABLE_BYTES	(NV_FILTER_TABLE_SIZE * 4)
+
+/*
+ * The cubics are the family defined in "Reconstruction Filters in Computer
+ * Graphics", Mitchell & Netravali in SIGGRAPH '88. Only C=0 is used, those
+ * are the ones without negative lobes, sharpness walks from the B-spline
+ * (B=1) to the cubic Hermite (B=0).
+ */
+static double
+nouveau_xv_filter_func(int sharpness, double x)
+{
+	double B = 1.0 - (double)sharpness / NV_FILTER_SHARPNESS_MAX;
+
+	x = fabs(x);
+
+	if (x < 1.0)
+		return ((12.0 - 9.0 * B) * x * x * x +
+			(-18.0 + 12.0 * B) * x * x +
+			(6.0 - 2.0 * B)) / 6.0;
+	if (x < 2.0)
+		return B * (2.0 - x) * (2.0 - x) * (2.0 - x) / 6.0;
+	return 0.0;
+}
+
+static int8_t
+nouveau_xv_filter_sb8(double v)
+{
+	return (int8_t)(v * 127.0);
+}
+
+/*
+ * Implements the filtering as described in "Fast Third-Order Texture
+ * Filtering", Sigg & Hadwiger in GPU Gems 2: two linear fetches at the
+ * stored offsets, mixed by the stored weight. Each pair of taps has to
+ * have weights of the same sign for its fetch to reproduce it, which the
+ * C=0 cubics guarantee, and they sum to one without normalising.
+ */
+static void
+nouveau_xv_filter_compute(int8_t *t, int sharpness)
+{
+	double x, w0, w1, w2, w3;
+	int i;
+
+	for (i = 0; i < NV_FILTER_TABLE_SIZE; i++) {
+		x = (i + 0.5) / NV_FILTER_TABLE_SIZE;
+
+		w0 = nouveau_xv_filter_func(sharpness, x + 1.0);
+		w1 = nouveau_xv_filter_func(sharpness, x);
+		w2 = nouveau_xv_filter_func(sharpness, x - 1.0);
+		w3 = nouveau_xv_filter_func(sharpness, x - 2.0);
+
+		t[4 * i + 2] = nouveau_xv_filter_sb8(1.0 + x - w1 / (w0 + w1));
+		t[4 * i + 1] = nouveau_xv_filter_sb8(1.0 - x + w3 / (w2 + w3));
+		t[4 * i + 0] = nouveau_xv_filter_sb8(w0 + w1);
+		t[4 * i + 3] = nouveau_xv_filter_sb8(0.0);
+	}
+}
+
+/**
+ * NVXvFilterTable
+ * finds the weight table of the port's sharpness, building all of them into
+ * VRAM the first time around
+ *
+ * @param pScrn screen
+ * @param pPriv bicubic texture port
+ * @return offset of the table in xv_filtertable_mem, -1 if there is none
+ */
+int
+NVXvFilterTable(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv)
+{
+	NVPtr pNv = NVPTR(pScrn);
+	int i;
+
+	if (!pNv->xv_filtertable_mem) {
+		if (nouveau_bo_new(pNv->dev, NOUVEAU_BO_VRAM | NOUVEAU_BO_GART |
+				   NOUVEAU_BO_MAP, 0,
+				   NV_FILTER_TABLES * NV_FILTER_TABLE_BYTES,
+				   &pNv->xv_filtertable_mem)) {
+			xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+				   "Couldn't alloc filter table!\n");
+			return -1;
+		}
+
+		if (nv_bo_map(pNv, pNv->xv_filtertable_mem,
+			      NOUVEAU_BO_RDWR | NOUVEAU_BO_NOSYNC)) {
+			xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+				   "Couldn't map filter table!\n");
+			nouveau_bo_ref(NULL, &pNv->xv_filtertable_mem);
+			return -1;
+		}
+
+		for (i = 0; i < NV_FILTER_TABLES; i++) {
+			nouveau_xv_filter_compute((int8_t *)
+				pNv->xv_filtertable_mem->map +
+				i * NV_FILTER_TABLE_BYTES, i);
+		}
+		nv_bo_unmap(pNv, pNv->xv_filtertable_mem);
+	}
+
+	return pPriv->sharpness * NV_FILTER_TABLE_BYTES;
+}
+
 /**
  * NV30 texture adapter.
  */
@@ -1881,8 +2554,10 @@ NV30SetupTexturedVideo (ScreenPtr pScreen, Bool bicubic)
 	for(i = 0; i < NUM_TEXTURE_PORTS; i++)
 		adapt->pPortPrivates[i].ptr = (pointer)(pPriv);
 
-	adapt->pAttributes		= NVTexturedAttributes;
-	adapt->nAttributes		= NUM_TEXTURED_ATTRIBUTES;
+	adapt->pAttributes		= bicubic ? NVBicubicAttributes :
+						    NVTexturedAttributes;
+	adapt->nAttributes		= bicubic ? NUM_BICUBIC_ATTRIBUTES :
+						    NUM_TEXTURED_ATTRIBUTES;
 	adapt->pImages			= NV30TexturedImages;
 	adapt->nImages			= NUM_FORMAT_TEXTURED;
 	adapt->PutVideo			= NULL;
@@ -1903,6 +2578,8 @@ NV30SetupTexturedVideo (ScreenPtr pScreen, Bool bicubic)
 	pPriv->bicubic			= bicubic;
 	pPriv->doubleBuffer		= FALSE;
 	pPriv->SyncToVBlank		= TRUE;
+	pPriv->deinterlace		= NV_DEINTERLACE_WEAVE;
+	pPriv->sharpness		= NV_FILTER_SHARPNESS_DEFAULT;
 
 	if (bicubic)
 		pNv->textureAdaptor[1]	= adapt;
@@ -1962,8 +2639,10 @@ NV40SetupTexturedVideo (ScreenPtr pScreen, Bool bicubic)
 	for(i = 0; i < NUM_TEXTURE_PORTS; i++)
 		adapt->pPortPrivates[i].ptr = (pointer)(pPriv);
 
-	adapt->pAttributes		= NVTexturedAttributes;
-	adapt->nAttributes		= NUM_TEXTURED_ATTRIBUTES;
+	adapt->pAttributes		= bicubic ? NVBicubicAttributesNV40 :
+						    NVTexturedAttributesNV40;
+	adapt->nAttributes		= bicubic ? NUM_BICUBIC_ATTRIBUTES :
+						    NUM_TEXTURED_ATTRIBUTES;
 	adapt->pImages			= NV40TexturedImages;
 	adapt->nImages			= NUM_FORMAT_TEXTURED;
 	adapt->PutVideo			= NULL;
@@ -1984,6 +2663,9 @@ NV40SetupTexturedVideo (ScreenPtr pScreen, Bool bicubic)
 	pPriv->bicubic			= bicubic;
 	pPriv->doubleBuffer		= FALSE;
 	pPriv->SyncToVBlank		= TRUE;
+	pPriv->deinterlace		= NV_DEINTERLACE_WEAVE;
+	pPriv->deint_prev		= -1;
+	pPriv->sharpness		= NV_FILTER_SHARPNESS_DEFAULT;
 
 	if (bicubic)
 		pNv->textureAdaptor[1]	= adapt;
@@ -1998,6 +2680,7 @@ NV50TexturedImages[] =
 {
 	XVIMAGE_YV12,
 	XVIMAGE_I420,
+	XVIMAGE_NV12,
 	XVIMAGE_YUY2,
 	XVIMAGE_UYVY
 };
@@ -2050,7 +2733,6 @@ NV50SetupTexturedVideo (ScreenPtr pScreen)
 	pNv->textureAdaptor[0]		= adapt;
 
 	nv50_xv_set_port_defaults(pScrn, pPriv);
-	nv50_xv_csc_update(pScrn, pPriv);
 
 	xvBrightness = MAKE_ATOM("XV_BRIGHTNESS");
 	xvContrast   = MAKE_ATOM("XV_CONTRAST");
@@ -2088,6 +2770,12 @@ NVInitVideo(ScreenPtr pScreen)
 	 */
 	if (pScrn->bitsPerPixel != 8 && !pNv->NoAccel) {
 		xvSyncToVBlank = MAKE_ATOM("XV_SYNC_TO_VBLANK");
+		xvDeinterlace = MAKE_ATOM("XV_DEINTERLACE");
+		xvFilterSharpness = MAKE_ATOM("XV_FILTER_SHARPNESS");
+		nouveau_xv_pool_init(pScrn);
+#ifdef HAVE_PTHREAD
+		nouveau_xv_workers_init(pScrn);
+#endif
 
 		if (pNv->Architecture < NV_ARCH_50) {
 			overlayAdaptor = NVSetupOverlayVideo(pScreen);
@@ -2155,19 +2843,22 @@ NVInitVideo(ScreenPtr pScreen)
 	/*
 	 * For now we associate with the plain texture adapter since it is logical, but we can
 	 * associate with any/all adapters since VL doesn't depend on Xv for color conversion.
+	 * Motion compensation is left to the client library on the NV40+ 3D engines.
 	 */
-	if (textureAdaptor[0]) {
+	if (textureAdaptor[0] && pNv->Architecture >= NV_ARCH_40) {
 		XF86MCAdaptorPtr *adaptorsXvMC = malloc(sizeof(XF86MCAdaptorPtr));
 		
 		if (adaptorsXvMC) {
 			adaptorsXvMC[0] = vlCreateAdaptorXvMC(pScreen, textureAdaptor[0]->name);
 			
-			if (adaptorsXvMC[0]) {
-				vlInitXvMC(pScreen, 1, adaptorsXvMC);
-				vlDestroyAdaptorXvMC(adaptorsXvMC[0]);
+			if (adaptorsXvMC[0] &&
+			    vlInitXvMC(pScreen, 1, adaptorsXvMC)) {
+				pNv->xvmc_adaptors = adaptorsXvMC;
+			} else {
+				if (adaptorsXvMC[0])
+					vlDestroyAdaptorXvMC(adaptorsXvMC[0]);
+				free(adaptorsXvMC);
 			}
-			
-			free(adaptorsXvMC);
 		}
 	}
 }
@@ -2188,5 +2879,17 @@ NVTakedownVideo(ScrnInfoPtr pScrn)
 		NVFreePortMemory(pScrn,
 				 pNv->textureAdaptor[1]->pPortPrivates[0].ptr);
 	}
+	nouveau_xv_pool_fini(pScrn);
+#ifdef HAVE_PTHREAD
+	nouveau_xv_workers_fini(pScrn);
+#endif
+
+	if (pNv->xvmc_adaptors) {
+		XF86MCAdaptorPtr *adaptorsXvMC = pNv->xvmc_adaptors;
+
+		vlDestroyAdaptorXvMC(adaptorsXvMC[0]);
+		free(adaptorsXvMC);
+		pNv->xvmc_adaptors = NULL;
+	}
 }
 
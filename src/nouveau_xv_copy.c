@@ -0,0 +1,369 @@
+/*
+ * Copyright 2007 Arthur Huillet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xarch.h>
+#ifdef HAVE_PTHREAD
+#include <signal.h>
+#endif
+
+#include "nouveau_xv_copy.h"
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+/**
+ * NVCopyData420
+ * used to convert YV12 to YUY2 for the blitter and NV04 overlay.
+ * The U and V samples generated are linearly interpolated on the vertical
+ * axis for better quality
+ *
+ * @param src1 source buffer of luma
+ * @param src2 source buffer of chroma1
+ * @param src3 source buffer of chroma2
+ * @param dst1 destination buffer
+ * @param srcPitch pitch of src1
+ * @param srcPitch2 pitch of src2, src3
+ * @param dstPitch pitch of dst1
+ * @param h number of lines to copy
+ * @param w length of lines to copy
+ * @param bottom whether the h lines reach the bottom of the image, there's
+ *               no chroma below them to interpolate with if so
+ */
+static inline void
+NVCopyData420(unsigned char *src1, unsigned char *src2, unsigned char *src3,
+	      unsigned char *dst1, int srcPitch, int srcPitch2, int dstPitch,
+	      int h, int w, Bool bottom)
+{
+	CARD32 *dst;
+	CARD8 *s1, *s2, *s3;
+	int i, j;
+
+#define su(X) (((j & 1) && (j < (h-1) || !bottom)) ?                            \
+		((unsigned)((signed int)s2[X] +                                \
+		(signed int)(s2 + srcPitch2)[X]) / 2) : (s2[X]))
+#define sv(X) (((j & 1) && (j < (h-1) || !bottom)) ?                            \
+		((unsigned)((signed int)s3[X] +                                \
+		(signed int)(s3 + srcPitch2)[X]) / 2) : (s3[X]))
+
+	w >>= 1;
+
+	for (j = 0; j < h; j++) {
+		dst = (CARD32*)dst1;
+		s1 = src1;  s2 = src2;  s3 = src3;
+		i = w;
+
+		while (i > 4) {
+#if X_BYTE_ORDER == X_BIG_ENDIAN
+		dst[0] = (s1[0] << 24) | (s1[1] << 8) | (sv(0) << 16) | su(0);
+		dst[1] = (s1[2] << 24) | (s1[3] << 8) | (sv(1) << 16) | su(1);
+		dst[2] = (s1[4] << 24) | (s1[5] << 8) | (sv(2) << 16) | su(2);
+		dst[3] = (s1[6] << 24) | (s1[7] << 8) | (sv(3) << 16) | su(3);
+#else
+		dst[0] = s1[0] | (s1[1] << 16) | (sv(0) << 8) | (su(0) << 24);
+		dst[1] = s1[2] | (s1[3] << 16) | (sv(1) << 8) | (su(1) << 24);
+		dst[2] = s1[4] | (s1[5] << 16) | (sv(2) << 8) | (su(2) << 24);
+		dst[3] = s1[6] | (s1[7] << 16) | (sv(3) << 8) | (su(3) << 24);
+#endif
+		dst += 4; s2 += 4; s3 += 4; s1 += 8;
+		i -= 4;
+		}
+
+		while (i--) {
+#if X_BYTE_ORDER == X_BIG_ENDIAN
+		dst[0] = (s1[0] << 24) | (s1[1] << 8) | (sv(0) << 16) | su(0);
+#else
+		dst[0] = s1[0] | (s1[1] << 16) | (sv(0) << 8) | (su(0) << 24);
+#endif
+		dst++; s2++; s3++;
+		s1 += 2;
+		}
+
+		dst1 += dstPitch;
+		src1 += srcPitch;
+		if (j & 1) {
+			src2 += srcPitch2;
+			src3 += srcPitch2;
+		}
+	}
+}
+
+/**
+ * NVCopyNV12ColorPlanes
+ * Used to convert YV12 color planes to NV12 (interleaved UV) for the overlay
+ *
+ * @param src1 source buffer of chroma1
+ * @param dst1 destination buffer
+ * @param h number of lines to copy
+ * @param w length of lines to copy
+ * @param id source pixel format (YV12 or I420)
+ */
+static inline void
+NVCopyNV12ColorPlanes(unsigned char *src1, unsigned char *src2,
+		      unsigned char *dst, int dstPitch, int srcPitch2,
+		      int h, int w)
+{
+	int i, j, l, e;
+
+	w >>= 1;
+	h >>= 1;
+	l = w >> 1;
+	e = w & 1;
+
+	for (j = 0; j < h; j++) {
+		unsigned char *us = src1;
+		unsigned char *vs = src2;
+		unsigned int *vuvud = (unsigned int *) dst;
+
+		for (i = 0; i < l; i++) {
+#if X_BYTE_ORDER == X_BIG_ENDIAN
+			*vuvud++ = (vs[0]<<24) | (us[0]<<16) | (vs[1]<<8) | us[1];
+#else
+			*vuvud++ = vs[0] | (us[0]<<8) | (vs[1]<<16) | (us[1]<<24);
+#endif
+			us+=2;
+			vs+=2;
+		}
+
+		if (e) {
+			unsigned short *vud = (unsigned short *) vuvud;
+
+			*vud = vs[0] | (us[0]<<8);
+		}
+
+		dst += dstPitch;
+		src1 += srcPitch2;
+		src2 += srcPitch2;
+	}
+
+}
+
+
+/**
+ * NVCopyStripe
+ * converts/copies lines y0 to y1 of an image, which must both be even for
+ * the 4:2:0 formats.  Stripes don't overlap, so they can be done in
+ * parallel.
+ */
+void
+NVCopyStripe(struct nv_xv_copy *c, int y0, int y1)
+{
+	unsigned char *src = c->src + y0 * c->src_pitch;
+	unsigned char *dst = c->dst + y0 * c->dst_pitch;
+	int i;
+
+	if (c->action_flags & IS_YV12) {
+		unsigned char *src2 = c->src2 + (y0 >> 1) * c->src_pitch2;
+		unsigned char *src3 = c->src3 + (y0 >> 1) * c->src_pitch2;
+		unsigned char *dst_uv = c->dst_uv + (y0 >> 1) * c->dst_pitch;
+
+		if (c->action_flags & PLANAR_UPLOAD) {
+			/* Y, then the src3 and src2 chroma planes, all
+			 * packed, see NVUploadPlanes
+			 */
+			int cw = c->line_len >> 1;
+			unsigned char *dst_a = c->dst_uv + (y0 >> 1) * cw;
+			unsigned char *dst_b = dst_a + cw * (c->nlines >> 1);
+
+			for (i = y0; i < y1; i++) {
+				memcpy(dst, src, c->line_len);
+				dst += c->dst_pitch;
+				src += c->src_pitch;
+			}
+
+			for (i = y0; i < y1; i += 2) {
+				memcpy(dst_a, src3, cw);
+				memcpy(dst_b, src2, cw);
+				dst_a += cw;
+				dst_b += cw;
+				src2 += c->src_pitch2;
+				src3 += c->src_pitch2;
+			}
+			return;
+		}
+
+		if (c->action_flags & CONVERT_TO_YUY2) {
+			NVCopyData420(src, src2, src3, dst, c->src_pitch,
+				      c->src_pitch2, c->dst_pitch, y1 - y0,
+				      c->npixels, y1 == c->nlines);
+			return;
+		}
+
+		/* luma */
+		for (i = y0; i < y1; i++) {
+			memcpy(dst, src, c->line_len);
+			dst += c->dst_pitch;
+			src += c->src_pitch;
+		}
+
+		if (c->action_flags & IS_NV12) {
+			/* chroma, already interleaved */
+			for (i = y0; i < y1; i += 2) {
+				memcpy(dst_uv, src2, c->line_len);
+				dst_uv += c->dst_pitch;
+				src2 += c->src_pitch2;
+			}
+		} else {
+			NVCopyNV12ColorPlanes(src2, src3, dst_uv, c->dst_pitch,
+					      c->src_pitch2, y1 - y0,
+					      c->line_len);
+		}
+		return;
+	}
+
+	/* YUY2 and RGB */
+	for (i = y0; i < y1; i++) {
+		memcpy(dst, src, c->line_len);
+		dst += c->dst_pitch;
+		src += c->src_pitch;
+	}
+}
+
+#ifdef HAVE_PTHREAD
+static void *
+nouveau_xv_worker(void *arg)
+{
+	struct nouveau_xv_workers *w = arg;
+	unsigned frame = 0;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		struct nv_xv_copy *job;
+		int y0, y1;
+
+		while (!w->quit && w->frame == frame)
+			pthread_cond_wait(&w->work, &w->lock);
+		if (w->quit)
+			break;
+		frame = w->frame;
+
+		job = w->job;
+		y0 = w->next++ * w->stripe_lines;
+		y1 = min(y0 + w->stripe_lines, job->nlines);
+		pthread_mutex_unlock(&w->lock);
+
+		if (y0 < y1)
+			NVCopyStripe(job, y0, y1);
+
+		pthread_mutex_lock(&w->lock);
+		if (--w->pending == 0)
+			pthread_cond_signal(&w->done);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+/* Starts up to nthreads workers, w->nthreads says how many made it */
+struct nouveau_xv_workers *
+nouveau_xv_workers_start(int nthreads)
+{
+	struct nouveau_xv_workers *w;
+	sigset_t sigs, old;
+	int i;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return NULL;
+
+	w->thread = calloc(nthreads, sizeof(*w->thread));
+	if (!w->thread) {
+		free(w);
+		return NULL;
+	}
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->work, NULL);
+	pthread_cond_init(&w->done, NULL);
+
+	/* signals are for the server thread, not the workers */
+	sigfillset(&sigs);
+	pthread_sigmask(SIG_BLOCK, &sigs, &old);
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&w->thread[i], NULL, nouveau_xv_worker, w))
+			break;
+		w->nthreads++;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	return w;
+}
+
+/* Copies a frame in nthreads + 1 stripes, the last of them on the
+ * calling thread, and returns once they're all done.
+ */
+void
+nouveau_xv_workers_copy(struct nouveau_xv_workers *w, struct nv_xv_copy *c)
+{
+	int stripes = w->nthreads + 1;
+
+	/* even, so 4:2:0 chroma rows aren't split */
+	w->stripe_lines = ((c->nlines + stripes - 1) / stripes + 1) & ~1;
+
+	pthread_mutex_lock(&w->lock);
+	w->job = c;
+	w->next = 1;
+	w->pending = w->nthreads;
+	w->frame++;
+	pthread_cond_broadcast(&w->work);
+	pthread_mutex_unlock(&w->lock);
+
+	NVCopyStripe(c, 0, min(w->stripe_lines, c->nlines));
+
+	pthread_mutex_lock(&w->lock);
+	while (w->pending)
+		pthread_cond_wait(&w->done, &w->lock);
+	pthread_mutex_unlock(&w->lock);
+
+	w->frames++;
+}
+
+void
+nouveau_xv_workers_stop(struct nouveau_xv_workers *w)
+{
+	int i;
+
+	pthread_mutex_lock(&w->lock);
+	w->quit = TRUE;
+	pthread_cond_broadcast(&w->work);
+	pthread_mutex_unlock(&w->lock);
+
+	for (i = 0; i < w->nthreads; i++)
+		pthread_join(w->thread[i], NULL);
+
+	pthread_cond_destroy(&w->done);
+	pthread_cond_destroy(&w->work);
+	pthread_mutex_destroy(&w->lock);
+	free(w->thread);
+	free(w);
+}
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2007 Arthur Huillet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __NOUVEAU_XV_COPY_H__
+#define __NOUVEAU_XV_COPY_H__
+
+/* Image conversion and copying for NVPutImage, with its worker threads.
+ * Nothing here needs the server's headers, so xvcopy_bench builds it on
+ * its own.
+ */
+
+#include <X11/Xmd.h>
+#include <X11/Xdefs.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* NVPutImage action flags */
+enum {
+	IS_YV12 = 1,
+	IS_YUY2 = 2,
+	CONVERT_TO_YUY2=4,
+	USE_OVERLAY=8,
+	USE_TEXTURE=16,
+	SWAP_UV=32,
+	IS_RGB=64, //I am not sure how long we will support it
+	IS_NV12=128, /* with IS_YV12, chroma already interleaved */
+	PLANAR_UPLOAD=256, /* with IS_YV12, the M2MF interleaves the planes */
+};
+
+/* The CPU side of an upload: converting or copying the image into the
+ * staging buffer, or straight into video memory.
+ */
+struct nv_xv_copy {
+	int action_flags;
+	unsigned char *src;	/* luma, or packed pixels */
+	unsigned char *src2;	/* chroma, planar formats only */
+	unsigned char *src3;
+	int src_pitch;
+	int src_pitch2;
+	unsigned char *dst;
+	unsigned char *dst_uv;	/* interleaved chroma, planar formats only */
+	int dst_pitch;
+	int line_len;
+	int npixels;
+	int nlines;
+};
+
+void NVCopyStripe(struct nv_xv_copy *c, int y0, int y1);
+
+#ifdef HAVE_PTHREAD
+/* Worker threads for the copy
+ *
+ * Big frames are split into horizontal stripes, one per worker plus one
+ * done by the calling thread itself, which then waits for the rest.  The
+ * workers sleep on a condition variable between frames.
+ */
+struct nouveau_xv_workers {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	pthread_t *thread;
+	int nthreads;
+	struct nv_xv_copy *job;
+	int stripe_lines;
+	int next;	/* stripe for the next worker to pick up */
+	int pending;	/* workers still busy with this frame */
+	unsigned frame;
+	Bool quit;
+	unsigned long frames;
+};
+
+struct nouveau_xv_workers *nouveau_xv_workers_start(int nthreads);
+void nouveau_xv_workers_copy(struct nouveau_xv_workers *w,
+			     struct nv_xv_copy *c);
+void nouveau_xv_workers_stop(struct nouveau_xv_workers *w);
+#endif
+
+#endif
@@ -254,5 +254,8 @@ NVGetBlitPortAttribute(ScrnInfoPtr pScrn, Atom attribute,
 void
 NVStopBlitVideo(ScrnInfoPtr pScrn, pointer data, Bool Exit)
 {
+	nouveau_xv_present_cancel(data);
+	if (Exit)
+		NVFreePortMemory(pScrn, data);
 }
 
@@ -365,6 +365,11 @@ NV10EXACheckComposite(int op, PicturePtr src, PicturePtr mask, PicturePtr dst)
 		}
 	}
 
+	if (!NVAccelInit3D(xf86Screens[dst->pDrawable->pScreen->myNum])) {
+		print_fallback_info("3D engine", op, src, mask, dst);
+		return FALSE;
+	}
+
 	print_fallback_info("Accelerating", op, src, mask, dst);
 	return TRUE;
 }
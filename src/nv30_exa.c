@@ -47,11 +47,19 @@ typedef struct nv_pict_op {
 
 typedef struct nv30_exa_state {
 	Bool have_mask;
+	Bool projective;
+	Bool tiled;
 
 	struct {
 		PictTransformPtr transform;
 		float width;
 		float height;
+		/* RepeatNormal/RepeatReflect emulation, 0 if not repeating
+		 * along that axis.
+		 */
+		int tile_w;
+		int tile_h;
+		Bool reflect;
 	} unit[2];
 } nv30_exa_state_t;
 static nv30_exa_state_t exa_state;
@@ -100,6 +108,14 @@ static nv_shader_t *nv40_fp_map[NV30EXA_FPID_MAX] = {
 };
 
 static nv_shader_t *nv40_fp_map_a8[NV30EXA_FPID_MAX];
+static nv_shader_t nv40_fp_proj[NV30EXA_FPID_MAX];
+static nv_shader_t nv40_fp_proj_a8[NV30EXA_FPID_MAX];
+
+/* Rectangle textures can't repeat on NV3x, RepeatNormal and RepeatReflect
+ * are emulated by splitting the composite into one quad per source tile.
+ * Small tiles would produce too many quads to be worth it.
+ */
+#define NV30EXA_REPEAT_MIN_TILE 32
 
 static void
 NV30EXAHackupA8Shaders(ScrnInfoPtr pScrn)
@@ -124,6 +140,18 @@ NV30EXAHackupA8Shaders(ScrnInfoPtr pScrn)
 	}
 }
 
+static void
+NV30EXAHackupProjShaders(ScrnInfoPtr pScrn)
+{
+	int s;
+
+	for (s = 0; s < NV30EXA_FPID_MAX; s++) {
+		NV30_ProjectiveFragProg(&nv40_fp_proj[s], nv40_fp_map[s]);
+		NV30_ProjectiveFragProg(&nv40_fp_proj_a8[s],
+					nv40_fp_map_a8[s]);
+	}
+}
+
 /* should be in nouveau_reg.h at some point.. */
 #define NV34TCL_TX_SWIZZLE_UNIT_S0_X_ZERO	 0
 #define NV34TCL_TX_SWIZZLE_UNIT_S0_X_ONE	 1
@@ -315,7 +343,11 @@ NV30EXATexture(ScrnInfoPtr pScrn, PixmapPtr pPix, PicturePtr pPict, int unit)
 	if (!fmt)
 		return FALSE;
 
-	card_repeat = 3; /* repeatNone */
+	/* RepeatNone relies on clipping, RepeatPad is exactly clamp-to-edge,
+	 * and repeating along an axis of a single texel is the same as
+	 * clamping.  Anything else is done by NV30EXACompositeTiled().
+	 */
+	card_repeat = 3; /* clamp to edge */
 
 	if (pPict->filter == PictFilterBilinear)
 		card_filter = 2;
@@ -349,6 +381,19 @@ NV30EXATexture(ScrnInfoPtr pScrn, PixmapPtr pPix, PicturePtr pPict, int unit)
 	state->unit[unit].width		= (float)pPix->drawable.width;
 	state->unit[unit].height	= (float)pPix->drawable.height;
 	state->unit[unit].transform	= pPict->transform;
+	state->unit[unit].tile_w	= 0;
+	state->unit[unit].tile_h	= 0;
+	state->unit[unit].reflect	= FALSE;
+
+	if (pPict->repeat && (pPict->repeatType == RepeatNormal ||
+			      pPict->repeatType == RepeatReflect)) {
+		if (pPix->drawable.width > 1)
+			state->unit[unit].tile_w = pPix->drawable.width;
+		if (pPix->drawable.height > 1)
+			state->unit[unit].tile_h = pPix->drawable.height;
+		state->unit[unit].reflect =
+			(pPict->repeatType == RepeatReflect);
+	}
 
 	return TRUE;
 }
@@ -379,6 +424,13 @@ NV30_SetupSurface(ScrnInfoPtr pScrn, PixmapPtr pPix, PicturePtr pPict)
 	return TRUE;
 }
 
+static Bool
+NV30EXATransformIsProjective(PictTransformPtr t)
+{
+	return t && (t->matrix[2][0] || t->matrix[2][1] ||
+		     t->matrix[2][2] != xFixed1);
+}
+
 static Bool
 NV30EXACheckCompositeTexture(PicturePtr pPict, PicturePtr pdPict, int op)
 {
@@ -403,9 +455,19 @@ NV30EXACheckCompositeTexture(PicturePtr pPict, PicturePtr pdPict, int op)
 			pPict->filter != PictFilterBilinear)
 		NOUVEAU_FALLBACK("filter 0x%x not supported\n", pPict->filter);
 
-	if (!(w==1 && h==1) && pPict->repeat && pPict->repeatType != RepeatNone)
-		NOUVEAU_FALLBACK("repeat 0x%x not supported (surface %dx%d)\n",
-				 pPict->repeatType,w,h);
+	if (pPict->repeat && (pPict->repeatType == RepeatNormal ||
+			      pPict->repeatType == RepeatReflect) &&
+	    !(w == 1 && h == 1)) {
+		if (pPict->transform)
+			NOUVEAU_FALLBACK("transformed repeat 0x%x not supported "
+					 "(surface %dx%d)\n",
+					 pPict->repeatType, w, h);
+		if ((w > 1 && w < NV30EXA_REPEAT_MIN_TILE) ||
+		    (h > 1 && h < NV30EXA_REPEAT_MIN_TILE))
+			NOUVEAU_FALLBACK("repeat 0x%x tile too small "
+					 "(surface %dx%d)\n",
+					 pPict->repeatType, w, h);
+	}
 
 	/* Opengl and Render disagree on what should be sampled outside an XRGB 
 	 * texture (with no repeating). Opengl has a hardcoded alpha value of 
@@ -420,6 +482,17 @@ NV30EXACheckCompositeTexture(PicturePtr pPict, PicturePtr pdPict, int op)
 	return TRUE;
 }
 
+/* Whether NV30EXACompositeTiled() would have to split up this picture. */
+static Bool
+NV30EXAPictIsTiled(PicturePtr pPict)
+{
+	if (!pPict->repeat || (pPict->repeatType != RepeatNormal &&
+			       pPict->repeatType != RepeatReflect))
+		return FALSE;
+
+	return pPict->pDrawable->width > 1 || pPict->pDrawable->height > 1;
+}
+
 Bool
 NV30EXACheckComposite(int op, PicturePtr psPict,
 		PicturePtr pmPict,
@@ -448,6 +521,17 @@ NV30EXACheckComposite(int op, PicturePtr psPict,
 			NOUVEAU_FALLBACK("mask picture\n");
 	}
 
+	/* The tiled path splits the quad in source space, so neither
+	 * picture may be transformed once either of them repeats.
+	 */
+	if ((NV30EXAPictIsTiled(psPict) ||
+	     (pmPict && NV30EXAPictIsTiled(pmPict))) &&
+	    (psPict->transform || (pmPict && pmPict->transform)))
+		NOUVEAU_FALLBACK("tiled repeat with transformed picture\n");
+
+	if (!NVAccelInit3D(xf86Screens[pdPict->pDrawable->pScreen->myNum]))
+		NOUVEAU_FALLBACK("3D engine unavailable\n");
+
 	return TRUE;
 }
 
@@ -474,6 +558,7 @@ NV30EXAPrepareComposite(int op, PicturePtr psPict,
 	struct nouveau_channel *chan = pNv->chan;
 	struct nouveau_grobj *rankine = pNv->Nv3D;
 	nv_pict_op_t *blend;
+	nv_shader_t *shader;
 	int fpid = NV30EXA_FPID_PASS_COL0;
 	NV30EXA_STATE;
 
@@ -528,8 +613,27 @@ NV30EXAPrepareComposite(int op, PicturePtr psPict,
 		state->have_mask = FALSE;
 	}
 
-	if (!NV30_LoadFragProg(pScrn, (pdPict->format == PICT_a8) ?
-			       nv40_fp_map_a8[fpid] : nv40_fp_map[fpid])) {
+	state->projective =
+		NV30EXATransformIsProjective(psPict->transform) ||
+		(pmPict && NV30EXATransformIsProjective(pmPict->transform));
+	state->tiled =
+		state->unit[0].tile_w || state->unit[0].tile_h ||
+		(pmPict && (state->unit[1].tile_w || state->unit[1].tile_h));
+	if (state->tiled &&
+	    (psPict->transform || (pmPict && pmPict->transform))) {
+		MARK_UNDO(chan);
+		NOUVEAU_FALLBACK("tiled repeat with transformed picture\n");
+	}
+
+	if (state->projective) {
+		shader = (pdPict->format == PICT_a8) ?
+			 &nv40_fp_proj_a8[fpid] : &nv40_fp_proj[fpid];
+	} else {
+		shader = (pdPict->format == PICT_a8) ?
+			 nv40_fp_map_a8[fpid] : nv40_fp_map[fpid];
+	}
+
+	if (!NV30_LoadFragProg(pScrn, shader)) {
 		MARK_UNDO(chan);
 		return FALSE;
 	}
@@ -551,9 +655,13 @@ NV30EXAPrepareComposite(int op, PicturePtr psPict,
 #define xFixedToFloat(v) \
 	((float)xFixedToInt((v)) + ((float)xFixedFrac(v) / 65536.0))
 
+/* For projective transforms the homogeneous coordinate is returned in w_ret
+ * rather than divided out here, the TXP fragment programs take care of that
+ * per-fragment.
+ */
 static void
 NV30EXATransformCoord(PictTransformPtr t, int x, int y, float sx, float sy,
-					  float *x_ret, float *y_ret)
+		      float *x_ret, float *y_ret, float *w_ret)
 {
 	PictVector v;
 
@@ -561,12 +669,14 @@ NV30EXATransformCoord(PictTransformPtr t, int x, int y, float sx, float sy,
 		v.vector[0] = IntToxFixed(x);
 		v.vector[1] = IntToxFixed(y);
 		v.vector[2] = xFixed1;
-		PictureTransformPoint(t, &v);
+		PictureTransformPoint3d(t, &v);
 		*x_ret = xFixedToFloat(v.vector[0]);
 		*y_ret = xFixedToFloat(v.vector[1]);
+		*w_ret = xFixedToFloat(v.vector[2]);
 	} else {
 		*x_ret = (float)x;
 		*y_ret = (float)y;
+		*w_ret = 1.0;
 	}
 }
 
@@ -583,6 +693,122 @@ NV30EXATransformCoord(PictTransformPtr t, int x, int y, float sx, float sy,
 	BEGIN_RING(chan, rankine, NV34TCL_VTX_ATTR_2I(0), 1);                     \
 	OUT_RING  (chan, ((dy)<<16)|(dx));                                     \
 } while(0)
+#define CV_OUTp(sx,sy,sw,mx,my,mw,dx,dy) do {                                  \
+	BEGIN_RING(chan, rankine, NV34TCL_VTX_ATTR_4F_X(8), 8);                   \
+	OUT_RINGf (chan, (sx)); OUT_RINGf (chan, (sy));                        \
+	OUT_RINGf (chan, 0.0);  OUT_RINGf (chan, (sw));                        \
+	OUT_RINGf (chan, (mx)); OUT_RINGf (chan, (my));                        \
+	OUT_RINGf (chan, 0.0);  OUT_RINGf (chan, (mw));                        \
+	BEGIN_RING(chan, rankine, NV34TCL_VTX_ATTR_2I(0), 1);                     \
+	OUT_RING  (chan, ((dy)<<16)|(dx));                                     \
+} while(0)
+
+/* Map a span [pos, pos + len) of an untransformed repeating picture into
+ * texture space.  The span never crosses a tile boundary.
+ */
+static void
+NV30EXATileCoord(int tile, Bool reflect, int pos, int len,
+		 float *c0, float *c1)
+{
+	int k, r;
+
+	if (!tile) {
+		*c0 = (float)pos;
+		*c1 = (float)(pos + len);
+		return;
+	}
+
+	k = pos / tile;
+	r = pos % tile;
+	if (r < 0) {
+		r += tile;
+		k--;
+	}
+
+	if (reflect && (k & 1)) {
+		*c0 = (float)(tile - r);
+		*c1 = (float)(tile - r - len);
+	} else {
+		*c0 = (float)r;
+		*c1 = (float)(r + len);
+	}
+}
+
+/* Length of the next span starting at pos that doesn't cross a tile
+ * boundary of the given picture.
+ */
+static int
+NV30EXATileSpan(int tile, int pos, int len)
+{
+	int r;
+
+	if (!tile)
+		return len;
+
+	r = pos % tile;
+	if (r < 0)
+		r += tile;
+	return (len < tile - r) ? len : tile - r;
+}
+
+static void
+NV30EXACompositeTiled(ScrnInfoPtr pScrn, int srcX, int srcY,
+		      int maskX, int maskY, int dstX, int dstY,
+		      int width, int height)
+{
+	NVPtr pNv = NVPTR(pScrn);
+	struct nouveau_channel *chan = pNv->chan;
+	struct nouveau_grobj *rankine = pNv->Nv3D;
+	float sX0, sX1, sY0, sY1, mX0, mX1, mY0, mY1;
+	int x, y, w, h;
+	NV30EXA_STATE;
+
+	for (y = 0; y < height; y += h) {
+		h = NV30EXATileSpan(state->unit[0].tile_h, srcY + y, height - y);
+		if (state->have_mask)
+			h = NV30EXATileSpan(state->unit[1].tile_h,
+					    maskY + y, h);
+
+		for (x = 0; x < width; x += w) {
+			w = NV30EXATileSpan(state->unit[0].tile_w,
+					    srcX + x, width - x);
+			if (state->have_mask)
+				w = NV30EXATileSpan(state->unit[1].tile_w,
+						    maskX + x, w);
+
+			NV30EXATileCoord(state->unit[0].tile_w,
+					 state->unit[0].reflect,
+					 srcX + x, w, &sX0, &sX1);
+			NV30EXATileCoord(state->unit[0].tile_h,
+					 state->unit[0].reflect,
+					 srcY + y, h, &sY0, &sY1);
+
+			WAIT_RING(chan, 32);
+			BEGIN_RING(chan, rankine, NV34TCL_VERTEX_BEGIN_END, 1);
+			OUT_RING  (chan, NV34TCL_VERTEX_BEGIN_END_QUADS);
+			if (state->have_mask) {
+				NV30EXATileCoord(state->unit[1].tile_w,
+						 state->unit[1].reflect,
+						 maskX + x, w, &mX0, &mX1);
+				NV30EXATileCoord(state->unit[1].tile_h,
+						 state->unit[1].reflect,
+						 maskY + y, h, &mY0, &mY1);
+
+				CV_OUTm(sX0, sY0, mX0, mY0, dstX + x, dstY + y);
+				CV_OUTm(sX1, sY0, mX1, mY0, dstX + x + w, dstY + y);
+				CV_OUTm(sX1, sY1, mX1, mY1, dstX + x + w, dstY + y + h);
+				CV_OUTm(sX0, sY1, mX0, mY1, dstX + x, dstY + y + h);
+			} else {
+				CV_OUT(sX0, sY0, dstX + x, dstY + y);
+				CV_OUT(sX1, sY0, dstX + x + w, dstY + y);
+				CV_OUT(sX1, sY1, dstX + x + w, dstY + y + h);
+				CV_OUT(sX0, sY1, dstX + x, dstY + y + h);
+			}
+			BEGIN_RING(chan, rankine, NV34TCL_VERTEX_BEGIN_END, 1);
+			OUT_RING  (chan, 0);
+		}
+	}
+}
 
 void
 NV30EXAComposite(PixmapPtr pdPix, int srcX , int srcY,
@@ -594,8 +820,8 @@ NV30EXAComposite(PixmapPtr pdPix, int srcX , int srcY,
 	NVPtr pNv = NVPTR(pScrn);
 	struct nouveau_channel *chan = pNv->chan;
 	struct nouveau_grobj *rankine = pNv->Nv3D;
-	float sX0, sX1, sX2, sY0, sY1, sY2;
-	float mX0, mX1, mX2, mY0, mY1, mY2;
+	float sX0, sX1, sX2, sY0, sY1, sY2, sW0, sW1, sW2;
+	float mX0, mX1, mX2, mY0, mY1, mY2, mW0, mW1, mW2;
 	NV30EXA_STATE;
 
 	WAIT_RING(chan, 64);
@@ -606,6 +832,13 @@ NV30EXAComposite(PixmapPtr pdPix, int srcX , int srcY,
 	BEGIN_RING(chan, rankine, NV34TCL_SCISSOR_HORIZ, 2);
 	OUT_RING  (chan, (width << 16) | dstX);
 	OUT_RING  (chan, (height << 16) | dstY);
+
+	if (state->tiled) {
+		NV30EXACompositeTiled(pScrn, srcX, srcY, maskX, maskY,
+				      dstX, dstY, width, height);
+		return;
+	}
+
 	BEGIN_RING(chan, rankine, NV34TCL_VERTEX_BEGIN_END, 1);
 	OUT_RING  (chan, NV34TCL_VERTEX_BEGIN_END_TRIANGLES);
 
@@ -615,30 +848,40 @@ NV30EXAComposite(PixmapPtr pdPix, int srcX , int srcY,
 	NV30EXATransformCoord(state->unit[0].transform, 
 				srcX, srcY - height,
 				state->unit[0].width,
-				state->unit[0].height, &sX0, &sY0);
+				state->unit[0].height, &sX0, &sY0, &sW0);
 	NV30EXATransformCoord(state->unit[0].transform,
 				srcX, srcY + height,
 				state->unit[0].width,
-				state->unit[0].height, &sX1, &sY1);
+				state->unit[0].height, &sX1, &sY1, &sW1);
 	NV30EXATransformCoord(state->unit[0].transform,
 				srcX + 2*width, srcY + height,
 				state->unit[0].width,
-				state->unit[0].height, &sX2, &sY2);
+				state->unit[0].height, &sX2, &sY2, &sW2);
 
 	if (state->have_mask) {
 		NV30EXATransformCoord(state->unit[1].transform, 
 					maskX, maskY - height,
 					state->unit[1].width,
-					state->unit[1].height, &mX0, &mY0);
+					state->unit[1].height, &mX0, &mY0, &mW0);
 		NV30EXATransformCoord(state->unit[1].transform,
 					maskX, maskY + height,
 					state->unit[1].width,
-					state->unit[1].height, &mX1, &mY1);
+					state->unit[1].height, &mX1, &mY1, &mW1);
 		NV30EXATransformCoord(state->unit[1].transform,
 					maskX + 2*width, maskY + height,
 					state->unit[1].width,
-					state->unit[1].height, &mX2, &mY2);
+					state->unit[1].height, &mX2, &mY2, &mW2);
+	} else {
+		mX0 = mX1 = mX2 = mY0 = mY1 = mY2 = 0.0;
+		mW0 = mW1 = mW2 = 1.0;
+	}
 
+	if (state->projective) {
+		CV_OUTp(sX0, sY0, sW0, mX0, mY0, mW0, dstX, dstY - height);
+		CV_OUTp(sX1, sY1, sW1, mX1, mY1, mW1, dstX, dstY + height);
+		CV_OUTp(sX2, sY2, sW2, mX2, mY2, mW2,
+			dstX + 2*width, dstY + height);
+	} else if (state->have_mask) {
 		CV_OUTm(sX0 , sY0 , mX0, mY0, dstX			,	dstY - height);
 		CV_OUTm(sX1 , sY1 , mX1, mY1, dstX			,	dstY + height);
 		CV_OUTm(sX2 , sY2 , mX2, mY2, dstX + 2*width	, 	dstY + height);
@@ -673,6 +916,7 @@ NVAccelInitNV30TCL(ScrnInfoPtr pScrn)
 
 	if (!nv40_fp_map_a8[0])
 		NV30EXAHackupA8Shaders(pScrn);
+	NV30EXAHackupProjShaders(pScrn);
 
 #define NV30TCL_CHIPSET_3X_MASK 0x00000003
 #define NV35TCL_CHIPSET_3X_MASK 0x000001e0
@@ -908,6 +1152,9 @@ NVAccelInitNV30TCL(ScrnInfoPtr pScrn)
 	for (i = 0; i < NV30EXA_FPID_MAX; i++) {
 		NV30_UploadFragProg(pNv, nv40_fp_map[i], &next_hw_offset);
 		NV30_UploadFragProg(pNv, nv40_fp_map_a8[i], &next_hw_offset);
+		NV30_UploadFragProg(pNv, &nv40_fp_proj[i], &next_hw_offset);
+		NV30_UploadFragProg(pNv, &nv40_fp_proj_a8[i],
+				    &next_hw_offset);
 	}
 	NV30_UploadFragProg(pNv, &nv30_fp_yv12_bicubic, &next_hw_offset);
 	NV30_UploadFragProg(pNv, &nv30_fp_yv12_bilinear, &next_hw_offset);
@@ -31,7 +31,8 @@ void NV30_UploadFragProg(NVPtr pNv, nv_shader_t *shader, int *hw_offset)
 
 	shader->hw_id = *hw_offset;
 
-	nouveau_bo_map(pNv->shader_mem, NOUVEAU_BO_WR);
+	/* only written before the programs are first used */
+	nv_bo_map(pNv, pNv->shader_mem, NOUVEAU_BO_WR | NOUVEAU_BO_NOSYNC);
 	map = pNv->shader_mem->map + *hw_offset;
 	for (i = 0; i < shader->size; i++) {
 		data = shader->data[i];
@@ -40,12 +41,55 @@ void NV30_UploadFragProg(NVPtr pNv, nv_shader_t *shader, int *hw_offset)
 #endif
 		map[i] = data;
 	}
-	nouveau_bo_unmap(pNv->shader_mem);
+	nv_bo_unmap(pNv, pNv->shader_mem);
 
 	*hw_offset += (shader->size * sizeof(uint32_t));
 	*hw_offset = (*hw_offset + 63) & ~63;
 }
 
+#define NV30_FP_OP_OPCODE_SHIFT 24
+#define NV30_FP_OP_OPCODE_MASK  0x3f000000
+#define NV30_FP_OP_OPCODE_TEX   0x17
+#define NV30_FP_OP_OPCODE_TXP   0x18
+#define NV30_FP_REG_TYPE_MASK   0x00000003
+#define NV30_FP_REG_TYPE_CONST  0x00000002
+
+/* Build a copy of a fragment program with every TEX replaced by TXP, so
+ * texture coordinates are divided by their q component per-fragment.  This
+ * is what makes projective picture transforms come out right, the vertex
+ * texcoords are then interpolated in homogeneous space.
+ */
+void
+NV30_ProjectiveFragProg(nv_shader_t *proj, nv_shader_t *shader)
+{
+	uint32_t i, j, op;
+
+	memset(proj, 0, sizeof(*proj));
+	proj->card_priv = shader->card_priv;
+	proj->size = shader->size;
+	memcpy(proj->data, shader->data, shader->size * sizeof(uint32_t));
+
+	for (i = 0; i < proj->size; i += 4) {
+		uint32_t *insn = &proj->data[i];
+		Bool has_const = FALSE;
+
+		op = (insn[0] & NV30_FP_OP_OPCODE_MASK) >> NV30_FP_OP_OPCODE_SHIFT;
+		if (op == NV30_FP_OP_OPCODE_TEX) {
+			insn[0] &= ~NV30_FP_OP_OPCODE_MASK;
+			insn[0] |= NV30_FP_OP_OPCODE_TXP << NV30_FP_OP_OPCODE_SHIFT;
+		}
+
+		/* inline constants occupy the following 4 words */
+		for (j = 1; j < 4; j++) {
+			if ((insn[j] & NV30_FP_REG_TYPE_MASK) ==
+			    NV30_FP_REG_TYPE_CONST)
+				has_const = TRUE;
+		}
+		if (has_const)
+			i += 4;
+	}
+}
+
 void NV40_UploadVtxProg(NVPtr pNv, nv_shader_t *shader, int *hw_id)
 {
 	struct nouveau_channel *chan = pNv->chan;
@@ -347,4 +391,152 @@ nv_shader_t nv30_fp_yv12_bilinear = {
 	}
 };
 
+/* Motion-adaptive deinterlace of a frame holding both fields.  Rows of the
+ * kept field (even rows for _top, odd for _bottom) are sampled as-is, rows of
+ * the other field are blended between weave and the average of their
+ * neighbours depending on how much the luma at that point changed since the
+ * previous frame (texture[3]).  Chroma is sampled with weave.
+ */
+nv_shader_t nv40_fp_yv12_adaptive_top = {
+	.card_priv.NV30FP.num_regs = 4,
+	.size = (38*4),
+	.data = {
+		/* INST 0: ADDR R0.xy (TR0.xyzw), attrib.texcoord[0], { 0.00, -0.50, 0.00, 0.00 } */
+		0x03008600, 0x1c9dc801, 0x0001c802, 0x3fe1c800,
+		0x00000000, 0xbf000000, 0x00000000, 0x00000000,
+		/* INST 1: FLRR R0.z (TR0.xyzw), R0.yyyy */
+		0x11000800, 0x1c9caa00, 0x0001c800, 0x0001c800,
+		/* INST 2: FRCR R0.w (TR0.xyzw), R0.yyyy */
+		0x10001000, 0x1c9caa00, 0x0001c800, 0x0001c800,
+		/* INST 3: MULR R1.x (TR0.xyzw), R0.zzzz, { 0.50, 0.00, 0.00, 0.00 }.xxxx */
+		0x02000202, 0x1c9d5400, 0x00000002, 0x0001c800,
+		0x3f000000, 0x00000000, 0x00000000, 0x00000000,
+		/* INST 4: FRCR R1.x (TR0.xyzw), R1.xxxx */
+		0x10000202, 0x1c9c0004, 0x0001c800, 0x0001c800,
+		/* INST 5: MADR R1.x (TR0.xyzw), R1.xxxx, { -2.00, 1.00, 0.00, 0.00 }.xxxx, { -2.00, 1.00, 0.00, 0.00 }.yyyy */
+		0x04000202, 0x1c9c0004, 0x00000002, 0x0000aa02,
+		0xc0000000, 0x3f800000, 0x00000000, 0x00000000,
+		/* INST 6: ADDR R0.y (TR0.xyzw), R0.zzzz, R1.xxxx */
+		0x03000400, 0x1c9d5400, 0x00000004, 0x0001c800,
+		/* INST 7: ADDR R2.xy (TR0.xyzw), R0, { 0.00, 0.50, 0.00, 0.00 } */
+		0x03000604, 0x1c9dc800, 0x0001c802, 0x0001c800,
+		0x00000000, 0x3f000000, 0x00000000, 0x00000000,
+		/* INST 8: ADDR R3.xy (TR0.xyzw), R0, { 0.00, -0.50, 0.00, 0.00 } */
+		0x03000606, 0x1c9dc800, 0x0001c802, 0x0001c800,
+		0x00000000, 0xbf000000, 0x00000000, 0x00000000,
+		/* INST 9: TEXR R1.y (TR0.xyzw), R2, texture[1] */
+		0x17020402, 0x1c9dc808, 0x0001c800, 0x0001c800,
+		/* INST 10: TEXR R1.z (TR0.xyzw), R3, texture[1] */
+		0x17020802, 0x1c9dc80c, 0x0001c800, 0x0001c800,
+		/* INST 11: ADDR R3.xy (TR0.xyzw), R0, { 0.00, 1.50, 0.00, 0.00 } */
+		0x03000606, 0x1c9dc800, 0x0001c802, 0x0001c800,
+		0x00000000, 0x3fc00000, 0x00000000, 0x00000000,
+		/* INST 12: TEXR R1.w (TR0.xyzw), R3, texture[1] */
+		0x17021002, 0x1c9dc80c, 0x0001c800, 0x0001c800,
+		/* INST 13: TEXR R3.z (TR0.xyzw), R2, texture[3] */
+		0x17060806, 0x1c9dc808, 0x0001c800, 0x0001c800,
+		/* INST 14: ADDR R2.w (TR0.xyzw), R1.yyyy, -R3.zzzz */
+		0x03001004, 0x1c9caa04, 0x0003540c, 0x0001c800,
+		/* INST 15: MAXR R2.w (TR0.xyzw), R2.wwww, -R2.wwww */
+		0x09001004, 0x1c9dfe08, 0x0003fe08, 0x0001c800,
+		/* INST 16: MADR_SAT R2.w (TR0.xyzw), R2.wwww, { 16.00, -0.50, 0.00, 0.00 }.xxxx, { 16.00, -0.50, 0.00, 0.00 }.yyyy */
+		0x84001004, 0x1c9dfe08, 0x00000002, 0x0000aa02,
+		0x41800000, 0xbf000000, 0x00000000, 0x00000000,
+		/* INST 17: ADDR R2.x (TR0.xyzw), R1.zzzz, R1.wwww */
+		0x03000204, 0x1c9d5404, 0x0001fe04, 0x0001c800,
+		/* INST 18: MULR R2.x (TR0.xyzw), R2.xxxx, { 0.50, 0.00, 0.00, 0.00 }.xxxx */
+		0x02000204, 0x1c9c0008, 0x00000002, 0x0001c800,
+		0x3f000000, 0x00000000, 0x00000000, 0x00000000,
+		/* INST 19: LRPR R2.y (TR0.xyzw), R2.wwww, R2.xxxx, R1.yyyy */
+		0x1f000404, 0x1c9dfe08, 0x00000008, 0x0000aa04,
+		/* INST 20: LRPR R2.z (TR0.xyzw), R1.xxxx, R1.zzzz, R2.yyyy */
+		0x1f000804, 0x1c9c0004, 0x00015404, 0x0000aa08,
+		/* INST 21: LRPR R2.w (TR0.xyzw), R1.xxxx, R2.yyyy, R1.wwww */
+		0x1f001004, 0x1c9c0004, 0x0000aa08, 0x0001fe04,
+		/* INST 22: LRPR R2.x (TR0.xyzw), R0.wwww, R2.wwww, R2.zzzz */
+		0x1f000204, 0x1c9dfe00, 0x0001fe08, 0x00015408,
+		/* INST 23: MADR R1.xyz (TR0.xyzw), R2.xxxx, { 1.16, -0.87, 0.53, -1.08 }.xxxx, { 1.16, -0.87, 0.53, -1.08 }.yzww */
+		0x04000e02, 0x1c9c0008, 0x00000002, 0x0001f202,
+		0x3f9507c8, 0xbf5ee393, 0x3f078fef, 0xbf8a6762,
+		/* INST 24: TEXR R0.yz (TR0.xyzw), attrib.texcoord[1], texture[2] */
+		0x1704ac00, 0x1c9dc801, 0x0001c800, 0x3fe1c800,
+		/* INST 25: MADR R1.xyz (TR0.xyzw), R0.yyyy, { 0.00, -0.39, 2.02, 0.00 }, R1 */
+		0x04000e02, 0x1c9caa00, 0x0001c802, 0x0001c804,
+		0x00000000, 0xbec890d6, 0x40011687, 0x00000000,
+		/* INST 26: MADR R0.xyz (TR0.xyzw), R0.zzzz, { 1.60, -0.81, 0.00, 0.00 }, R1 + END */
+		0x04000e81, 0x1c9d5400, 0x0001c802, 0x0001c804,
+		0x3fcc432d, 0xbf501a37, 0x00000000, 0x00000000,
+	}
+};
 
+nv_shader_t nv40_fp_yv12_adaptive_bottom = {
+	.card_priv.NV30FP.num_regs = 4,
+	.size = (38*4),
+	.data = {
+		/* INST 0: ADDR R0.xy (TR0.xyzw), attrib.texcoord[0], { 0.00, -0.50, 0.00, 0.00 } */
+		0x03008600, 0x1c9dc801, 0x0001c802, 0x3fe1c800,
+		0x00000000, 0xbf000000, 0x00000000, 0x00000000,
+		/* INST 1: FLRR R0.z (TR0.xyzw), R0.yyyy */
+		0x11000800, 0x1c9caa00, 0x0001c800, 0x0001c800,
+		/* INST 2: FRCR R0.w (TR0.xyzw), R0.yyyy */
+		0x10001000, 0x1c9caa00, 0x0001c800, 0x0001c800,
+		/* INST 3: MULR R1.x (TR0.xyzw), R0.zzzz, { 0.50, 0.00, 0.00, 0.00 }.xxxx */
+		0x02000202, 0x1c9d5400, 0x00000002, 0x0001c800,
+		0x3f000000, 0x00000000, 0x00000000, 0x00000000,
+		/* INST 4: FRCR R1.x (TR0.xyzw), R1.xxxx */
+		0x10000202, 0x1c9c0004, 0x0001c800, 0x0001c800,
+		/* INST 5: MADR R1.x (TR0.xyzw), R1.xxxx, { 2.00, 0.00, 0.00, 0.00 }.xxxx, { 2.00, 0.00, 0.00, 0.00 }.yyyy */
+		0x04000202, 0x1c9c0004, 0x00000002, 0x0000aa02,
+		0x40000000, 0x00000000, 0x00000000, 0x00000000,
+		/* INST 6: ADDR R0.y (TR0.xyzw), R0.zzzz, R1.xxxx */
+		0x03000400, 0x1c9d5400, 0x00000004, 0x0001c800,
+		/* INST 7: ADDR R2.xy (TR0.xyzw), R0, { 0.00, 0.50, 0.00, 0.00 } */
+		0x03000604, 0x1c9dc800, 0x0001c802, 0x0001c800,
+		0x00000000, 0x3f000000, 0x00000000, 0x00000000,
+		/* INST 8: ADDR R3.xy (TR0.xyzw), R0, { 0.00, -0.50, 0.00, 0.00 } */
+		0x03000606, 0x1c9dc800, 0x0001c802, 0x0001c800,
+		0x00000000, 0xbf000000, 0x00000000, 0x00000000,
+		/* INST 9: TEXR R1.y (TR0.xyzw), R2, texture[1] */
+		0x17020402, 0x1c9dc808, 0x0001c800, 0x0001c800,
+		/* INST 10: TEXR R1.z (TR0.xyzw), R3, texture[1] */
+		0x17020802, 0x1c9dc80c, 0x0001c800, 0x0001c800,
+		/* INST 11: ADDR R3.xy (TR0.xyzw), R0, { 0.00, 1.50, 0.00, 0.00 } */
+		0x03000606, 0x1c9dc800, 0x0001c802, 0x0001c800,
+		0x00000000, 0x3fc00000, 0x00000000, 0x00000000,
+		/* INST 12: TEXR R1.w (TR0.xyzw), R3, texture[1] */
+		0x17021002, 0x1c9dc80c, 0x0001c800, 0x0001c800,
+		/* INST 13: TEXR R3.z (TR0.xyzw), R2, texture[3] */
+		0x17060806, 0x1c9dc808, 0x0001c800, 0x0001c800,
+		/* INST 14: ADDR R2.w (TR0.xyzw), R1.yyyy, -R3.zzzz */
+		0x03001004, 0x1c9caa04, 0x0003540c, 0x0001c800,
+		/* INST 15: MAXR R2.w (TR0.xyzw), R2.wwww, -R2.wwww */
+		0x09001004, 0x1c9dfe08, 0x0003fe08, 0x0001c800,
+		/* INST 16: MADR_SAT R2.w (TR0.xyzw), R2.wwww, { 16.00, -0.50, 0.00, 0.00 }.xxxx, { 16.00, -0.50, 0.00, 0.00 }.yyyy */
+		0x84001004, 0x1c9dfe08, 0x00000002, 0x0000aa02,
+		0x41800000, 0xbf000000, 0x00000000, 0x00000000,
+		/* INST 17: ADDR R2.x (TR0.xyzw), R1.zzzz, R1.wwww */
+		0x03000204, 0x1c9d5404, 0x0001fe04, 0x0001c800,
+		/* INST 18: MULR R2.x (TR0.xyzw), R2.xxxx, { 0.50, 0.00, 0.00, 0.00 }.xxxx */
+		0x02000204, 0x1c9c0008, 0x00000002, 0x0001c800,
+		0x3f000000, 0x00000000, 0x00000000, 0x00000000,
+		/* INST 19: LRPR R2.y (TR0.xyzw), R2.wwww, R2.xxxx, R1.yyyy */
+		0x1f000404, 0x1c9dfe08, 0x00000008, 0x0000aa04,
+		/* INST 20: LRPR R2.z (TR0.xyzw), R1.xxxx, R1.zzzz, R2.yyyy */
+		0x1f000804, 0x1c9c0004, 0x00015404, 0x0000aa08,
+		/* INST 21: LRPR R2.w (TR0.xyzw), R1.xxxx, R2.yyyy, R1.wwww */
+		0x1f001004, 0x1c9c0004, 0x0000aa08, 0x0001fe04,
+		/* INST 22: LRPR R2.x (TR0.xyzw), R0.wwww, R2.wwww, R2.zzzz */
+		0x1f000204, 0x1c9dfe00, 0x0001fe08, 0x00015408,
+		/* INST 23: MADR R1.xyz (TR0.xyzw), R2.xxxx, { 1.16, -0.87, 0.53, -1.08 }.xxxx, { 1.16, -0.87, 0.53, -1.08 }.yzww */
+		0x04000e02, 0x1c9c0008, 0x00000002, 0x0001f202,
+		0x3f9507c8, 0xbf5ee393, 0x3f078fef, 0xbf8a6762,
+		/* INST 24: TEXR R0.yz (TR0.xyzw), attrib.texcoord[1], texture[2] */
+		0x1704ac00, 0x1c9dc801, 0x0001c800, 0x3fe1c800,
+		/* INST 25: MADR R1.xyz (TR0.xyzw), R0.yyyy, { 0.00, -0.39, 2.02, 0.00 }, R1 */
+		0x04000e02, 0x1c9caa00, 0x0001c802, 0x0001c804,
+		0x00000000, 0xbec890d6, 0x40011687, 0x00000000,
+		/* INST 26: MADR R0.xyz (TR0.xyzw), R0.zzzz, { 1.60, -0.81, 0.00, 0.00 }, R1 + END */
+		0x04000e81, 0x1c9d5400, 0x0001c802, 0x0001c804,
+		0x3fcc432d, 0xbf501a37, 0x00000000, 0x00000000,
+	}
+};
@@ -47,6 +47,7 @@ void NV40_UploadVtxProg(NVPtr pNv, nv_shader_t *shader, int *hw_id);
 void NV40_LoadVtxProg(ScrnInfoPtr pScrn, nv_shader_t *shader);
 Bool NV40_LoadFragProg(ScrnInfoPtr pScrn, nv_shader_t *shader);
 Bool NV30_LoadFragProg(ScrnInfoPtr pScrn, nv_shader_t *shader);
+void NV30_ProjectiveFragProg(nv_shader_t *proj, nv_shader_t *shader);
 
 
 /*******************************************************************************
@@ -68,5 +69,7 @@ nv_shader_t nv30_fp_composite_mask_ca;
 nv_shader_t nv30_fp_yv12_bicubic;
 nv_shader_t nv30_fp_yv12_bilinear;
 nv_shader_t nv40_fp_yv12_bicubic;
+nv_shader_t nv40_fp_yv12_adaptive_top;
+nv_shader_t nv40_fp_yv12_adaptive_bottom;
 
 #endif
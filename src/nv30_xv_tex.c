@@ -39,80 +39,8 @@
 #include "nv30_shaders.h"
 #include "nv04_pushbuf.h"
 
-extern Atom xvSyncToVBlank, xvSetDefaults;
-
-/*
- * The filtering function used for video scaling. We use a cubic filter as defined in 
- * "Reconstruction Filters in Computer Graphics"
- * Mitchell & Netravali in SIGGRAPH '88 
- */
-static float filter_func(float x)
-{
-	const double B=0.75;
-	const double C=(1.0-B)/2.0;
-	double x1=fabs(x);
-	double x2=fabs(x)*x1;
-	double x3=fabs(x)*x2;
-
-	if (fabs(x)<1.0) 
-		return ( (12.0-9.0*B-6.0*C)*x3+(-18.0+12.0*B+6.0*C)*x2+(6.0-2.0*B) )/6.0; 
-	else 
-		return ( (-B-6.0*C)*x3+(6.0*B+30.0*C)*x2+(-12.0*B-48.0*C)*x1+(8.0*B+24.0*C) )/6.0;
-}
-
-static int8_t f32tosb8(float v)
-{
-	return (int8_t)(v*127.0);
-}
-
-/*
- * 512 means 2048 bytes of VRAM
- */
-#define TABLE_SIZE 512
-static void compute_filter_table(int8_t *t) {
-	int i;
-	float x;
-	for(i=0;i<TABLE_SIZE;i++) {
-		x=(i+0.5)/TABLE_SIZE;
-
-		float w0=filter_func(x+1.0);
-		float w1=filter_func(x);
-		float w2=filter_func(x-1.0);
-		float w3=filter_func(x-2.0);
-
-		t[4*i+2]=f32tosb8(1.0+x-w1/(w0+w1));
-		t[4*i+1]=f32tosb8(1.0-x+w3/(w2+w3));
-		t[4*i+0]=f32tosb8(w0+w1);
-		t[4*i+3]=f32tosb8(0.0);
-	}
-}
-
-static void
-NV30_LoadFilterTable(ScrnInfoPtr pScrn)
-{
-	NVPtr pNv = NVPTR(pScrn);
-
-	if (!pNv->xv_filtertable_mem) {
-		if (nouveau_bo_new(pNv->dev, NOUVEAU_BO_VRAM | NOUVEAU_BO_GART |
-				   NOUVEAU_BO_MAP, 0,
-				   TABLE_SIZE * sizeof(float) * 4,
-				   &pNv->xv_filtertable_mem)) {
-			xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
-				"Couldn't alloc filter table!\n");
-			return;
-		}
-
-		if (nouveau_bo_map(pNv->xv_filtertable_mem, NOUVEAU_BO_RDWR)) {
-			xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
-				   "Couldn't map filter table!\n");
-			return;
-		}
-
-		int8_t *t=pNv->xv_filtertable_mem->map;
-		compute_filter_table(t);
-		nouveau_bo_unmap(pNv->xv_filtertable_mem);
-	}
-}
+extern Atom xvSyncToVBlank, xvSetDefaults, xvDeinterlace;
+extern Atom xvFilterSharpness;
 
 #define SWIZZLE(ts0x,ts0y,ts0z,ts0w,ts1x,ts1y,ts1z,ts1w)			\
 	(									\
@@ -234,6 +162,9 @@ NV30GetSurfaceFormat(PixmapPtr ppix, int *fmt_ret)
 void
 NV30StopTexturedVideo(ScrnInfoPtr pScrn, pointer data, Bool Exit)
 {
+	nouveau_xv_present_cancel(data);
+	if (Exit)
+		NVFreePortMemory(pScrn, data);
 }
 
 #define VERTEX_OUT(sx,sy,dx,dy) do {                                           \
@@ -260,6 +191,7 @@ NV30PutTextureImage(ScrnInfoPtr pScrn, struct nouveau_bo *src, int src_offset,
 	struct nouveau_grobj *rankine = pNv->Nv3D;
 	struct nouveau_bo *bo = nouveau_pixmap_bo(ppix);
 	Bool bicubic = pPriv->bicubic;
+	int table;
 	float X1, X2, Y1, Y2;
 	BoxPtr pbox;
 	int nbox;
@@ -314,14 +246,18 @@ NV30PutTextureImage(ScrnInfoPtr pScrn, struct nouveau_bo *src, int src_offset,
 		OUT_RING  (chan, (y<<16)|x);
 	}
 
-	NV30_LoadFilterTable(pScrn);
+	table = NVXvFilterTable(pScrn, pPriv);
+	if (table < 0) {
+		MARK_UNDO(chan);
+		return BadAlloc;
+	}
 
 	BEGIN_RING(chan, rankine, NV34TCL_TX_UNITS_ENABLE, 1);
 	OUT_RING  (chan, NV34TCL_TX_UNITS_ENABLE_TX0 |
 			 NV34TCL_TX_UNITS_ENABLE_TX1);
 
-	if (!NV30VideoTexture(pScrn, pNv->xv_filtertable_mem, 0, TABLE_SIZE,
-			      1, 0 , 0) ||
+	if (!NV30VideoTexture(pScrn, pNv->xv_filtertable_mem, table,
+			      NV_FILTER_TABLE_SIZE, 1, 0, 0) ||
 	    !NV30VideoTexture(pScrn, src, src_offset, src_w, src_h,
 		    	      src_pitch, 1)) {
 		MARK_UNDO(chan);
@@ -407,7 +343,7 @@ NV30PutTextureImage(ScrnInfoPtr pScrn, struct nouveau_bo *src, int src_offset,
  * NV30SetTexturePortAttribute
  * sets the attribute "attribute" of port "data" to value "value"
  * supported attributes:
- * Sync to vblank.
+ * Sync to vblank, deinterlacing, filter sharpness.
  * 
  * @param pScrenInfo
  * @param attribute attribute to set
@@ -428,8 +364,21 @@ NV30SetTexturePortAttribute(ScrnInfoPtr pScrn, Atom attribute,
                         return BadValue;
                 pPriv->SyncToVBlank = value;
         } else
+        if (attribute == xvDeinterlace) {
+                if ((value < NV_DEINTERLACE_WEAVE) ||
+                    (value > NV_DEINTERLACE_BOTTOM))
+                        return BadValue;
+                pPriv->deinterlace = value;
+        } else
+        if (attribute == xvFilterSharpness && pPriv->bicubic) {
+                if ((value < 0) || (value > NV_FILTER_SHARPNESS_MAX))
+                        return BadValue;
+                pPriv->sharpness = value;
+        } else
         if (attribute == xvSetDefaults) {
                 pPriv->SyncToVBlank = TRUE;
+                pPriv->deinterlace = NV_DEINTERLACE_WEAVE;
+                pPriv->sharpness = NV_FILTER_SHARPNESS_DEFAULT;
         } else
                 return BadMatch;
 
@@ -439,7 +388,7 @@ NV30SetTexturePortAttribute(ScrnInfoPtr pScrn, Atom attribute,
 /**
  * NV30GetTexturePortAttribute
  * reads the value of attribute "attribute" from port "data" into INT32 "*value"
- * Sync to vblank.
+ * Sync to vblank, deinterlacing, filter sharpness.
  * 
  * @param pScrn unused
  * @param attribute attribute to be read
@@ -455,6 +404,12 @@ NV30GetTexturePortAttribute(ScrnInfoPtr pScrn, Atom attribute,
 
         if(attribute == xvSyncToVBlank)
                 *value = (pPriv->SyncToVBlank) ? 1 : 0;
+        else
+        if (attribute == xvDeinterlace)
+                *value = pPriv->deinterlace;
+        else
+        if (attribute == xvFilterSharpness && pPriv->bicubic)
+                *value = pPriv->sharpness;
         else
                 return BadMatch;
 
@@ -44,6 +44,7 @@ typedef struct nv_pict_op {
 
 typedef struct nv40_exa_state {
 	Bool have_mask;
+	Bool projective;
 
 	struct {
 		PictTransformPtr transform;
@@ -95,6 +96,20 @@ static nv_shader_t *nv40_fp_map[NV40EXA_FPID_MAX] = {
 };
 
 static nv_shader_t *nv40_fp_map_a8[NV40EXA_FPID_MAX];
+static nv_shader_t nv40_fp_proj[NV40EXA_FPID_MAX];
+static nv_shader_t nv40_fp_proj_a8[NV40EXA_FPID_MAX];
+
+static void
+NV40EXAHackupProjShaders(ScrnInfoPtr pScrn)
+{
+	int s;
+
+	for (s = 0; s < NV40EXA_FPID_MAX; s++) {
+		NV30_ProjectiveFragProg(&nv40_fp_proj[s], nv40_fp_map[s]);
+		NV30_ProjectiveFragProg(&nv40_fp_proj_a8[s],
+					nv40_fp_map_a8[s]);
+	}
+}
 
 static void
 NV40EXAHackupA8Shaders(ScrnInfoPtr pScrn)
@@ -261,9 +276,9 @@ NV40EXATexture(ScrnInfoPtr pScrn, PixmapPtr pPix, PicturePtr pPict, int unit)
 	if (pPict->repeat) {
 		switch(pPict->repeatType) {
 		case RepeatPad:
-			OUT_RING  (chan, NV40TCL_TEX_WRAP_S_CLAMP | 
-					 NV40TCL_TEX_WRAP_T_CLAMP |
-					 NV40TCL_TEX_WRAP_R_CLAMP);
+			OUT_RING  (chan, NV40TCL_TEX_WRAP_S_CLAMP_TO_EDGE |
+					 NV40TCL_TEX_WRAP_T_CLAMP_TO_EDGE |
+					 NV40TCL_TEX_WRAP_R_CLAMP_TO_EDGE);
 			break;
 		case RepeatReflect:
 			OUT_RING  (chan, NV40TCL_TEX_WRAP_S_MIRRORED_REPEAT |
@@ -329,6 +344,13 @@ NV40_SetupSurface(ScrnInfoPtr pScrn, PixmapPtr pPix, PictFormatShort format)
 	return TRUE;
 }
 
+static Bool
+NV40EXATransformIsProjective(PictTransformPtr t)
+{
+	return t && (t->matrix[2][0] || t->matrix[2][1] ||
+		     t->matrix[2][2] != xFixed1);
+}
+
 static Bool
 NV40EXACheckCompositeTexture(PicturePtr pPict, PicturePtr pdPict, int op)
 {
@@ -394,6 +416,9 @@ NV40EXACheckComposite(int op, PicturePtr psPict,
 			NOUVEAU_FALLBACK("mask picture\n");
 	}
 
+	if (!NVAccelInit3D(xf86Screens[pdPict->pDrawable->pScreen->myNum]))
+		NOUVEAU_FALLBACK("3D engine unavailable\n");
+
 	return TRUE;
 }
 
@@ -420,6 +445,7 @@ NV40EXAPrepareComposite(int op, PicturePtr psPict,
 	struct nouveau_channel *chan = pNv->chan;
 	struct nouveau_grobj *curie = pNv->Nv3D;
 	nv_pict_op_t *blend;
+	nv_shader_t *shader;
 	int fpid = NV40EXA_FPID_PASS_COL0;
 	NV40EXA_STATE;
 
@@ -461,9 +487,19 @@ NV40EXAPrepareComposite(int op, PicturePtr psPict,
 		state->have_mask = FALSE;
 	}
 
+	state->projective =
+		NV40EXATransformIsProjective(psPict->transform) ||
+		(pmPict && NV40EXATransformIsProjective(pmPict->transform));
+
+	if (state->projective) {
+		shader = (pdPict->format == PICT_a8) ?
+			 &nv40_fp_proj_a8[fpid] : &nv40_fp_proj[fpid];
+	} else {
+		shader = (pdPict->format == PICT_a8) ?
+			 nv40_fp_map_a8[fpid] : nv40_fp_map[fpid];
+	}
 
-	if (!NV40_LoadFragProg(pScrn, (pdPict->format == PICT_a8) ?
-			       nv40_fp_map_a8[fpid] : nv40_fp_map[fpid])) {
+	if (!NV40_LoadFragProg(pScrn, shader)) {
 		MARK_UNDO(chan);
 		return FALSE;
 	}
@@ -490,21 +526,27 @@ NV40EXAPrepareComposite(int op, PicturePtr psPict,
 #define xFixedToFloat(v) \
 	((float)xFixedToInt((v)) + ((float)xFixedFrac(v) / 65536.0))
 
+/* For projective transforms the homogeneous coordinate is returned in w_ret
+ * rather than divided out here, the TXP fragment programs take care of that
+ * per-fragment.
+ */
 static inline void
 NV40EXATransformCoord(PictTransformPtr t, int x, int y, float sx, float sy,
-					  float *x_ret, float *y_ret)
+		      float *x_ret, float *y_ret, float *w_ret)
 {
 	if (t) {
 		PictVector v;
 		v.vector[0] = IntToxFixed(x);
 		v.vector[1] = IntToxFixed(y);
 		v.vector[2] = xFixed1;
-		PictureTransformPoint(t, &v);
+		PictureTransformPoint3d(t, &v);
 		*x_ret = xFixedToFloat(v.vector[0]) / sx;
 		*y_ret = xFixedToFloat(v.vector[1]) / sy;
+		*w_ret = xFixedToFloat(v.vector[2]);
 	} else {
 		*x_ret = (float)x / sx;
 		*y_ret = (float)y / sy;
+		*w_ret = 1.0;
 	}
 }
 
@@ -521,6 +563,15 @@ NV40EXATransformCoord(PictTransformPtr t, int x, int y, float sx, float sy,
 	BEGIN_RING(chan, curie, NV40TCL_VTX_ATTR_2I(0), 1);                    \
 	OUT_RING  (chan, ((dy)<<16)|(dx));                                     \
 } while(0)
+#define CV_OUTp(sx,sy,sw,mx,my,mw,dx,dy) do {                                  \
+	BEGIN_RING(chan, curie, NV40TCL_VTX_ATTR_4F_X(8), 8);                  \
+	OUT_RINGf (chan, (sx)); OUT_RINGf (chan, (sy));                        \
+	OUT_RINGf (chan, 0.0);  OUT_RINGf (chan, (sw));                        \
+	OUT_RINGf (chan, (mx)); OUT_RINGf (chan, (my));                        \
+	OUT_RINGf (chan, 0.0);  OUT_RINGf (chan, (mw));                        \
+	BEGIN_RING(chan, curie, NV40TCL_VTX_ATTR_2I(0), 1);                    \
+	OUT_RING  (chan, ((dy)<<16)|(dx));                                     \
+} while(0)
 
 void
 NV40EXAComposite(PixmapPtr pdPix, int srcX , int srcY,
@@ -532,8 +583,8 @@ NV40EXAComposite(PixmapPtr pdPix, int srcX , int srcY,
 	NVPtr pNv = NVPTR(pScrn);
 	struct nouveau_channel *chan = pNv->chan;
 	struct nouveau_grobj *curie = pNv->Nv3D;
-	float sX0, sX1, sX2, sY0, sY1, sY2;
-	float mX0, mX1, mX2, mY0, mY1, mY2;
+	float sX0, sX1, sX2, sY0, sY1, sY2, sW0, sW1, sW2;
+	float mX0, mX1, mX2, mY0, mY1, mY2, mW0, mW1, mW2;
 	NV40EXA_STATE;
 
 	WAIT_RING(chan, 64);
@@ -551,29 +602,39 @@ NV40EXAComposite(PixmapPtr pdPix, int srcX , int srcY,
 
 	NV40EXATransformCoord(state->unit[0].transform, srcX, srcY - height,
 			      state->unit[0].width, state->unit[0].height,
-			      &sX0, &sY0);
+			      &sX0, &sY0, &sW0);
 	NV40EXATransformCoord(state->unit[0].transform, srcX, srcY + height,
 			      state->unit[0].width, state->unit[0].height,
-			      &sX1, &sY1);
+			      &sX1, &sY1, &sW1);
 	NV40EXATransformCoord(state->unit[0].transform,
 			      srcX + 2*width, srcY + height,
 			      state->unit[0].width,
-			      state->unit[0].height, &sX2, &sY2);
+			      state->unit[0].height, &sX2, &sY2, &sW2);
 
 	if (state->have_mask) {
 		NV40EXATransformCoord(state->unit[1].transform,
 				      maskX, maskY - height,
 				      state->unit[1].width,
-				      state->unit[1].height, &mX0, &mY0);
+				      state->unit[1].height, &mX0, &mY0, &mW0);
 		NV40EXATransformCoord(state->unit[1].transform,
 				      maskX, maskY + height,
 				      state->unit[1].width,
-				      state->unit[1].height, &mX1, &mY1);
+				      state->unit[1].height, &mX1, &mY1, &mW1);
 		NV40EXATransformCoord(state->unit[1].transform,
 				      maskX + 2*width, maskY + height,
 				      state->unit[1].width,
-				      state->unit[1].height, &mX2, &mY2);
+				      state->unit[1].height, &mX2, &mY2, &mW2);
+	} else {
+		mX0 = mX1 = mX2 = mY0 = mY1 = mY2 = 0.0;
+		mW0 = mW1 = mW2 = 1.0;
+	}
 
+	if (state->projective) {
+		CV_OUTp(sX0, sY0, sW0, mX0, mY0, mW0, dstX, dstY - height);
+		CV_OUTp(sX1, sY1, sW1, mX1, mY1, mW1, dstX, dstY + height);
+		CV_OUTp(sX2, sY2, sW2, mX2, mY2, mW2,
+			dstX + 2*width, dstY + height);
+	} else if (state->have_mask) {
 		CV_OUTm(sX0, sY0, mX0, mY0, dstX, dstY - height);
 		CV_OUTm(sX1, sY1, mX1, mY1, dstX, dstY + height);
 		CV_OUTm(sX2, sY2, mX2, mY2, dstX + 2*width, dstY + height);
@@ -610,6 +671,7 @@ NVAccelInitNV40TCL(ScrnInfoPtr pScrn)
 
 	if (!nv40_fp_map_a8[0])
 		NV40EXAHackupA8Shaders(pScrn);
+	NV40EXAHackupProjShaders(pScrn);
 
 	chipset = pNv->dev->chipset;
 	if ((chipset & 0xf0) == NV_ARCH_40) {
@@ -752,11 +814,17 @@ NVAccelInitNV40TCL(ScrnInfoPtr pScrn)
 	for (i = 0; i < NV40EXA_FPID_MAX; i++) {
 		NV30_UploadFragProg(pNv, nv40_fp_map[i], &next_hw_offset);
 		NV30_UploadFragProg(pNv, nv40_fp_map_a8[i], &next_hw_offset);
+		NV30_UploadFragProg(pNv, &nv40_fp_proj[i], &next_hw_offset);
+		NV30_UploadFragProg(pNv, &nv40_fp_proj_a8[i],
+				    &next_hw_offset);
 	}
 
 	NV40_UploadVtxProg(pNv, &nv40_vp_video, &next_hw_id);
 	NV30_UploadFragProg(pNv, &nv40_fp_yv12_bicubic, &next_hw_offset);
 	NV30_UploadFragProg(pNv, &nv30_fp_yv12_bilinear, &next_hw_offset);
+	NV30_UploadFragProg(pNv, &nv40_fp_yv12_adaptive_top, &next_hw_offset);
+	NV30_UploadFragProg(pNv, &nv40_fp_yv12_adaptive_bottom,
+			    &next_hw_offset);
 
 	return TRUE;
 }
@@ -39,82 +39,8 @@
 #include "nv30_shaders.h"
 #include "nv04_pushbuf.h"
 
-extern Atom xvSyncToVBlank, xvSetDefaults;
-
-/*
- * The filtering function used for video scaling. We use a cubic filter as defined in 
- * "Reconstruction Filters in Computer Graphics"
- * Mitchell & Netravali in SIGGRAPH '88 
- */
-static float filter_func(float x)
-{
-	const double B=0.75;
-	const double C=(1.0-B)/2.0;
-	double x1=fabs(x);
-	double x2=fabs(x)*x1;
-	double x3=fabs(x)*x2;
-
-	if (fabs(x)<1.0) 
-		return ( (12.0-9.0*B-6.0*C)*x3+(-18.0+12.0*B+6.0*C)*x2+(6.0-2.0*B) )/6.0; 
-	else 
-		return ( (-B-6.0*C)*x3+(6.0*B+30.0*C)*x2+(-12.0*B-48.0*C)*x1+(8.0*B+24.0*C) )/6.0;
-}
-
-static int8_t f32tosb8(float v)
-{
-	return (int8_t)(v*127.0);
-}
-
-/*
- * Implements the filtering as described in
- * "Fast Third-Order Texture Filtering"
- * Sigg & Hardwiger in GPU Gems 2
- */
-#define TABLE_SIZE 512
-static void compute_filter_table(int8_t *t) {
-	int i;
-	float x;
-	for(i=0;i<TABLE_SIZE;i++) {
-		x=(i+0.5)/TABLE_SIZE;
-
-		float w0=filter_func(x+1.0);
-		float w1=filter_func(x);
-		float w2=filter_func(x-1.0);
-		float w3=filter_func(x-2.0);
-
-		t[4*i+2]=f32tosb8(1.0+x-w1/(w0+w1));
-		t[4*i+1]=f32tosb8(1.0-x+w3/(w2+w3));
-		t[4*i+0]=f32tosb8(w0+w1);
-		t[4*i+3]=f32tosb8(0.0);
-	}
-}
-
-static void
-NV40_LoadFilterTable(ScrnInfoPtr pScrn)
-{
-	NVPtr pNv = NVPTR(pScrn);
-
-	if (!pNv->xv_filtertable_mem) {
-		if (nouveau_bo_new(pNv->dev, NOUVEAU_BO_VRAM | NOUVEAU_BO_GART |
-				   NOUVEAU_BO_MAP, 0,
-				   TABLE_SIZE * sizeof(float) * 4,
-				   &pNv->xv_filtertable_mem)) {
-			xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
-				"Couldn't alloc filter table!\n");
-			return;
-		}
-
-		if (nouveau_bo_map(pNv->xv_filtertable_mem, NOUVEAU_BO_RDWR)) {
-			xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
-				   "Couldn't map filter table!\n");
-			return;
-		}
-
-		int8_t *t=pNv->xv_filtertable_mem->map;
-		compute_filter_table(t);
-		nouveau_bo_unmap(pNv->xv_filtertable_mem);
-	}
-}
+extern Atom xvSyncToVBlank, xvSetDefaults, xvDeinterlace;
+extern Atom xvFilterSharpness;
 
 #define SWIZZLE(ts0x,ts0y,ts0z,ts0w,ts1x,ts1y,ts1z,ts1w)				\
 	(										\
@@ -128,6 +54,7 @@ NV40_LoadFilterTable(ScrnInfoPtr pScrn)
  * Texture 0 : filter table
  * Texture 1 : Y data
  * Texture 2 : UV data
+ * Texture 3 : Y data of the previous frame (motion-adaptive deinterlacing)
  */
 static Bool
 NV40VideoTexture(ScrnInfoPtr pScrn, struct nouveau_bo *src, int offset,
@@ -146,6 +73,7 @@ NV40VideoTexture(ScrnInfoPtr pScrn, struct nouveau_bo *src, int offset,
 		card_swz = SWIZZLE(S1, S1, S1, S1, X, Y, Z, W);
 		break;
 	case 1:
+	case 3:
 		card_fmt = NV40TCL_TEX_FORMAT_FORMAT_L8;
 		card_swz = SWIZZLE(S1, S1, S1, S1, X, X, X, X);
 		break;
@@ -238,6 +166,9 @@ NV40GetSurfaceFormat(PixmapPtr ppix, int *fmt_ret)
 void
 NV40StopTexturedVideo(ScrnInfoPtr pScrn, pointer data, Bool Exit)
 {
+	nouveau_xv_present_cancel(data);
+	if (Exit)
+		NVFreePortMemory(pScrn, data);
 }
 
 #define VERTEX_OUT(sx,sy,dx,dy) do {                                           \
@@ -264,6 +195,8 @@ NV40PutTextureImage(ScrnInfoPtr pScrn,
 	struct nouveau_grobj *curie = pNv->Nv3D;
 	struct nouveau_bo *bo = nouveau_pixmap_bo(ppix);
 	Bool bicubic = pPriv->bicubic;
+	nv_shader_t *fp;
+	int table, prev;
 	float X1, X2, Y1, Y2;
 	BoxPtr pbox;
 	int nbox;
@@ -283,7 +216,7 @@ NV40PutTextureImage(ScrnInfoPtr pScrn,
 	pbox = REGION_RECTS(clipBoxes);
 	nbox = REGION_NUM_RECTS(clipBoxes);
 
-	if (MARK_RING(chan, 128, 1 + 1 + 3*2))
+	if (MARK_RING(chan, 128, 1 + 1 + 4*2))
 		return BadImplementation;
 
 	/* Disable blending */
@@ -300,10 +233,14 @@ NV40PutTextureImage(ScrnInfoPtr pScrn,
 		return BadImplementation;
 	}
 
-	NV40_LoadFilterTable(pScrn);
+	table = NVXvFilterTable(pScrn, pPriv);
+	if (table < 0) {
+		MARK_UNDO(chan);
+		return BadAlloc;
+	}
 
-	if (!NV40VideoTexture(pScrn, pNv->xv_filtertable_mem, 0, TABLE_SIZE,
-			      1, 0 , 0) ||
+	if (!NV40VideoTexture(pScrn, pNv->xv_filtertable_mem, table,
+			      NV_FILTER_TABLE_SIZE, 1, 0, 0) ||
 	    !NV40VideoTexture(pScrn, src, src_offset, src_w, src_h,
 			      src_pitch, 1)) {
 		MARK_UNDO(chan);
@@ -322,9 +259,27 @@ NV40PutTextureImage(ScrnInfoPtr pScrn,
 	if (drw_w / 2 < src_w || drw_h / 2 < src_h)
 		bicubic = FALSE;
 
-	if (!NV40_LoadFragProg(pScrn, bicubic ?
-			       &nv40_fp_yv12_bicubic :
-			       &nv30_fp_yv12_bilinear)) {
+	if (pPriv->deinterlace == NV_DEINTERLACE_ADAPTIVE_TOP ||
+	    pPriv->deinterlace == NV_DEINTERLACE_ADAPTIVE_BOTTOM) {
+		/* Without a previous frame there's no motion: weave */
+		prev = pPriv->deint_prev >= 0 ? pPriv->deint_prev : src_offset;
+		if (!NV40VideoTexture(pScrn, src, prev, src_w, src_h,
+				      src_pitch, 3)) {
+			MARK_UNDO(chan);
+			return BadImplementation;
+		}
+
+		if (pPriv->deinterlace == NV_DEINTERLACE_ADAPTIVE_TOP)
+			fp = &nv40_fp_yv12_adaptive_top;
+		else
+			fp = &nv40_fp_yv12_adaptive_bottom;
+	} else
+	if (bicubic)
+		fp = &nv40_fp_yv12_bicubic;
+	else
+		fp = &nv30_fp_yv12_bilinear;
+
+	if (!NV40_LoadFragProg(pScrn, fp)) {
 		MARK_UNDO(chan);
 		return BadImplementation;
 	}
@@ -385,7 +340,7 @@ NV40PutTextureImage(ScrnInfoPtr pScrn,
  * NV40SetTexturePortAttribute
  * sets the attribute "attribute" of port "data" to value "value"
  * supported attributes:
- * Sync to vblank.
+ * Sync to vblank, deinterlacing, filter sharpness.
  * 
  * @param pScrenInfo
  * @param attribute attribute to set
@@ -406,8 +361,21 @@ NV40SetTexturePortAttribute(ScrnInfoPtr pScrn, Atom attribute,
                         return BadValue;
                 pPriv->SyncToVBlank = value;
         } else
+        if (attribute == xvDeinterlace) {
+                if ((value < NV_DEINTERLACE_WEAVE) ||
+                    (value > NV_DEINTERLACE_ADAPTIVE_BOTTOM))
+                        return BadValue;
+                pPriv->deinterlace = value;
+        } else
+        if (attribute == xvFilterSharpness && pPriv->bicubic) {
+                if ((value < 0) || (value > NV_FILTER_SHARPNESS_MAX))
+                        return BadValue;
+                pPriv->sharpness = value;
+        } else
         if (attribute == xvSetDefaults) {
                 pPriv->SyncToVBlank = TRUE;
+                pPriv->deinterlace = NV_DEINTERLACE_WEAVE;
+                pPriv->sharpness = NV_FILTER_SHARPNESS_DEFAULT;
         } else
                 return BadMatch;
 
@@ -417,7 +385,7 @@ NV40SetTexturePortAttribute(ScrnInfoPtr pScrn, Atom attribute,
 /**
  * NV40GetTexturePortAttribute
  * reads the value of attribute "attribute" from port "data" into INT32 "*value"
- * Sync to vblank.
+ * Sync to vblank, deinterlacing, filter sharpness.
  * 
  * @param pScrn unused
  * @param attribute attribute to be read
@@ -433,6 +401,12 @@ NV40GetTexturePortAttribute(ScrnInfoPtr pScrn, Atom attribute,
 
         if(attribute == xvSyncToVBlank)
                 *value = (pPriv->SyncToVBlank) ? 1 : 0;
+        else
+        if (attribute == xvDeinterlace)
+                *value = pPriv->deinterlace;
+        else
+        if (attribute == xvFilterSharpness && pPriv->bicubic)
+                *value = pPriv->sharpness;
         else
                 return BadMatch;
 
@@ -29,15 +29,23 @@ NV50SyncToVBlank(PixmapPtr ppix, BoxPtr box)
 	ScrnInfoPtr pScrn = xf86Screens[ppix->drawable.pScreen->myNum];
 	NVPtr pNv = NVPTR(pScrn);
 	struct nouveau_channel *chan = pNv->chan;
-	struct nouveau_grobj *nvsw = pNv->NvSW;
+	struct nouveau_grobj *nvsw;
 	int crtcs;
 
 	if (!nouveau_exa_pixmap_is_onscreen(ppix))
 		return;
 
+	if (!NVAccelInit3D(pScrn) || !pNv->NvSW)
+		return;
+	nvsw = pNv->NvSW;
+
 	crtcs = nv_window_belongs_to_crtc(pScrn, box->x1, box->y1,
 					  box->x2 - box->x1,
 					  box->y2 - box->y1);
+	/* TearFree CRTCs don't scan out of the screen pixmap, and only ever
+	 * flip to a complete frame, so waiting on them is just a stall.
+	 */
+	crtcs &= ~drmmode_tearfree_crtcs(pScrn);
 	if (!crtcs)
 		return;
 
@@ -102,6 +110,7 @@ NVAccelInitNV50TCL(ScrnInfoPtr pScrn)
 					   &pNv->vblank_sem)) {
 			nouveau_grobj_free(&pNv->NvSW);
 			nouveau_grobj_free(&pNv->Nv3D);
+			return FALSE;
 		}
 
 		if (nouveau_bo_new(pNv->dev, NOUVEAU_BO_VRAM, 0, 65536,
@@ -9,6 +9,8 @@
 #define TIC_OFFSET  0x00002000 /* Texture Image Control */
 #define TSC_OFFSET  0x00003000 /* Texture Sampler Control */
 #define PFP_DATA    0x00004000 /* FP constbuf */
+#define PICT_OFFSET 0x00005000 /* Solid/gradient source ramps */
+#define PICT_SIZE   0x00000400 /* ... per texture unit */
 
 /* Fragment programs */
 #define PFP_S     0x0000 /* (src) */
@@ -35,6 +35,8 @@ struct nv50_exa_state {
 		PictTransformPtr transform;
 		float width;
 		float height;
+		Bool source;
+		float coeff[3];
 	} unit[2];
 };
 static struct nv50_exa_state exa_state;
@@ -471,10 +473,6 @@ NV50EXARenderTarget(PixmapPtr ppix, PicturePtr ppict)
 	struct nouveau_bo *bo = nouveau_pixmap_bo(ppix);
 	unsigned format;
 
-	/*XXX: Scanout buffer not tiled, someone needs to figure it out */
-	if (!nv50_style_tiled_pixmap(ppix))
-		NOUVEAU_FALLBACK("pixmap is scanout buffer\n");
-
 	switch (ppict->format) {
 	case PICT_a8r8g8b8: format = NV50TCL_RT_FORMAT_A8R8G8B8_UNORM; break;
 	case PICT_x8r8g8b8: format = NV50TCL_RT_FORMAT_X8R8G8B8_UNORM; break;
@@ -502,11 +500,21 @@ NV50EXARenderTarget(PixmapPtr ppix, PicturePtr ppict)
 	    OUT_RELOCl(chan, bo, 0, NOUVEAU_BO_VRAM | NOUVEAU_BO_WR))
 		return FALSE;
 	OUT_RING  (chan, format);
-	OUT_RING  (chan, bo->tile_mode << 4);
-	OUT_RING  (chan, 0x00000000);
-	BEGIN_RING(chan, tesla, NV50TCL_RT_HORIZ(0), 2);
-	OUT_RING  (chan, ppix->drawable.width);
-	OUT_RING  (chan, ppix->drawable.height);
+	if (nv50_style_tiled_pixmap(ppix)) {
+		OUT_RING  (chan, bo->tile_mode << 4);
+		OUT_RING  (chan, 0x00000000);
+		BEGIN_RING(chan, tesla, NV50TCL_RT_HORIZ(0), 2);
+		OUT_RING  (chan, ppix->drawable.width);
+		OUT_RING  (chan, ppix->drawable.height);
+	} else {
+		/* pitch-linear, ie. a scanout buffer */
+		OUT_RING  (chan, 0x00000000);
+		OUT_RING  (chan, 0x00000000);
+		BEGIN_RING(chan, tesla, NV50TCL_RT_HORIZ(0), 2);
+		OUT_RING  (chan, NV50TCL_RT_HORIZ_LINEAR |
+				 (uint32_t)exaGetPixmapPitch(ppix));
+		OUT_RING  (chan, ppix->drawable.height);
+	}
 	BEGIN_RING(chan, tesla, NV50TCL_RT_ARRAY_MODE, 1);
 	OUT_RING  (chan, 0x00000001);
 
@@ -517,7 +525,7 @@ static Bool
 NV50EXACheckTexture(PicturePtr ppict, PicturePtr pdpict, int op)
 {
 	if (!ppict->pDrawable)
-		NOUVEAU_FALLBACK("Solid and gradient pictures unsupported\n");
+		return nouveau_exa_source_pict_check(ppict);
 
 	if (ppict->pDrawable->width > 8192 ||
 	    ppict->pDrawable->height > 8192)
@@ -583,11 +591,7 @@ NV50EXATexture(PixmapPtr ppix, PicturePtr ppict, unsigned unit)
 	NV50EXA_LOCALS(ppix);
 	struct nouveau_bo *bo = nouveau_pixmap_bo(ppix);
 	const unsigned tcb_flags = NOUVEAU_BO_RDWR | NOUVEAU_BO_VRAM;
-	uint32_t mode;
-
-	/*XXX: Scanout buffer not tiled, someone needs to figure it out */
-	if (!nv50_style_tiled_pixmap(ppix))
-		NOUVEAU_FALLBACK("pixmap is scanout buffer\n");
+	uint32_t mode, pitch;
 
 	BEGIN_RING(chan, tesla, NV50TCL_TIC_ADDRESS_HIGH, 3);
 	if (OUT_RELOCh(chan, pNv->tesla_scratch, TIC_OFFSET, tcb_flags) ||
@@ -672,12 +676,21 @@ NV50EXATexture(PixmapPtr ppix, PicturePtr ppict, unsigned unit)
 	}
 #undef _
 
-	mode = 0xd0005000 | (bo->tile_mode << 22);
+	if (nv50_style_tiled_pixmap(ppix)) {
+		mode = 0xd0005000 | (bo->tile_mode << 22);
+		pitch = 0x00300000;
+	} else {
+		/* pitch-linear, ie. a scanout buffer */
+		mode = 0xd0000000 | NV50TIC_0_2_LINEAR |
+		       NV50TIC_0_2_TARGET_RECT;
+		pitch = exaGetPixmapPitch(ppix);
+	}
+
 	if (OUT_RELOCl(chan, bo, 0, NOUVEAU_BO_VRAM | NOUVEAU_BO_RD) ||
 	    OUT_RELOCd(chan, bo, 0, NOUVEAU_BO_VRAM | NOUVEAU_BO_RD |
 		       NOUVEAU_BO_HIGH | NOUVEAU_BO_OR, mode, mode))
 		return FALSE;
-	OUT_RING  (chan, 0x00300000);
+	OUT_RING  (chan, pitch);
 	OUT_RING  (chan, ppix->drawable.width);
 	OUT_RING  (chan, (1 << NV50TIC_0_5_DEPTH_SHIFT) | ppix->drawable.height);
 	OUT_RING  (chan, 0x03000000);
@@ -739,6 +752,116 @@ NV50EXATexture(PixmapPtr ppix, PicturePtr ppict, unsigned unit)
 	state->unit[unit].width = ppix->drawable.width;
 	state->unit[unit].height = ppix->drawable.height;
 	state->unit[unit].transform = ppict->transform;
+	state->unit[unit].source = FALSE;
+	return TRUE;
+}
+
+static Bool
+NV50EXASourcePict(PixmapPtr pdpix, PicturePtr ppict, unsigned unit)
+{
+	NV50EXA_LOCALS(pdpix);
+	const unsigned tcb_flags = NOUVEAU_BO_RDWR | NOUVEAU_BO_VRAM;
+	const unsigned offset = PICT_OFFSET + unit * PICT_SIZE;
+	uint32_t ramp[NOUVEAU_SOURCE_RAMP_SIZE];
+	uint32_t mode;
+	int size;
+
+	size = nouveau_exa_source_pict_ramp(ppict, ramp);
+
+	BEGIN_RING(chan, tesla, NV50TCL_CB_DEF_ADDRESS_HIGH, 3);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch, offset, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch, offset, tcb_flags))
+		return FALSE;
+	OUT_RING  (chan, (CB_TIC << NV50TCL_CB_DEF_SET_BUFFER_SHIFT) | 0x4000);
+	BEGIN_RING(chan, tesla, NV50TCL_CB_ADDR, 1);
+	OUT_RING  (chan, CB_TIC);
+	BEGIN_RING_NI(chan, tesla, NV50TCL_CB_DATA(0), size);
+	OUT_RINGp (chan, ramp, size);
+
+	BEGIN_RING(chan, tesla, NV50TCL_TIC_ADDRESS_HIGH, 3);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch, TIC_OFFSET, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch, TIC_OFFSET, tcb_flags))
+		return FALSE;
+	OUT_RING  (chan, 0x00000800);
+	BEGIN_RING(chan, tesla, NV50TCL_CB_DEF_ADDRESS_HIGH, 3);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch, TIC_OFFSET, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch, TIC_OFFSET, tcb_flags))
+		return FALSE;
+	OUT_RING  (chan, (CB_TIC << NV50TCL_CB_DEF_SET_BUFFER_SHIFT) | 0x4000);
+	BEGIN_RING(chan, tesla, NV50TCL_CB_ADDR, 1);
+	OUT_RING  (chan, CB_TIC | ((unit * 8) << NV50TCL_CB_ADDR_ID_SHIFT));
+	BEGIN_RING_NI(chan, tesla, NV50TCL_CB_DATA(0), 8);
+	OUT_RING  (chan, NV50TIC_0_0_MAPA_C3 | NV50TIC_0_0_TYPEA_UNORM |
+			 NV50TIC_0_0_MAPB_C0 | NV50TIC_0_0_TYPEB_UNORM |
+			 NV50TIC_0_0_MAPG_C1 | NV50TIC_0_0_TYPEG_UNORM |
+			 NV50TIC_0_0_MAPR_C2 | NV50TIC_0_0_TYPER_UNORM |
+			 NV50TIC_0_0_FMT_8_8_8_8);
+	mode = 0xd0000000 | NV50TIC_0_2_LINEAR | NV50TIC_0_2_TARGET_RECT;
+	if (OUT_RELOCl(chan, pNv->tesla_scratch, offset, NOUVEAU_BO_VRAM |
+		       NOUVEAU_BO_RD) ||
+	    OUT_RELOCd(chan, pNv->tesla_scratch, offset, NOUVEAU_BO_VRAM |
+		       NOUVEAU_BO_RD | NOUVEAU_BO_HIGH | NOUVEAU_BO_OR,
+		       mode, mode))
+		return FALSE;
+	OUT_RING  (chan, PICT_SIZE);
+	OUT_RING  (chan, size);
+	OUT_RING  (chan, (1 << NV50TIC_0_5_DEPTH_SHIFT) | 1);
+	OUT_RING  (chan, 0x03000000);
+	OUT_RING  (chan, 0x00000000);
+
+	BEGIN_RING(chan, tesla, NV50TCL_TSC_ADDRESS_HIGH, 3);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch, TSC_OFFSET, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch, TSC_OFFSET, tcb_flags))
+		return FALSE;
+	OUT_RING  (chan, 0x00000000);
+	BEGIN_RING(chan, tesla, NV50TCL_CB_DEF_ADDRESS_HIGH, 3);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch, TSC_OFFSET, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch, TSC_OFFSET, tcb_flags))
+		return FALSE;
+	OUT_RING  (chan, (CB_TSC << NV50TCL_CB_DEF_SET_BUFFER_SHIFT) | 0x4000);
+	BEGIN_RING(chan, tesla, NV50TCL_CB_ADDR, 1);
+	OUT_RING  (chan, CB_TSC | ((unit * 8) << NV50TCL_CB_ADDR_ID_SHIFT));
+	BEGIN_RING_NI(chan, tesla, NV50TCL_CB_DATA(0), 8);
+	if (size == 1 || (ppict->repeat && ppict->repeatType == RepeatNormal)) {
+		OUT_RING  (chan, NV50TSC_1_0_WRAPS_REPEAT |
+			 NV50TSC_1_0_WRAPT_CLAMP_TO_EDGE |
+			 NV50TSC_1_0_WRAPR_CLAMP_TO_EDGE | 0x00024000);
+	} else
+	if (ppict->repeat && ppict->repeatType == RepeatReflect) {
+		OUT_RING  (chan, NV50TSC_1_0_WRAPS_MIRROR_REPEAT |
+			 NV50TSC_1_0_WRAPT_CLAMP_TO_EDGE |
+			 NV50TSC_1_0_WRAPR_CLAMP_TO_EDGE | 0x00024000);
+	} else {
+		/* RepeatPad, and RepeatNone, whose ramp is padded with
+		 * transparent texels
+		 */
+		OUT_RING  (chan, NV50TSC_1_0_WRAPS_CLAMP_TO_EDGE |
+			 NV50TSC_1_0_WRAPT_CLAMP_TO_EDGE |
+			 NV50TSC_1_0_WRAPR_CLAMP_TO_EDGE | 0x00024000);
+	}
+	OUT_RING  (chan, NV50TSC_1_1_MAGF_LINEAR |
+		 NV50TSC_1_1_MINF_LINEAR |
+		 NV50TSC_1_1_MIPF_NONE);
+	OUT_RING  (chan, 0x00000000);
+	OUT_RING  (chan, 0x00000000);
+	OUT_RING  (chan, 0x00000000);
+	OUT_RING  (chan, 0x00000000);
+	OUT_RING  (chan, 0x00000000);
+	OUT_RING  (chan, 0x00000000);
+
+	/* the ramp and its TIC entry were rewritten in place, don't sample
+	 * what the texture units still have cached from the previous one
+	 */
+	BEGIN_RING(chan, tesla, NV50TCL_TIC_FLUSH, 1);
+	OUT_RING  (chan, 0);
+	BEGIN_RING(chan, tesla, NV50TCL_TEX_CACHE_CTL, 1);
+	OUT_RING  (chan, 0);
+
+	state->unit[unit].width = 1.0;
+	state->unit[unit].height = 1.0;
+	state->unit[unit].transform = ppict->transform;
+	state->unit[unit].source = TRUE;
+	nouveau_exa_source_pict_coeffs(ppict, state->unit[unit].coeff);
 	return TRUE;
 }
 
@@ -817,6 +940,9 @@ NV50EXACheckComposite(int op,
 			NOUVEAU_FALLBACK("mask picture invalid\n");
 	}
 
+	if (!NVAccelInit3D(xf86Screens[pdpict->pDrawable->pScreen->myNum]))
+		NOUVEAU_FALLBACK("3D engine unavailable\n");
+
 	return TRUE;
 }
 
@@ -835,10 +961,16 @@ NV50EXAPrepareComposite(int op,
 			PicturePtr pspict, PicturePtr pmpict, PicturePtr pdpict,
 			PixmapPtr pspix, PixmapPtr pmpix, PixmapPtr pdpix)
 {
-	NV50EXA_LOCALS(pspix);
+	NV50EXA_LOCALS(pdpix);
 	const unsigned shd_flags = NOUVEAU_BO_VRAM | NOUVEAU_BO_RD;
+	unsigned dwords = 128;
 
-	if (MARK_RING (chan, 128, 4 + 2 + 2 * 10))
+	if (!pspict->pDrawable)
+		dwords += NOUVEAU_SOURCE_RAMP_SIZE + 12;
+	if (pmpict && !pmpict->pDrawable)
+		dwords += NOUVEAU_SOURCE_RAMP_SIZE + 12;
+
+	if (MARK_RING (chan, dwords, 4 + 2 + 2 * 12))
 		NOUVEAU_FALLBACK("ring space\n");
 
 	BEGIN_RING(chan, eng2d, 0x0110, 1);
@@ -866,13 +998,15 @@ NV50EXAPrepareComposite(int op,
 		return FALSE;
 	}
 
-	if (!NV50EXATexture(pspix, pspict, 0)) {
+	if (pspict->pDrawable ? !NV50EXATexture(pspix, pspict, 0) :
+				!NV50EXASourcePict(pdpix, pspict, 0)) {
 		MARK_UNDO(chan);
 		NOUVEAU_FALLBACK("src picture invalid\n");
 	}
 
 	if (pmpict) {
-		if (!NV50EXATexture(pmpix, pmpict, 1)) {
+		if (pmpict->pDrawable ? !NV50EXATexture(pmpix, pmpict, 1) :
+					!NV50EXASourcePict(pdpix, pmpict, 1)) {
 			MARK_UNDO(chan);
 			NOUVEAU_FALLBACK("mask picture invalid\n");
 		}
@@ -942,6 +1076,25 @@ NV50EXATransform(PictTransformPtr t, int x, int y, float sx, float sy,
 	}
 }
 
+static inline void
+NV50EXAUnitTransform(struct nv50_exa_state *state, int unit, int x, int y,
+		     float *x_ret, float *y_ret)
+{
+	if (state->unit[unit].source) {
+		const float *c = state->unit[unit].coeff;
+		float px, py;
+
+		NV50EXATransform(state->unit[unit].transform, x, y, 1.0, 1.0,
+				 &px, &py);
+		*x_ret = c[0] * px + c[1] * py + c[2];
+		*y_ret = 0.5;
+	} else {
+		NV50EXATransform(state->unit[unit].transform, x, y,
+				 state->unit[unit].width,
+				 state->unit[unit].height, x_ret, y_ret);
+	}
+}
+
 void
 NV50EXAComposite(PixmapPtr pdpix, int sx, int sy, int mx, int my,
 		 int dx, int dy, int w, int h)
@@ -956,28 +1109,16 @@ NV50EXAComposite(PixmapPtr pdpix, int sx, int sy, int mx, int my,
 	BEGIN_RING(chan, tesla, NV50TCL_VERTEX_BEGIN, 1);
 	OUT_RING  (chan, NV50TCL_VERTEX_BEGIN_TRIANGLES);
 
-	NV50EXATransform(state->unit[0].transform, sx, sy + (h * 2),
-			 state->unit[0].width, state->unit[0].height,
-			 &sX0, &sY0);
-	NV50EXATransform(state->unit[0].transform, sx, sy,
-			 state->unit[0].width, state->unit[0].height,
-			 &sX1, &sY1);
-	NV50EXATransform(state->unit[0].transform, sx + (w * 2), sy,
-			 state->unit[0].width, state->unit[0].height,
-			 &sX2, &sY2);
+	NV50EXAUnitTransform(state, 0, sx, sy + (h * 2), &sX0, &sY0);
+	NV50EXAUnitTransform(state, 0, sx, sy, &sX1, &sY1);
+	NV50EXAUnitTransform(state, 0, sx + (w * 2), sy, &sX2, &sY2);
 
 	if (state->have_mask) {
 		float mX0, mX1, mX2, mY0, mY1, mY2;
 
-		NV50EXATransform(state->unit[1].transform, mx, my + (h * 2),
-				 state->unit[1].width, state->unit[1].height,
-				 &mX0, &mY0);
-		NV50EXATransform(state->unit[1].transform, mx, my,
-				 state->unit[1].width, state->unit[1].height,
-				 &mX1, &mY1);
-		NV50EXATransform(state->unit[1].transform, mx + (w * 2), my,
-				 state->unit[1].width, state->unit[1].height,
-				 &mX2, &mY2);
+		NV50EXAUnitTransform(state, 1, mx, my + (h * 2), &mX0, &mY0);
+		NV50EXAUnitTransform(state, 1, mx, my, &mX1, &mY1);
+		NV50EXAUnitTransform(state, 1, mx + (w * 2), my, &mX2, &mY2);
 
 		VTX2s(pNv, sX0, sY0, mX0, mY0, dx, dy + (h * 2));
 		VTX2s(pNv, sX1, sY1, mX1, mY1, dx, dy);
@@ -90,8 +90,15 @@
 #define NV50TIC_0_1_OFFSET_LOW_SHIFT                                       0
 
 #define NV50TIC_0_2_UNKNOWN_MASK                                  0xffffffff
+#define NV50TIC_0_2_TARGET_MASK                                   0x0003c000
+#define NV50TIC_0_2_TARGET_2D                                     0x00004000
+#define NV50TIC_0_2_TARGET_RECT                                   0x0001c000
+#define NV50TIC_0_2_LINEAR                                        0x00040000
+#define NV50TIC_0_2_NO_BORDER                                     0x40000000
+#define NV50TIC_0_2_NORMALIZED_COORDS                             0x80000000
 
 #define NV50TIC_0_3_UNKNOWN_MASK                                  0xffffffff
+#define NV50TIC_0_3_PITCH_MASK                                    0xffffffff
 
 #define NV50TIC_0_4_WIDTH_MASK                                    0x0000ffff
 #define NV50TIC_0_4_WIDTH_SHIFT                                            0
@@ -36,7 +36,7 @@
 #include "nv50_accel.h"
 #include "nv50_texture.h"
 
-extern Atom xvSyncToVBlank, xvSetDefaults;
+extern Atom xvSyncToVBlank, xvSetDefaults, xvDeinterlace;
 extern Atom xvBrightness, xvContrast, xvHue, xvSaturation;
 extern Atom xvITURBT709;
 
@@ -115,7 +115,7 @@ nv50_xv_state_emit(PixmapPtr ppix, int id, struct nouveau_bo *src,
 	BEGIN_RING(chan, tesla, NV50TCL_CB_ADDR, 1);
 	OUT_RING  (chan, CB_TIC);
 	BEGIN_RING_NI(chan, tesla, NV50TCL_CB_DATA(0), 16);
-	if (id == FOURCC_YV12 || id == FOURCC_I420) {
+	if (id == FOURCC_YV12 || id == FOURCC_I420 || id == FOURCC_NV12) {
 	OUT_RING  (chan, NV50TIC_0_0_MAPA_C0 | NV50TIC_0_0_TYPEA_UNORM |
 			 NV50TIC_0_0_MAPB_ZERO | NV50TIC_0_0_TYPEB_UNORM |
 			 NV50TIC_0_0_MAPG_ZERO | NV50TIC_0_0_TYPEG_UNORM |
@@ -267,6 +267,27 @@ nv50_xv_state_emit(PixmapPtr ppix, int id, struct nouveau_bo *src,
 	return TRUE;
 }
 
+/* Starts the batch of clip box quads, scissored to their extents. */
+static void
+nv50_xv_draw_begin(NVPtr pNv, BoxPtr extents)
+{
+	struct nouveau_channel *chan = pNv->chan;
+	struct nouveau_grobj *tesla = pNv->Nv3D;
+
+	/* NV50TCL_SCISSOR_VERT_T_SHIFT is wrong, because it was deducted with
+	* origin lying at the bottom left. This will be changed to _MIN_ and _MAX_
+	* later, because it is origin dependent.
+	*/
+	BEGIN_RING(chan, tesla, NV50TCL_SCISSOR_HORIZ(0), 2);
+	OUT_RING  (chan, extents->x2 << NV50TCL_SCISSOR_HORIZ_MAX_SHIFT |
+			 extents->x1);
+	OUT_RING  (chan, extents->y2 << NV50TCL_SCISSOR_VERT_MAX_SHIFT |
+			 extents->y1);
+
+	BEGIN_RING(chan, tesla, NV50TCL_VERTEX_BEGIN, 1);
+	OUT_RING  (chan, NV50TCL_VERTEX_BEGIN_QUADS);
+}
+
 int
 nv50_xv_image_put(ScrnInfoPtr pScrn,
 		  struct nouveau_bo *src, int packed_y, int uv,
@@ -281,12 +302,14 @@ nv50_xv_image_put(ScrnInfoPtr pScrn,
 	NVPtr pNv = NVPTR(pScrn);
 	struct nouveau_channel *chan = pNv->chan;
 	struct nouveau_grobj *tesla = pNv->Nv3D;
-	float X1, X2, Y1, Y2;
-	BoxPtr pbox;
+	float X1, Y1, sx, sy;
+	BoxPtr pbox, extents;
 	int nbox;
 
 	if (!nv50_xv_check_image_put(ppix))
 		return BadMatch;
+	if (pPriv->csc_dirty && !nv50_xv_csc_update(pScrn, pPriv))
+		return BadAlloc;
 	if (!nv50_xv_state_emit(ppix, id, src, packed_y, uv, width, height))
 		return BadAlloc;
 
@@ -297,51 +320,49 @@ nv50_xv_image_put(ScrnInfoPtr pScrn,
 	/* These are fixed point values in the 16.16 format. */
 	X1 = (float)(x1>>16)+(float)(x1&0xFFFF)/(float)0x10000;
 	Y1 = (float)(y1>>16)+(float)(y1&0xFFFF)/(float)0x10000;
-	X2 = (float)(x2>>16)+(float)(x2&0xFFFF)/(float)0x10000;
-	Y2 = (float)(y2>>16)+(float)(y2&0xFFFF)/(float)0x10000;
+
+	/* The texture coordinates are linear in the destination position,
+	 * work out the mapping once instead of per box.
+	 */
+	sx = (float)src_w / ((float)drw_w * width);
+	sy = (float)src_h / ((float)drw_h * height);
+	X1 = X1 / width - dstBox->x1 * sx;
+	Y1 = Y1 / height - dstBox->y1 * sy;
+
+	/* All the clip boxes go out as quads in a single primitive, the
+	 * state is only emitted again if the ring fills up.
+	 */
+	extents = REGION_EXTENTS(pScrn->pScreen, clipBoxes);
+	nv50_xv_draw_begin(pNv, extents);
 
 	pbox = REGION_RECTS(clipBoxes);
 	nbox = REGION_NUM_RECTS(clipBoxes);
 	while(nbox--) {
-		float tx1=X1+(float)(pbox->x1 - dstBox->x1)*(X2-X1)/(float)(drw_w);
-		float tx2=X1+(float)(pbox->x2 - dstBox->x1)*(src_w)/(float)(drw_w);
-		float ty1=Y1+(float)(pbox->y1 - dstBox->y1)*(Y2-Y1)/(float)(drw_h);
-		float ty2=Y1+(float)(pbox->y2 - dstBox->y1)*(src_h)/(float)(drw_h);
-		int sx1=pbox->x1;
-		int sx2=pbox->x2;
-		int sy1=pbox->y1;
-		int sy2=pbox->y2;
-
-		tx1 = tx1 / width;
-		tx2 = tx2 / width;
-		ty1 = ty1 / height;
-		ty2 = ty2 / height;
-
-		if (AVAIL_RING(chan) < 64) {
+		float tx1 = X1 + pbox->x1 * sx;
+		float tx2 = X1 + pbox->x2 * sx;
+		float ty1 = Y1 + pbox->y1 * sy;
+		float ty2 = Y1 + pbox->y2 * sy;
+
+		if (AVAIL_RING(chan) < 32) {
+			BEGIN_RING(chan, tesla, NV50TCL_VERTEX_END, 1);
+			OUT_RING  (chan, 0);
 			if (!nv50_xv_state_emit(ppix, id, src, packed_y, uv,
 						width, height))
 				return BadAlloc;
+			nv50_xv_draw_begin(pNv, extents);
 		}
 
-		/* NV50TCL_SCISSOR_VERT_T_SHIFT is wrong, because it was deducted with
-		* origin lying at the bottom left. This will be changed to _MIN_ and _MAX_
-		* later, because it is origin dependent.
-		*/
-		BEGIN_RING(chan, tesla, NV50TCL_SCISSOR_HORIZ(0), 2);
-		OUT_RING  (chan, sx2 << NV50TCL_SCISSOR_HORIZ_MAX_SHIFT | sx1);
-		OUT_RING  (chan, sy2 << NV50TCL_SCISSOR_VERT_MAX_SHIFT | sy1 );
-
-		BEGIN_RING(chan, tesla, NV50TCL_VERTEX_BEGIN, 1);
-		OUT_RING  (chan, NV50TCL_VERTEX_BEGIN_TRIANGLES);
-		VTX2s(pNv, tx1, ty1, tx1, ty1, sx1, sy1);
-		VTX2s(pNv, tx2+(tx2-tx1), ty1, tx2+(tx2-tx1), ty1, sx2+(sx2-sx1), sy1);
-		VTX2s(pNv, tx1, ty2+(ty2-ty1), tx1, ty2+(ty2-ty1), sx1, sy2+(sy2-sy1));
-		BEGIN_RING(chan, tesla, NV50TCL_VERTEX_END, 1);
-		OUT_RING  (chan, 0);
+		VTX2s(pNv, tx1, ty1, tx1, ty1, pbox->x1, pbox->y1);
+		VTX2s(pNv, tx2, ty1, tx2, ty1, pbox->x2, pbox->y1);
+		VTX2s(pNv, tx2, ty2, tx2, ty2, pbox->x2, pbox->y2);
+		VTX2s(pNv, tx1, ty2, tx1, ty2, pbox->x1, pbox->y2);
 
 		pbox++;
 	}
 
+	BEGIN_RING(chan, tesla, NV50TCL_VERTEX_END, 1);
+	OUT_RING  (chan, 0);
+
 	FIRE_RING (chan);
 	return Success;
 }
@@ -349,6 +370,9 @@ nv50_xv_image_put(ScrnInfoPtr pScrn,
 void
 nv50_xv_video_stop(ScrnInfoPtr pScrn, pointer data, Bool exit)
 {
+	nouveau_xv_present_cancel(data);
+	if (exit)
+		NVFreePortMemory(pScrn, data);
 }
 
 /* Reference color space transform data */
@@ -370,7 +394,7 @@ struct REF_TRANSFORM {
 #define RTFContrast(a)   (1.0 + ((a)*1.0)/1000.0)
 #define RTFHue(a)   (((a)*3.1416)/1000.0)
 
-void
+Bool
 nv50_xv_csc_update(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv)
 {
 	NVPtr pNv = NVPTR(pScrn);
@@ -400,12 +424,14 @@ nv50_xv_csc_update(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv)
 	off[2] = Loff * yco + Coff * (uco[2] + vco[2]) + bright;
 
 	if (pNv->Architecture >= NV_ARCH_C0) {
-		nvc0_xv_csc_update(pNv, yco, off, uco, vco);
-		return;
+		if (!nvc0_xv_csc_update(pNv, yco, off, uco, vco))
+			return FALSE;
+		pPriv->csc_dirty = FALSE;
+		return TRUE;
 	}
 
 	if (MARK_RING(chan, 64, 2))
-		return;
+		return FALSE;
 
 	BEGIN_RING(chan, tesla, NV50TCL_CB_DEF_ADDRESS_HIGH, 3);
 	if (OUT_RELOCh(chan, pNv->tesla_scratch, PFP_DATA,
@@ -413,7 +439,7 @@ nv50_xv_csc_update(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv)
 	    OUT_RELOCl(chan, pNv->tesla_scratch, PFP_DATA,
 		       NOUVEAU_BO_VRAM | NOUVEAU_BO_WR)) {
 		MARK_UNDO(chan);
-		return;
+		return FALSE;
 	}
 	OUT_RING  (chan, (CB_PFP << NV50TCL_CB_DEF_SET_BUFFER_SHIFT) | 0x4000);
 	BEGIN_RING(chan, tesla, NV50TCL_CB_ADDR, 1);
@@ -429,6 +455,9 @@ nv50_xv_csc_update(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv)
 	OUT_RINGf (chan, vco[0]);
 	OUT_RINGf (chan, vco[1]);
 	OUT_RINGf (chan, vco[2]);
+
+	pPriv->csc_dirty = FALSE;
+	return TRUE;
 }
 
 void
@@ -440,11 +469,13 @@ nv50_xv_set_port_defaults(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv)
 	pPriv->texture		= TRUE;
 	pPriv->doubleBuffer	= FALSE;
 	pPriv->SyncToVBlank	= TRUE;
+	pPriv->deinterlace	= NV_DEINTERLACE_WEAVE;
 	pPriv->brightness	= 0;
 	pPriv->contrast		= 0;
 	pPriv->saturation	= 0;
 	pPriv->hue		= 0;
 	pPriv->iturbt_709	= 0;
+	pPriv->csc_dirty	= TRUE;
 }
 
 int
@@ -458,6 +489,12 @@ nv50_xv_port_attribute_set(ScrnInfoPtr pScrn, Atom attribute,
 			return BadValue;
 		pPriv->SyncToVBlank = value;
 	} else
+	if (attribute == xvDeinterlace) {
+		if (value < NV_DEINTERLACE_WEAVE ||
+		    value > NV_DEINTERLACE_BOTTOM)
+			return BadValue;
+		pPriv->deinterlace = value;
+	} else
 	if (attribute == xvBrightness) {
 		if (value < -1000 || value > 1000)
 			return BadValue;
@@ -488,7 +525,8 @@ nv50_xv_port_attribute_set(ScrnInfoPtr pScrn, Atom attribute,
 	} else
 		return BadMatch;
 
-	nv50_xv_csc_update(pScrn, pPriv);
+	/* the 3D engine may not be up yet, upload with the next frame */
+	pPriv->csc_dirty = TRUE;
 	return Success;
 }
 
@@ -501,6 +539,9 @@ nv50_xv_port_attribute_get(ScrnInfoPtr pScrn, Atom attribute,
 	if (attribute == xvSyncToVBlank)
 		*value = (pPriv->SyncToVBlank) ? 1 : 0;
 	else
+	if (attribute == xvDeinterlace)
+		*value = pPriv->deinterlace;
+	else
 	if (attribute == xvBrightness)
 		*value = pPriv->brightness;
 	else
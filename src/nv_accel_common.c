@@ -20,6 +20,8 @@
  * SOFTWARE.
  */
 
+#include <sys/time.h>
+
 #include "nv_include.h"
 #include "nv04_pushbuf.h"
 
@@ -122,6 +124,37 @@ nouveau_allocate_surface(ScrnInfoPtr scrn, int width, int height, int bpp,
 	return TRUE;
 }
 
+/* libdrm keeps a buffer's CPU mapping around for the buffer's whole
+ * lifetime, what nouveau_bo_map() costs on each call is waiting for the
+ * GPU to be done with it.  Callers that know the GPU can't be touching a
+ * buffer (freshly allocated, only ever scanned out, or no acceleration)
+ * pass NOUVEAU_BO_NOSYNC to just get the pointer.
+ */
+int
+nv_bo_map(NVPtr pNv, struct nouveau_bo *bo, uint32_t access)
+{
+	int ret;
+
+	if (access & NOUVEAU_BO_NOSYNC)
+		pNv->bo_map_nosync++;
+	else
+		pNv->bo_map_sync++;
+
+	ret = nouveau_bo_map(bo, access);
+	if (ret == 0)
+		pNv->bo_mapped++;
+	return ret;
+}
+
+/* Unmapping a buffer whose map failed is harmless, it just isn't counted */
+void
+nv_bo_unmap(NVPtr pNv, struct nouveau_bo *bo)
+{
+	if (bo->map)
+		pNv->bo_mapped--;
+	nouveau_bo_unmap(bo);
+}
+
 void
 NV11SyncToVBlank(PixmapPtr ppix, BoxPtr box)
 {
@@ -137,6 +170,8 @@ NV11SyncToVBlank(PixmapPtr ppix, BoxPtr box)
 	crtcs = nv_window_belongs_to_crtc(pScrn, box->x1, box->y1,
 					  box->x2 - box->x1,
 					  box->y2 - box->y1);
+	/* nothing to wait for where TearFree flips whole frames */
+	crtcs &= ~drmmode_tearfree_crtcs(pScrn);
 	if (!crtcs)
 		return;
 
@@ -616,10 +651,20 @@ NVAccelInit2D_NV50(ScrnInfoPtr pScrn)
 	}                                                                     \
 } while(0)
 
+static unsigned long
+NVAccelTimeUsec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000UL + tv.tv_usec;
+}
+
 Bool
 NVAccelCommonInit(ScrnInfoPtr pScrn)
 {
 	NVPtr pNv = NVPTR(pScrn);
+	unsigned long start = NVAccelTimeUsec();
 	Bool ret;
 
 	if (pNv->NoAccel)
@@ -653,29 +698,71 @@ NVAccelCommonInit(ScrnInfoPtr pScrn)
 	else
 		INIT_CONTEXT_OBJECT(M2MF_NVC0);
 
-	/* 3D init */
+	/* The 3D engine is brought up by NVAccelInit3D() the first time
+	 * something needs it, its state and shader uploads are a large part
+	 * of the startup cost.
+	 */
+	pNv->accel_3d_init = FALSE;
+
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		   "2D acceleration initialised in %lu us\n",
+		   NVAccelTimeUsec() - start);
+	return TRUE;
+}
+
+Bool
+NVAccelInit3D(ScrnInfoPtr pScrn)
+{
+	NVPtr pNv = NVPTR(pScrn);
+	unsigned long start;
+	Bool ret;
+
+	if (pNv->NoAccel)
+		return FALSE;
+
+	/* only ever try once, a failure here means software fallbacks */
+	if (pNv->accel_3d_init)
+		return pNv->Nv3D != NULL;
+	pNv->accel_3d_init = TRUE;
+	start = NVAccelTimeUsec();
+
 	switch (pNv->Architecture) {
 	case NV_ARCH_C0:
-		INIT_CONTEXT_OBJECT(3D_NVC0);
+		ret = NVAccelInit3D_NVC0(pScrn);
 		break;
 	case NV_ARCH_50:
-		INIT_CONTEXT_OBJECT(NV50TCL);
+		ret = NVAccelInitNV50TCL(pScrn);
 		break;
 	case NV_ARCH_40:
-		INIT_CONTEXT_OBJECT(NV40TCL);
+		ret = NVAccelInitNV40TCL(pScrn);
 		break;
 	case NV_ARCH_30:
-		INIT_CONTEXT_OBJECT(NV30TCL);
+		ret = NVAccelInitNV30TCL(pScrn);
 		break;
 	case NV_ARCH_20:
 	case NV_ARCH_10:
-		INIT_CONTEXT_OBJECT(NV10TCL);
+		ret = NVAccelInitNV10TCL(pScrn);
 		break;
 	default:
-		break;
+		return FALSE;
 	}
 
-	return TRUE;
+	/* don't leave a half set up object behind for the 3D paths to use */
+	if (!ret) {
+		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+			   "Failed to initialise 3D acceleration\n");
+		nouveau_grobj_free(&pNv->Nv3D);
+		nouveau_grobj_free(&pNv->NvSW);
+		nouveau_notifier_free(&pNv->vblank_sem);
+		nouveau_bo_ref(NULL, &pNv->tesla_scratch);
+		nouveau_bo_ref(NULL, &pNv->shader_mem);
+		return FALSE;
+	}
+
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		   "3D acceleration initialised in %lu us\n",
+		   NVAccelTimeUsec() - start);
+	return pNv->Nv3D != NULL;
 }
 
 void NVAccelFree(ScrnInfoPtr pScrn)
@@ -705,4 +792,5 @@ void NVAccelFree(ScrnInfoPtr pScrn)
 
 	nouveau_bo_ref(NULL, &pNv->tesla_scratch);
 	nouveau_bo_ref(NULL, &pNv->shader_mem);
+	pNv->accel_3d_init = FALSE;
 }
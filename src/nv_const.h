@@ -15,6 +15,10 @@ typedef enum {
     OPTION_GLX_VBLANK,
     OPTION_ZAPHOD_HEADS,
     OPTION_PAGE_FLIP,
+    OPTION_SWAP_LIMIT,
+    OPTION_TEAR_FREE,
+    OPTION_XV_THREADS,
+    OPTION_XV_THREAD_PIXELS,
 } NVOpts;
 
 
@@ -28,6 +32,10 @@ static const OptionInfoRec NVOptions[] = {
     { OPTION_GLX_VBLANK,	"GLXVBlank",	OPTV_BOOLEAN,	{0}, FALSE },
     { OPTION_ZAPHOD_HEADS,	"ZaphodHeads",	OPTV_STRING,	{0}, FALSE },
     { OPTION_PAGE_FLIP,		"PageFlip",	OPTV_BOOLEAN,	{0}, FALSE },
+    { OPTION_SWAP_LIMIT,	"SwapLimit",	OPTV_INTEGER,	{0}, FALSE },
+    { OPTION_TEAR_FREE,		"TearFree",	OPTV_BOOLEAN,	{0}, FALSE },
+    { OPTION_XV_THREADS,	"XvThreads",	OPTV_INTEGER,	{0}, FALSE },
+    { OPTION_XV_THREAD_PIXELS,	"XvThreadPixels", OPTV_INTEGER,	{0}, FALSE },
     { -1,                       NULL,           OPTV_NONE,      {0}, FALSE }
 };
 
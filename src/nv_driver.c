@@ -391,8 +391,10 @@ NVBlockHandler (
 	(*pScreen->BlockHandler) (i, blockData, pTimeout, pReadmask);
 	pScreen->BlockHandler = NVBlockHandler;
 
-	if (pScrn->vtSema && !pNv->NoAccel)
+	if (pScrn->vtSema && !pNv->NoAccel) {
+		drmmode_tearfree_update(pScrn);
 		FIRE_RING (pNv->chan);
+	}
 
 	if (pNv->VideoTimerCallback) 
 		(*pNv->VideoTimerCallback)(pScrn, currentTime.milliseconds);
@@ -410,15 +412,17 @@ NVCreateScreenResources(ScreenPtr pScreen)
 		return FALSE;
 	pScreen->CreateScreenResources = NVCreateScreenResources;
 
-	drmmode_fbcon_copy(pScreen);
-	if (!NVEnterVT(pScrn->scrnIndex, 0))
-		return FALSE;
-
 	if (!pNv->NoAccel) {
 		ppix = pScreen->GetScreenPixmap(pScreen);
 		nouveau_bo_ref(pNv->scanout, &nouveau_pixmap(ppix)->bo);
 	}
 
+	drmmode_fbcon_copy(pScreen);
+	if (!drmmode_tearfree_init(pScreen))
+		return FALSE;
+	if (!NVEnterVT(pScrn->scrnIndex, 0))
+		return FALSE;
+
 	return TRUE;
 }
 
@@ -446,6 +450,15 @@ NVCloseScreen(int scrnIndex, ScreenPtr pScreen)
 		pScrn->vtSema = FALSE;
 	}
 
+	if (!pNv->NoAccel)
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+			   "Buffer CPU maps: %lu synchronous, %lu unsynchronised\n",
+			   pNv->bo_map_sync, pNv->bo_map_nosync);
+	if (pNv->bo_mapped)
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			   "%lu buffers still mapped at close\n",
+			   pNv->bo_mapped);
+
 	NVAccelFree(pScrn);
 	NVTakedownVideo(pScrn);
 	NVTakedownDma(pScrn);
@@ -600,6 +613,7 @@ NVPreInit(ScrnInfoPtr pScrn, int flags)
 	NVPtr pNv;
 	MessageType from;
 	const char *reason;
+	Bool kernel_flip = FALSE;
 	uint64_t v;
 	int ret;
 
@@ -821,6 +835,7 @@ NVPreInit(ScrnInfoPtr pScrn, int flags)
 	ret = nouveau_device_get_param(pNv->dev,
 				       NOUVEAU_GETPARAM_HAS_PAGEFLIP, &v);
 	if (ret == 0 && v == 1) {
+		kernel_flip = TRUE;
 		pNv->has_pageflip = TRUE;
 		if (xf86GetOptValBool(pNv->Options, OPTION_PAGE_FLIP, &pNv->has_pageflip))
 			from = X_CONFIG;
@@ -830,8 +845,88 @@ NVPreInit(ScrnInfoPtr pScrn, int flags)
 	reason = ": not available at build time";
 #endif
 
+	if (xf86ReturnOptValBool(pNv->Options, OPTION_TEAR_FREE, FALSE)) {
+		if (kernel_flip && !pNv->NoAccel) {
+			/* the CRTCs own the scanout, DRI2 can't flip it */
+			pNv->tear_free = TRUE;
+			pNv->has_pageflip = FALSE;
+			from = X_CONFIG;
+			reason = ": TearFree";
+		} else {
+			xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+				   "TearFree needs page flipping and "
+				   "acceleration, disabled\n");
+		}
+	}
+
 	xf86DrvMsg(pScrn->scrnIndex, from, "Page flipping %sabled%s\n",
 		   pNv->has_pageflip ? "en" : "dis", reason);
+	if (pNv->tear_free)
+		xf86DrvMsg(pScrn->scrnIndex, X_CONFIG, "TearFree enabled\n");
+
+#ifdef DRM_CAP_ASYNC_PAGE_FLIP
+	if (pNv->has_pageflip) {
+		uint64_t cap = 0;
+
+		ret = drmGetCap(nouveau_device(pNv->dev)->fd,
+				DRM_CAP_ASYNC_PAGE_FLIP, &cap);
+		pNv->has_async_flip = (ret == 0 && cap);
+	}
+#endif
+	if (pNv->has_async_flip)
+		xf86DrvMsg(pScrn->scrnIndex, X_PROBED,
+			   "Asynchronous page flips supported\n");
+
+#if defined(DRM_CAP_TIMESTAMP_MONOTONIC) && defined(HAVE_CLOCK_GETTIME)
+	{
+		uint64_t cap = 0;
+
+		ret = drmGetCap(nouveau_device(pNv->dev)->fd,
+				DRM_CAP_TIMESTAMP_MONOTONIC, &cap);
+		pNv->has_monotonic_ust = (ret == 0 && cap);
+	}
+#endif
+
+	from = X_DEFAULT;
+	pNv->swap_limit = 2;
+	if (xf86GetOptValInteger(pNv->Options, OPTION_SWAP_LIMIT,
+				 &pNv->swap_limit)) {
+		from = X_CONFIG;
+		if (pNv->swap_limit < 1 || pNv->swap_limit > 3) {
+			xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+				   "SwapLimit must be 1, 2 or 3, using 2\n");
+			from = X_DEFAULT;
+			pNv->swap_limit = 2;
+		}
+	}
+
+	xf86DrvMsg(pScrn->scrnIndex, from, "Swap limit: %d frame%s\n",
+		   pNv->swap_limit, pNv->swap_limit > 1 ? "s" : "");
+
+#ifdef HAVE_PTHREAD
+	from = X_DEFAULT;
+	pNv->xv_threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	if (pNv->xv_threads > 3)
+		pNv->xv_threads = 3;
+	if (xf86GetOptValInteger(pNv->Options, OPTION_XV_THREADS,
+				 &pNv->xv_threads))
+		from = X_CONFIG;
+	if (pNv->xv_threads < 0)
+		pNv->xv_threads = 0;
+	if (pNv->xv_threads > NOUVEAU_XV_MAX_THREADS)
+		pNv->xv_threads = NOUVEAU_XV_MAX_THREADS;
+
+	pNv->xv_thread_pixels = 1920 * 1080;
+	xf86GetOptValInteger(pNv->Options, OPTION_XV_THREAD_PIXELS,
+			     &pNv->xv_thread_pixels);
+
+	if (pNv->xv_threads) {
+		xf86DrvMsg(pScrn->scrnIndex, from, "Xv copies of more than "
+			   "%d pixels split over %d extra thread%s\n",
+			   pNv->xv_thread_pixels, pNv->xv_threads,
+			   pNv->xv_threads > 1 ? "s" : "");
+	}
+#endif
 
 	if(xf86GetOptValInteger(pNv->Options, OPTION_VIDEO_KEY, &(pNv->videoKey))) {
 		xf86DrvMsg(pScrn->scrnIndex, X_CONFIG, "video key set to 0x%x\n",
@@ -1095,9 +1190,10 @@ NVScreenInit(int scrnIndex, ScreenPtr pScreen, int argc, char **argv)
 	if (pNv->NoAccel) {
 		pNv->ShadowPtr = NULL;
 		displayWidth = pScrn->displayWidth;
-		nouveau_bo_map(pNv->scanout, NOUVEAU_BO_RDWR);
+		nv_bo_map(pNv, pNv->scanout,
+			  NOUVEAU_BO_RDWR | NOUVEAU_BO_NOSYNC);
 		FBStart = pNv->scanout->map;
-		nouveau_bo_unmap(pNv->scanout);
+		nv_bo_unmap(pNv, pNv->scanout);
 	} else {
 		pNv->ShadowPtr = NULL;
 		displayWidth = pScrn->displayWidth;
@@ -5,14 +5,21 @@
 Bool drmmode_pre_init(ScrnInfoPtr pScrn, int fd, int cpp);
 void drmmode_adjust_frame(ScrnInfoPtr pScrn, int x, int y, int flags);
 void drmmode_remove_fb(ScrnInfoPtr pScrn);
+void drmmode_fb_release(ScrnInfoPtr pScrn, struct nouveau_bo *bo);
 Bool drmmode_cursor_init(ScreenPtr pScreen);
 void drmmode_fbcon_copy(ScreenPtr pScreen);
-Bool drmmode_page_flip(DrawablePtr draw, PixmapPtr back, void *priv);
+int drmmode_page_flip(DrawablePtr draw, PixmapPtr back, void *priv,
+		      Bool async);
+void drmmode_flip_complete(ScrnInfoPtr pScrn);
 void drmmode_screen_init(ScreenPtr pScreen);
+Bool drmmode_tearfree_init(ScreenPtr pScreen);
+void drmmode_tearfree_update(ScrnInfoPtr pScrn);
+unsigned int drmmode_tearfree_crtcs(ScrnInfoPtr pScrn);
 void drmmode_screen_fini(ScreenPtr pScreen);
 
 /* in nv_accel_common.c */
 Bool NVAccelCommonInit(ScrnInfoPtr pScrn);
+Bool NVAccelInit3D(ScrnInfoPtr pScrn);
 Bool NVAccelGetCtxSurf2DFormatFromPixmap(PixmapPtr pPix, int *fmt_ret);
 Bool NVAccelGetCtxSurf2DFormatFromPicture(PicturePtr pPix, int *fmt_ret);
 PixmapPtr NVGetDrawablePixmap(DrawablePtr pDraw);
@@ -21,18 +28,30 @@ void NV11SyncToVBlank(PixmapPtr ppix, BoxPtr box);
 Bool nouveau_allocate_surface(ScrnInfoPtr scrn, int width, int height,
 			      int bpp, int usage_hint, int *pitch,
 			      struct nouveau_bo **bo);
+int nv_bo_map(NVPtr pNv, struct nouveau_bo *bo, uint32_t access);
+void nv_bo_unmap(NVPtr pNv, struct nouveau_bo *bo);
 
 /* in nouveau_dri2.c */
 void nouveau_dri2_vblank_handler(int fd, unsigned int frame,
 				 unsigned int tv_sec, unsigned int tv_usec,
 				 void *event_data);
+void nouveau_dri2_flip_handler(int fd, unsigned int frame,
+			       unsigned int tv_sec, unsigned int tv_usec,
+			       void *event_data);
 Bool nouveau_dri2_init(ScreenPtr pScreen);
 void nouveau_dri2_fini(ScreenPtr pScreen);
+void nouveau_dri2_vblank_reset(ScrnInfoPtr pScrn);
 
 /* in nouveau_xv.c */
 void NVInitVideo(ScreenPtr);
 void NVTakedownVideo(ScrnInfoPtr);
 void NVSetPortDefaults (ScrnInfoPtr pScrn, NVPortPrivPtr pPriv);
+void NVFreePortMemory(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv);
+int NVXvFilterTable(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv);
+void nouveau_xv_present_cancel(NVPortPrivPtr pPriv);
+void nouveau_xv_present_handler(int fd, unsigned int frame,
+				unsigned int tv_sec, unsigned int tv_usec,
+				void *event_data);
 unsigned int nv_window_belongs_to_crtc(ScrnInfoPtr, int, int, int, int);
 
 /* in nv_dma.c */
@@ -43,6 +62,9 @@ void  NVTakedownDma(ScrnInfoPtr pScrn);
 Bool nouveau_exa_init(ScreenPtr pScreen);
 Bool nouveau_exa_pixmap_is_onscreen(PixmapPtr pPixmap);
 bool nv50_style_tiled_pixmap(PixmapPtr ppix);
+Bool nouveau_exa_source_pict_check(PicturePtr ppict);
+int  nouveau_exa_source_pict_ramp(PicturePtr ppict, uint32_t *ramp);
+void nouveau_exa_source_pict_coeffs(PicturePtr ppict, float *coeff);
 
 /* in nouveau_wfb.c */
 void nouveau_wfb_setup_wrap(ReadMemoryProcPtr *, WriteMemoryProcPtr *,
@@ -183,7 +205,7 @@ void nv50_xv_video_stop(ScrnInfoPtr, pointer, Bool);
 int nv50_xv_port_attribute_set(ScrnInfoPtr, Atom, INT32, pointer);
 int nv50_xv_port_attribute_get(ScrnInfoPtr, Atom, INT32 *, pointer);
 void nv50_xv_set_port_defaults(ScrnInfoPtr, NVPortPrivPtr);
-void nv50_xv_csc_update(ScrnInfoPtr, NVPortPrivPtr);
+Bool nv50_xv_csc_update(ScrnInfoPtr, NVPortPrivPtr);
 
 /* nvc0_xv.c */
 int nvc0_xv_image_put(ScrnInfoPtr, struct nouveau_bo *, int, int, int, int,
@@ -192,7 +214,7 @@ int nvc0_xv_image_put(ScrnInfoPtr, struct nouveau_bo *, int, int, int, int,
 		      RegionPtr, PixmapPtr, NVPortPrivPtr);
 void nvc0_xv_m2mf(struct nouveau_grobj *, struct nouveau_bo *, int, int, int,
 		  struct nouveau_bo *, int);
-void nvc0_xv_csc_update(NVPtr, float, float *, float *, float *);
+Bool nvc0_xv_csc_update(NVPtr, float, float *, float *, float *);
 
 /* To support EXA 2.0, 2.1 has this in the header */
 #ifndef exaMoveInPixmap
@@ -39,7 +39,8 @@ NVRefreshArea(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 	FBPitch = pScrn->displayWidth * cpp;
 	max_height = pNv->scanout->size/FBPitch;
 
-	nouveau_bo_map(pNv->scanout, NOUVEAU_BO_WR);
+	nv_bo_map(pNv, pNv->scanout, NOUVEAU_BO_WR |
+		  (pNv->NoAccel ? NOUVEAU_BO_NOSYNC : 0));
 	while(num--) {
 		x1 = MAX(pbox->x1, 0);
 		y1 = MAX(pbox->y1, 0);
@@ -61,5 +62,5 @@ NVRefreshArea(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 
 		pbox++;
 	}
-	nouveau_bo_unmap(pNv->scanout);
+	nv_bo_unmap(pNv, pNv->scanout);
 } 
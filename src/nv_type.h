@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include "nouveau_device.h"
 #include "xf86Crtc.h"
+#include "nouveau_vblank_model.h"
 #else
 #error "This driver requires a DRI-enabled X server"
 #endif
@@ -28,6 +29,7 @@
 
 /* NV50 */
 typedef struct _NVRec *NVPtr;
+
 typedef struct _NVRec {
     uint32_t              Architecture;
     EntityInfoPtr       pEnt;
@@ -53,6 +55,10 @@ typedef struct _NVRec {
     Bool		tiled_scanout;
     Bool		glx_vblank;
     Bool		has_pageflip;
+    Bool		has_async_flip;
+    Bool		has_monotonic_ust; /* vblank timestamps are CLOCK_MONOTONIC */
+    Bool		tear_free;
+    int			swap_limit;
     ScreenBlockHandlerProcPtr BlockHandler;
     CreateScreenResourcesProcPtr CreateScreenResources;
     CloseScreenProcPtr  CloseScreen;
@@ -72,6 +78,18 @@ typedef struct _NVRec {
     drmVersionPtr       pKernelDRMVersion;
 
 	void *drmmode; /* for KMS */
+	void *dri2_pool; /* released DRI2 buffers kept for reuse */
+	void *xv_pool; /* released Xv buffers kept for reuse */
+	void *xv_workers; /* threads splitting up Xv copies */
+	void *xvmc_adaptors; /* XvMC adaptor list, in use until close */
+	int xv_threads;
+	int xv_thread_pixels;
+	void *flip_pending; /* DRI2 swap whose page flip is in flight */
+	void *flip_queued; /* newest unsynchronised swap waiting on it */
+	void *dri2_throttled; /* DRI2 swaps waiting on the previous frame */
+	OsTimerPtr dri2_throttle;
+	CARD32 dri2_throttle_poll;
+	struct nouveau_vblank_model vblank_model[2];
 
 	/* DRM interface */
 	struct nouveau_device *dev;
@@ -98,6 +116,10 @@ typedef struct _NVRec {
 	struct nouveau_bo *tesla_scratch;
 	struct nouveau_bo *shader_mem;
 	struct nouveau_bo *xv_filtertable_mem;
+	Bool accel_3d_init;
+	unsigned long bo_map_sync;
+	unsigned long bo_map_nosync;
+	unsigned long bo_mapped; /* nv_bo_map() without nv_bo_unmap() yet */
 
 	/* Acceleration context */
 	PixmapPtr pspix, pmpix, pdpix;
@@ -123,21 +145,66 @@ typedef struct _NVPortPrivRec {
 	Bool		doubleBuffer;
 	CARD32		videoStatus;
 	int		currentBuffer;
+	int		overlaySlot[2]; /* ring frame per buffer, -1 if none */
 	Time		videoTime;
 	int		overlayCRTC;
 	Bool		grabbedByV4L;
 	Bool		iturbt_709;
+	Bool		csc_dirty; /* NV50+, upload CSC on next frame */
 	Bool		blitter;
 	Bool		texture;
 	Bool		bicubic; /* only for texture adapter */
 	Bool		SyncToVBlank;
+	int		deinterlace; /* only for texture adapter */
+	int		deint_prev; /* last frame in video_mem, -1 if none */
+	BoxRec		deint_box; /* source area of that frame */
+	int		sharpness; /* only for bicubic texture adapter */
 	struct nouveau_bo *video_mem;
 	int		pitch;
 	int		offset;
 	struct nouveau_bo *TT_mem_chunk[2];
 	int		currentHostBuffer;
+	PixmapPtr	present_pix; /* frame waiting for the next vblank */
+	RegionRec	present_clip;
+	int		present_x, present_y;
+	int		present_crtcs;
+	XID		present_draw;
+	void		*present; /* refcounted, shared with vblank events */
+	Bool		present_pending;
 } NVPortPrivRec, *NVPortPrivPtr;
 
+#define NOUVEAU_XV_MAX_THREADS 8
+
+/* XV_DEINTERLACE values */
+#define NV_DEINTERLACE_WEAVE	0 /* frame shown as is */
+#define NV_DEINTERLACE_TOP	1 /* top field, line doubled ("bob") */
+#define NV_DEINTERLACE_BOTTOM	2 /* bottom field, line doubled */
+/* NV40 texture adapter only: the field's lines are kept, the other field's are
+ * weaved where the picture is still and bobbed where it moves.
+ */
+#define NV_DEINTERLACE_ADAPTIVE_TOP	3
+#define NV_DEINTERLACE_ADAPTIVE_BOTTOM	4
+
+/* XV_FILTER_SHARPNESS of the NV30/NV40 bicubic adapter, walks the C=0
+ * cubics from the B-spline (0) to the cubic Hermite (4).  Kernels with
+ * negative lobes can't be done with two linear fetches per axis.
+ */
+#define NV_FILTER_SHARPNESS_MAX	4
+#define NV_FILTER_SHARPNESS_DEFAULT 1 /* B=0.75 */
+
+/* entries per weight table, 4 signed bytes each */
+#define NV_FILTER_TABLE_SIZE	512
+
+/* Xv vblank events carry the port, tagged to tell them apart from DRI2's */
+#define NOUVEAU_XV_PRESENT_EVENT(p)	((void *)((uintptr_t)(p) | 1))
+#define NOUVEAU_IS_XV_PRESENT_EVENT(p)	((uintptr_t)(p) & 1)
+#define NOUVEAU_XV_PRESENT_DATA(p)	\
+	((void *)((uintptr_t)(p) & ~(uintptr_t)1))
+
+#ifndef FOURCC_NV12
+#define FOURCC_NV12 0x3231564e
+#endif
+
 #define GET_OVERLAY_PRIVATE(pNv) \
             (NVPortPrivPtr)((pNv)->overlayAdaptor->pPortPrivates[0].ptr)
 
@@ -152,6 +219,9 @@ typedef struct _NVPortPrivRec {
 
 #define TIMER_MASK      (OFF_TIMER | FREE_TIMER)
 
+/* frames in the overlay's VRAM ring, the hardware flips between two */
+#define NV_OVERLAY_BUFFERS 3
+
 /* EXA driver-controlled pixmaps */
 #define NOUVEAU_CREATE_PIXMAP_ZETA	0x10000000
 #define NOUVEAU_CREATE_PIXMAP_TILED	0x20000000
@@ -7,6 +7,8 @@
 #define CODE_OFFSET 0x00000 /* Code */
 #define TIC_OFFSET  0x02000 /* Texture Image Control */
 #define TSC_OFFSET  0x03000 /* Texture Sampler Control */
+#define PICT_OFFSET 0x04000 /* Solid/gradient source ramps */
+#define PICT_SIZE   0x00400 /* ... per texture unit */
 #define NTFY_OFFSET 0x08000
 #define MISC_OFFSET 0x10000
 
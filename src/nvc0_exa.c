@@ -88,7 +88,7 @@ NVC0AccelDownloadM2MF(PixmapPtr pspix, int x, int y, int w, int h,
 		BEGIN_RING(chan, m2mf, NVC0_M2MF_EXEC, 1);
 		OUT_RING  (chan, 0x100000 | (tiled << 8));
 
-		if (nouveau_bo_map(pNv->GART, NOUVEAU_BO_RD)) {
+		if (nv_bo_map(pNv, pNv->GART, NOUVEAU_BO_RD)) {
 			MARK_UNDO(chan);
 			return FALSE;
 		}
@@ -104,7 +104,7 @@ NVC0AccelDownloadM2MF(PixmapPtr pspix, int x, int y, int w, int h,
 				dst += dst_pitch;
 			}
 		}
-		nouveau_bo_unmap(pNv->GART);
+		nv_bo_unmap(pNv, pNv->GART);
 
 		if (!tiled)
 			src_offset += line_count * src_pitch;
@@ -150,7 +150,7 @@ NVC0AccelUploadM2MF(PixmapPtr pdpix, int x, int y, int w, int h,
 		if (line_count > line_limit)
 			line_count = line_limit;
 
-		if (nouveau_bo_map(pNv->GART, NOUVEAU_BO_WR))
+		if (nv_bo_map(pNv, pNv->GART, NOUVEAU_BO_WR))
 			return FALSE;
 		dst = pNv->GART->map;
 
@@ -164,7 +164,7 @@ NVC0AccelUploadM2MF(PixmapPtr pdpix, int x, int y, int w, int h,
 				dst += line_len;
                         }
 		}
-		nouveau_bo_unmap(pNv->GART);
+		nv_bo_unmap(pNv, pNv->GART);
 
 		if (MARK_RING(chan, 16, 4))
 			return FALSE;
@@ -209,6 +209,8 @@ struct nvc0_exa_state {
 		PictTransformPtr transform;
 		float width;
 		float height;
+		Bool source;
+		float coeff[3];
 	} unit[2];
 
 	Bool have_mask;
@@ -651,10 +653,6 @@ NVC0EXARenderTarget(PixmapPtr ppix, PicturePtr ppict)
 	struct nouveau_bo *bo = nouveau_pixmap_bo(ppix);
 	unsigned format;
 
-	/*XXX: Scanout buffer not tiled, someone needs to figure it out */
-	if (!nv50_style_tiled_pixmap(ppix))
-		NOUVEAU_FALLBACK("pixmap is scanout buffer\n");
-
 	switch (ppict->format) {
 	case PICT_a8r8g8b8: format = NV50_SURFACE_FORMAT_A8R8G8B8_UNORM; break;
 	case PICT_x8r8g8b8: format = NV50_SURFACE_FORMAT_X8R8G8B8_UNORM; break;
@@ -679,12 +677,22 @@ NVC0EXARenderTarget(PixmapPtr ppix, PicturePtr ppict)
 	if (OUT_RELOCh(chan, bo, 0, NOUVEAU_BO_VRAM | NOUVEAU_BO_WR) ||
 	    OUT_RELOCl(chan, bo, 0, NOUVEAU_BO_VRAM | NOUVEAU_BO_WR))
 		return FALSE;
-	OUT_RING  (chan, ppix->drawable.width);
-	OUT_RING  (chan, ppix->drawable.height);
-	OUT_RING  (chan, format);
-	OUT_RING  (chan, bo->tile_mode);
-	OUT_RING  (chan, 0x00000001);
-	OUT_RING  (chan, 0x00000000);
+	if (nv50_style_tiled_pixmap(ppix)) {
+		OUT_RING  (chan, ppix->drawable.width);
+		OUT_RING  (chan, ppix->drawable.height);
+		OUT_RING  (chan, format);
+		OUT_RING  (chan, bo->tile_mode);
+		OUT_RING  (chan, 0x00000001);
+		OUT_RING  (chan, 0x00000000);
+	} else {
+		/* pitch-linear, ie. a scanout buffer */
+		OUT_RING  (chan, (uint32_t)exaGetPixmapPitch(ppix));
+		OUT_RING  (chan, ppix->drawable.height);
+		OUT_RING  (chan, format);
+		OUT_RING  (chan, NVC0_3D_RT_TILE_MODE_LINEAR);
+		OUT_RING  (chan, 0x00000001);
+		OUT_RING  (chan, 0x00000000);
+	}
 
 	return TRUE;
 }
@@ -693,7 +701,7 @@ static Bool
 NVC0EXACheckTexture(PicturePtr ppict, PicturePtr pdpict, int op)
 {
 	if (!ppict->pDrawable)
-		NOUVEAU_FALLBACK("Solid and gradient pictures unsupported.\n");
+		return nouveau_exa_source_pict_check(ppict);
 
 	if (ppict->pDrawable->width > 8192 ||
 	    ppict->pDrawable->height > 8192)
@@ -762,11 +770,7 @@ NVC0EXATexture(PixmapPtr ppix, PicturePtr ppict, unsigned unit)
 	NVC0EXA_LOCALS(ppix);
 	struct nouveau_bo *bo = nouveau_pixmap_bo(ppix);
 	const unsigned tcb_flags = NOUVEAU_BO_RDWR | NOUVEAU_BO_VRAM;
-	uint32_t mode;
-
-	/* XXX: maybe add support for linear textures at some point */
-	if (!nv50_style_tiled_pixmap(ppix))
-		NOUVEAU_FALLBACK("pixmap is scanout buffer\n");
+	uint32_t mode, pitch;
 
 	BEGIN_RING(chan, fermi, NVC0_3D_TIC_ADDRESS_HIGH, 3);
 	if (OUT_RELOCh(chan, pNv->tesla_scratch, TIC_OFFSET, tcb_flags) ||
@@ -856,12 +860,21 @@ NVC0EXATexture(PixmapPtr ppix, PicturePtr ppict, unsigned unit)
 	}
 #undef _
 
-	mode = 0xd0005000 | (bo->tile_mode << (22 - 4));
+	if (nv50_style_tiled_pixmap(ppix)) {
+		mode = 0xd0005000 | (bo->tile_mode << (22 - 4));
+		pitch = 0x00300000;
+	} else {
+		/* pitch-linear, ie. a scanout buffer */
+		mode = 0xd0000000 | NV50TIC_0_2_LINEAR |
+		       NV50TIC_0_2_TARGET_RECT;
+		pitch = exaGetPixmapPitch(ppix);
+	}
+
 	if (OUT_RELOCl(chan, bo, 0, NOUVEAU_BO_VRAM | NOUVEAU_BO_RD) ||
 	    OUT_RELOCd(chan, bo, 0, NOUVEAU_BO_VRAM | NOUVEAU_BO_RD |
 		       NOUVEAU_BO_HIGH | NOUVEAU_BO_OR, mode, mode))
 		return FALSE;
-	OUT_RING  (chan, 0x00300000);
+	OUT_RING  (chan, pitch);
 	OUT_RING  (chan, (1 << 31) | ppix->drawable.width);
 	OUT_RING  (chan, (1 << 16) | ppix->drawable.height);
 	OUT_RING  (chan, 0x03000000);
@@ -933,6 +946,122 @@ NVC0EXATexture(PixmapPtr ppix, PicturePtr ppict, unsigned unit)
 	state->unit[unit].width = ppix->drawable.width;
 	state->unit[unit].height = ppix->drawable.height;
 	state->unit[unit].transform = ppict->transform;
+	state->unit[unit].source = FALSE;
+	return TRUE;
+}
+
+static Bool
+NVC0EXASourcePict(PixmapPtr pdpix, PicturePtr ppict, unsigned unit)
+{
+	NVC0EXA_LOCALS(pdpix);
+	const unsigned tcb_flags = NOUVEAU_BO_RDWR | NOUVEAU_BO_VRAM;
+	const unsigned offset = PICT_OFFSET + unit * PICT_SIZE;
+	uint32_t ramp[NOUVEAU_SOURCE_RAMP_SIZE];
+	uint32_t mode;
+	int size;
+
+	size = nouveau_exa_source_pict_ramp(ppict, ramp);
+
+	BEGIN_RING(chan, m2mf, NVC0_M2MF_OFFSET_OUT_HIGH, 2);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch, offset, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch, offset, tcb_flags))
+		return FALSE;
+	BEGIN_RING(chan, m2mf, NVC0_M2MF_LINE_LENGTH_IN, 2);
+	OUT_RING  (chan, size * 4);
+	OUT_RING  (chan, 1);
+	BEGIN_RING(chan, m2mf, NVC0_M2MF_EXEC, 1);
+	OUT_RING  (chan, 0x100111);
+	BEGIN_RING_NI(chan, m2mf, NVC0_M2MF_DATA, size);
+	OUT_RINGp (chan, ramp, size);
+
+	BEGIN_RING(chan, fermi, NVC0_3D_TIC_ADDRESS_HIGH, 3);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch, TIC_OFFSET, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch, TIC_OFFSET, tcb_flags))
+		return FALSE;
+	OUT_RING  (chan, 15);
+
+	BEGIN_RING(chan, m2mf, NVC0_M2MF_OFFSET_OUT_HIGH, 2);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch,
+		       TIC_OFFSET + unit * 32, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch,
+		       TIC_OFFSET + unit * 32, tcb_flags))
+		return FALSE;
+	BEGIN_RING(chan, m2mf, NVC0_M2MF_LINE_LENGTH_IN, 2);
+	OUT_RING  (chan, 8 * 4);
+	OUT_RING  (chan, 1);
+	BEGIN_RING(chan, m2mf, NVC0_M2MF_EXEC, 1);
+	OUT_RING  (chan, 0x100111);
+	BEGIN_RING_NI(chan, m2mf, NVC0_M2MF_DATA, 8);
+	OUT_RING  (chan, NV50TIC_0_0_MAPA_C3 | NV50TIC_0_0_TYPEA_UNORM |
+			 NV50TIC_0_0_MAPB_C0 | NV50TIC_0_0_TYPEB_UNORM |
+			 NV50TIC_0_0_MAPG_C1 | NV50TIC_0_0_TYPEG_UNORM |
+			 NV50TIC_0_0_MAPR_C2 | NV50TIC_0_0_TYPER_UNORM |
+			 NV50TIC_0_0_FMT_8_8_8_8);
+	mode = 0xd0000000 | NV50TIC_0_2_LINEAR | NV50TIC_0_2_TARGET_RECT;
+	if (OUT_RELOCl(chan, pNv->tesla_scratch, offset, NOUVEAU_BO_VRAM |
+		       NOUVEAU_BO_RD) ||
+	    OUT_RELOCd(chan, pNv->tesla_scratch, offset, NOUVEAU_BO_VRAM |
+		       NOUVEAU_BO_RD | NOUVEAU_BO_HIGH | NOUVEAU_BO_OR,
+		       mode, mode))
+		return FALSE;
+	OUT_RING  (chan, PICT_SIZE);
+	OUT_RING  (chan, (1 << 31) | size);
+	OUT_RING  (chan, (1 << 16) | 1);
+	OUT_RING  (chan, 0x03000000);
+	OUT_RING  (chan, 0x00000000);
+
+	BEGIN_RING(chan, fermi, NVC0_3D_TSC_ADDRESS_HIGH, 3);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch, TSC_OFFSET, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch, TSC_OFFSET, tcb_flags))
+		return FALSE;
+	OUT_RING  (chan, 0);
+
+	BEGIN_RING(chan, m2mf, NVC0_M2MF_OFFSET_OUT_HIGH, 2);
+	if (OUT_RELOCh(chan, pNv->tesla_scratch,
+		       TSC_OFFSET + unit * 32, tcb_flags) ||
+	    OUT_RELOCl(chan, pNv->tesla_scratch,
+		       TSC_OFFSET + unit * 32, tcb_flags))
+		return FALSE;
+	BEGIN_RING(chan, m2mf, NVC0_M2MF_LINE_LENGTH_IN, 2);
+	OUT_RING  (chan, 8 * 4);
+	OUT_RING  (chan, 1);
+	BEGIN_RING(chan, m2mf, NVC0_M2MF_EXEC, 1);
+	OUT_RING  (chan, 0x100111);
+	BEGIN_RING_NI(chan, m2mf, NVC0_M2MF_DATA, 8);
+	if (size == 1 || (ppict->repeat && ppict->repeatType == RepeatNormal)) {
+		OUT_RING  (chan, 0x00024000 |
+			   NV50TSC_1_0_WRAPS_REPEAT |
+			   NV50TSC_1_0_WRAPT_CLAMP_TO_EDGE |
+			   NV50TSC_1_0_WRAPR_CLAMP_TO_EDGE);
+	} else
+	if (ppict->repeat && ppict->repeatType == RepeatReflect) {
+		OUT_RING  (chan, 0x00024000 |
+			   NV50TSC_1_0_WRAPS_MIRROR_REPEAT |
+			   NV50TSC_1_0_WRAPT_CLAMP_TO_EDGE |
+			   NV50TSC_1_0_WRAPR_CLAMP_TO_EDGE);
+	} else {
+		/* RepeatPad, and RepeatNone, whose ramp is padded with
+		 * transparent texels
+		 */
+		OUT_RING  (chan, 0x00024000 |
+			   NV50TSC_1_0_WRAPS_CLAMP_TO_EDGE |
+			   NV50TSC_1_0_WRAPT_CLAMP_TO_EDGE |
+			   NV50TSC_1_0_WRAPR_CLAMP_TO_EDGE);
+	}
+	OUT_RING  (chan, NV50TSC_1_1_MAGF_LINEAR |
+		   NV50TSC_1_1_MINF_LINEAR | NV50TSC_1_1_MIPF_NONE);
+	OUT_RING  (chan, 0x00000000);
+	OUT_RING  (chan, 0x00000000);
+	OUT_RINGf (chan, 0.0f);
+	OUT_RINGf (chan, 0.0f);
+	OUT_RINGf (chan, 0.0f);
+	OUT_RINGf (chan, 0.0f);
+
+	state->unit[unit].width = 1.0;
+	state->unit[unit].height = 1.0;
+	state->unit[unit].transform = ppict->transform;
+	state->unit[unit].source = TRUE;
+	nouveau_exa_source_pict_coeffs(ppict, state->unit[unit].coeff);
 	return TRUE;
 }
 
@@ -1011,6 +1140,9 @@ NVC0EXACheckComposite(int op,
 			NOUVEAU_FALLBACK("mask picture invalid\n");
 	}
 
+	if (!NVAccelInit3D(xf86Screens[pdpict->pDrawable->pScreen->myNum]))
+		NOUVEAU_FALLBACK("3D engine unavailable\n");
+
 	return TRUE;
 }
 
@@ -1029,10 +1161,16 @@ NVC0EXAPrepareComposite(int op,
 			PicturePtr pspict, PicturePtr pmpict, PicturePtr pdpict,
 			PixmapPtr pspix, PixmapPtr pmpix, PixmapPtr pdpix)
 {
-	NVC0EXA_LOCALS(pspix);
+	NVC0EXA_LOCALS(pdpix);
 	const unsigned shd_flags = NOUVEAU_BO_VRAM | NOUVEAU_BO_RD;
+	unsigned dwords = 128;
+
+	if (!pspict->pDrawable)
+		dwords += NOUVEAU_SOURCE_RAMP_SIZE + 8;
+	if (pmpict && !pmpict->pDrawable)
+		dwords += NOUVEAU_SOURCE_RAMP_SIZE + 8;
 
-	if (MARK_RING (chan, 128, 4 + 2 + 2 * 10))
+	if (MARK_RING (chan, dwords, 4 + 2 + 2 * 12))
 		NOUVEAU_FALLBACK("ring space\n");
 
 	// fonts: !pmpict, op == 12 (Add, ONE/ONE)
@@ -1059,7 +1197,8 @@ NVC0EXAPrepareComposite(int op,
 		return FALSE;
 	}
 
-	if (!NVC0EXATexture(pspix, pspict, 0)) {
+	if (pspict->pDrawable ? !NVC0EXATexture(pspix, pspict, 0) :
+				!NVC0EXASourcePict(pdpix, pspict, 0)) {
 		MARK_UNDO(chan);
 		NOUVEAU_FALLBACK("src picture invalid\n");
 	}
@@ -1067,7 +1206,8 @@ NVC0EXAPrepareComposite(int op,
 	OUT_RING  (chan, (0 << 9) | (0 << 1) | NVC0_3D_BIND_TIC_ACTIVE);
 
 	if (pmpict) {
-		if (!NVC0EXATexture(pmpix, pmpict, 1)) {
+		if (pmpict->pDrawable ? !NVC0EXATexture(pmpix, pmpict, 1) :
+					!NVC0EXASourcePict(pdpix, pmpict, 1)) {
 			MARK_UNDO(chan);
 			NOUVEAU_FALLBACK("mask picture invalid\n");
 		}
@@ -1143,6 +1283,25 @@ NVC0EXATransform(PictTransformPtr t, int x, int y, float sx, float sy,
 	}
 }
 
+static inline void
+NVC0EXAUnitTransform(struct nvc0_exa_state *state, int unit, int x, int y,
+		     float *x_ret, float *y_ret)
+{
+	if (state->unit[unit].source) {
+		const float *c = state->unit[unit].coeff;
+		float px, py;
+
+		NVC0EXATransform(state->unit[unit].transform, x, y, 1.0, 1.0,
+				 &px, &py);
+		*x_ret = c[0] * px + c[1] * py + c[2];
+		*y_ret = 0.5;
+	} else {
+		NVC0EXATransform(state->unit[unit].transform, x, y,
+				 state->unit[unit].width,
+				 state->unit[unit].height, x_ret, y_ret);
+	}
+}
+
 void
 NVC0EXAComposite(PixmapPtr pdpix,
 		 int sx, int sy, int mx, int my,
@@ -1158,28 +1317,16 @@ NVC0EXAComposite(PixmapPtr pdpix,
 	BEGIN_RING(chan, fermi, NVC0_3D_VERTEX_BEGIN_GL, 1);
 	OUT_RING  (chan, NVC0_3D_VERTEX_BEGIN_GL_PRIMITIVE_TRIANGLES);
 
-	NVC0EXATransform(state->unit[0].transform, sx, sy + (h * 2),
-			 state->unit[0].width, state->unit[0].height,
-			 &sX0, &sY0);
-	NVC0EXATransform(state->unit[0].transform, sx, sy,
-			 state->unit[0].width, state->unit[0].height,
-			 &sX1, &sY1);
-	NVC0EXATransform(state->unit[0].transform, sx + (w * 2), sy,
-			 state->unit[0].width, state->unit[0].height,
-			 &sX2, &sY2);
+	NVC0EXAUnitTransform(state, 0, sx, sy + (h * 2), &sX0, &sY0);
+	NVC0EXAUnitTransform(state, 0, sx, sy, &sX1, &sY1);
+	NVC0EXAUnitTransform(state, 0, sx + (w * 2), sy, &sX2, &sY2);
 
 	if (state->have_mask) {
 		float mX0, mX1, mX2, mY0, mY1, mY2;
 
-		NVC0EXATransform(state->unit[1].transform, mx, my + (h * 2),
-				 state->unit[1].width, state->unit[1].height,
-				 &mX0, &mY0);
-		NVC0EXATransform(state->unit[1].transform, mx, my,
-				 state->unit[1].width, state->unit[1].height,
-				 &mX1, &mY1);
-		NVC0EXATransform(state->unit[1].transform, mx + (w * 2), my,
-				 state->unit[1].width, state->unit[1].height,
-				 &mX2, &mY2);
+		NVC0EXAUnitTransform(state, 1, mx, my + (h * 2), &mX0, &mY0);
+		NVC0EXAUnitTransform(state, 1, mx, my, &mX1, &mY1);
+		NVC0EXAUnitTransform(state, 1, mx + (w * 2), my, &mX2, &mY2);
 
 		VTX2s(pNv, sX0, sY0, mX0, mY0, dx, dy + (h * 2));
 		VTX2s(pNv, sX1, sY1, mX1, mY1, dx, dy);
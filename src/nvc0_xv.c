@@ -166,7 +166,7 @@ nvc0_xv_state_emit(PixmapPtr ppix, int id, struct nouveau_bo *src,
 	BEGIN_RING(chan, m2mf, NVC0_M2MF_EXEC, 1);
 	OUT_RING  (chan, 0x00100111);
 	BEGIN_RING_NI(chan, m2mf, NVC0_M2MF_DATA, 16);
-	if (id == FOURCC_YV12 || id == FOURCC_I420) {
+	if (id == FOURCC_YV12 || id == FOURCC_I420 || id == FOURCC_NV12) {
 	OUT_RING  (chan, NV50TIC_0_0_MAPA_C0 | NV50TIC_0_0_TYPEA_UNORM |
 			 NV50TIC_0_0_MAPB_ZERO | NV50TIC_0_0_TYPEB_UNORM |
 			 NV50TIC_0_0_MAPG_ZERO | NV50TIC_0_0_TYPEG_UNORM |
@@ -320,6 +320,23 @@ nvc0_xv_state_emit(PixmapPtr ppix, int id, struct nouveau_bo *src,
 	return TRUE;
 }
 
+/* Starts the batch of clip box quads, scissored to their extents. */
+static void
+nvc0_xv_draw_begin(NVPtr pNv, BoxPtr extents)
+{
+	struct nouveau_channel *chan = pNv->chan;
+	struct nouveau_grobj *fermi = pNv->Nv3D;
+
+	BEGIN_RING(chan, fermi, NVC0_3D_SCISSOR_HORIZ(0), 2);
+	OUT_RING  (chan, extents->x2 << NVC0_3D_SCISSOR_HORIZ_MAX__SHIFT |
+			 extents->x1);
+	OUT_RING  (chan, extents->y2 << NVC0_3D_SCISSOR_VERT_MAX__SHIFT |
+			 extents->y1);
+
+	BEGIN_RING(chan, fermi, NVC0_3D_VERTEX_BEGIN_GL, 1);
+	OUT_RING  (chan, NVC0_3D_VERTEX_BEGIN_GL_PRIMITIVE_QUADS);
+}
+
 int
 nvc0_xv_image_put(ScrnInfoPtr pScrn,
 		  struct nouveau_bo *src, int packed_y, int uv,
@@ -334,12 +351,14 @@ nvc0_xv_image_put(ScrnInfoPtr pScrn,
 	NVPtr pNv = NVPTR(pScrn);
 	struct nouveau_channel *chan = pNv->chan;
 	struct nouveau_grobj *fermi = pNv->Nv3D;
-	float X1, X2, Y1, Y2;
-	BoxPtr pbox;
+	float X1, Y1, sx, sy;
+	BoxPtr pbox, extents;
 	int nbox;
 
 	if (!nvc0_xv_check_image_put(ppix))
 		return BadMatch;
+	if (pPriv->csc_dirty && !nv50_xv_csc_update(pScrn, pPriv))
+		return BadAlloc;
 	if (!nvc0_xv_state_emit(ppix, id, src, packed_y, uv, width, height))
 		return BadAlloc;
 
@@ -350,52 +369,54 @@ nvc0_xv_image_put(ScrnInfoPtr pScrn,
 	/* These are fixed point values in the 16.16 format. */
 	X1 = (float)(x1>>16)+(float)(x1&0xFFFF)/(float)0x10000;
 	Y1 = (float)(y1>>16)+(float)(y1&0xFFFF)/(float)0x10000;
-	X2 = (float)(x2>>16)+(float)(x2&0xFFFF)/(float)0x10000;
-	Y2 = (float)(y2>>16)+(float)(y2&0xFFFF)/(float)0x10000;
+
+	/* The texture coordinates are linear in the destination position,
+	 * work out the mapping once instead of per box.
+	 */
+	sx = (float)src_w / ((float)drw_w * width);
+	sy = (float)src_h / ((float)drw_h * height);
+	X1 = X1 / width - dstBox->x1 * sx;
+	Y1 = Y1 / height - dstBox->y1 * sy;
+
+	/* All the clip boxes go out as quads in a single primitive, the
+	 * state is only emitted again if the ring fills up.
+	 */
+	extents = REGION_EXTENTS(pScrn->pScreen, clipBoxes);
+	nvc0_xv_draw_begin(pNv, extents);
 
 	pbox = REGION_RECTS(clipBoxes);
 	nbox = REGION_NUM_RECTS(clipBoxes);
 	while(nbox--) {
-		float tx1=X1+(float)(pbox->x1 - dstBox->x1)*(X2-X1)/(float)(drw_w);
-		float tx2=X1+(float)(pbox->x2 - dstBox->x1)*(src_w)/(float)(drw_w);
-		float ty1=Y1+(float)(pbox->y1 - dstBox->y1)*(Y2-Y1)/(float)(drw_h);
-		float ty2=Y1+(float)(pbox->y2 - dstBox->y1)*(src_h)/(float)(drw_h);
-		int sx1=pbox->x1;
-		int sx2=pbox->x2;
-		int sy1=pbox->y1;
-		int sy2=pbox->y2;
-
-		tx1 = tx1 / width;
-		tx2 = tx2 / width;
-		ty1 = ty1 / height;
-		ty2 = ty2 / height;
-
-		if (AVAIL_RING(chan) < 64) {
+		float tx1 = X1 + pbox->x1 * sx;
+		float tx2 = X1 + pbox->x2 * sx;
+		float ty1 = Y1 + pbox->y1 * sy;
+		float ty2 = Y1 + pbox->y2 * sy;
+
+		if (AVAIL_RING(chan) < 48) {
+			BEGIN_RING(chan, fermi, NVC0_3D_VERTEX_END_GL, 1);
+			OUT_RING  (chan, 0);
 			if (!nvc0_xv_state_emit(ppix, id, src, packed_y, uv,
 						width, height))
 				return BadAlloc;
+			nvc0_xv_draw_begin(pNv, extents);
 		}
 
-		BEGIN_RING(chan, fermi, NVC0_3D_SCISSOR_HORIZ(0), 2);
-		OUT_RING  (chan, sx2 << NVC0_3D_SCISSOR_HORIZ_MAX__SHIFT | sx1);
-		OUT_RING  (chan, sy2 << NVC0_3D_SCISSOR_VERT_MAX__SHIFT | sy1 );
-
-		BEGIN_RING(chan, fermi, NVC0_3D_VERTEX_BEGIN_GL, 1);
-		OUT_RING  (chan, NVC0_3D_VERTEX_BEGIN_GL_PRIMITIVE_TRIANGLES);
-		VTX2s(pNv, tx1, ty1, tx1, ty1, sx1, sy1);
-		VTX2s(pNv, tx2+(tx2-tx1), ty1, tx2+(tx2-tx1), ty1, sx2+(sx2-sx1), sy1);
-		VTX2s(pNv, tx1, ty2+(ty2-ty1), tx1, ty2+(ty2-ty1), sx1, sy2+(sy2-sy1));
-		BEGIN_RING(chan, fermi, NVC0_3D_VERTEX_END_GL, 1);
-		OUT_RING  (chan, 0);
+		VTX2s(pNv, tx1, ty1, tx1, ty1, pbox->x1, pbox->y1);
+		VTX2s(pNv, tx2, ty1, tx2, ty1, pbox->x2, pbox->y1);
+		VTX2s(pNv, tx2, ty2, tx2, ty2, pbox->x2, pbox->y2);
+		VTX2s(pNv, tx1, ty2, tx1, ty2, pbox->x1, pbox->y2);
 
 		pbox++;
 	}
 
+	BEGIN_RING(chan, fermi, NVC0_3D_VERTEX_END_GL, 1);
+	OUT_RING  (chan, 0);
+
 	FIRE_RING (chan);
 	return Success;
 }
 
-void
+Bool
 nvc0_xv_csc_update(NVPtr pNv, float yco, float *off, float *uco, float *vco)
 {
 	struct nouveau_channel *chan = pNv->chan;
@@ -403,14 +424,14 @@ nvc0_xv_csc_update(NVPtr pNv, float yco, float *off, float *uco, float *vco)
 	struct nouveau_grobj *fermi = pNv->Nv3D;
 
 	if (MARK_RING(chan, 64, 2))
-		return;
+		return FALSE;
 
 	BEGIN_RING(chan, fermi, NVC0_3D_CB_SIZE, 3);
 	OUT_RING  (chan, 256);
 	if (OUT_RELOCh(chan, bo, CB_OFFSET, NOUVEAU_BO_VRAM | NOUVEAU_BO_WR) ||
 	    OUT_RELOCl(chan, bo, CB_OFFSET, NOUVEAU_BO_VRAM | NOUVEAU_BO_WR)) {
 		MARK_UNDO(chan);
-		return;
+		return FALSE;
 	}
 	BEGIN_RING(chan, fermi, NVC0_3D_CB_POS, 11);
 	OUT_RING  (chan, 0);
@@ -424,4 +445,5 @@ nvc0_xv_csc_update(NVPtr pNv, float yco, float *off, float *uco, float *vco)
 	OUT_RINGf (chan, vco[0]);
 	OUT_RINGf (chan, vco[1]);
 	OUT_RINGf (chan, vco[2]);
+	return TRUE;
 }
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2009 Nouveau Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Checks of the vblank timing model (nouveau_vblank_model.c) against a
+ * simulated CRTC: that it predicts the MSC/UST the kernel would report,
+ * and that it falls back to asking the kernel when its last sample is
+ * stale, when the clock is behind it, after a mode change, and close
+ * enough to a vblank that it can't tell which side of it we're on.
+ *
+ * usage: vblank_model_test
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nouveau_vblank_model.h"
+
+static int failures;
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: check failed: %s\n",		\
+			__FILE__, __LINE__, #cond);			\
+		failures++;						\
+	}								\
+} while (0)
+
+/* A CRTC whose vblank n is at start + n * period, period in ns so that
+ * refresh rates like 59.94Hz aren't a whole number of microseconds.
+ */
+struct crtc {
+	CARD64 start;
+	CARD64 period;
+};
+
+static CARD64
+crtc_ust(const struct crtc *c, CARD64 msc)
+{
+	return c->start + msc * c->period / 1000;
+}
+
+/* what the kernel would answer for the current MSC/UST */
+static CARD64
+crtc_msc(const struct crtc *c, CARD64 now)
+{
+	return (now - c->start) * 1000 / c->period;
+}
+
+static void
+feed(struct nouveau_vblank_model *m, const struct crtc *c, CARD64 msc0,
+     int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		nouveau_vblank_model_update(m, msc0 + i, crtc_ust(c, msc0 + i));
+}
+
+/* Wherever it does predict, the prediction is what the kernel says. */
+static void
+test_accuracy(CARD64 period)
+{
+	struct crtc c = { 5000000, period };
+	struct nouveau_vblank_model m;
+	CARD64 now, msc, ust, last, err;
+	int predicted = 0, asked = 0;
+
+	memset(&m, 0, sizeof(m));
+	feed(&m, &c, 100, 8);
+	last = crtc_ust(&c, 107);
+
+	for (now = last; now <= last + NOUVEAU_VBLANK_MODEL_STALE;
+	     now += 97) {
+		if (!nouveau_vblank_model_predict(&m, now, &msc, &ust)) {
+			asked++;
+			continue;
+		}
+
+		/* the period is kept in whole microseconds, rounded down */
+		err = 2 * (msc - 107);
+
+		predicted++;
+		CHECK(msc == crtc_msc(&c, now));
+		CHECK(ust <= now);
+		CHECK(ust + err >= crtc_ust(&c, msc) &&
+		      ust <= crtc_ust(&c, msc) + err);
+	}
+
+	/* only the slack either side of each vblank goes to the kernel */
+	CHECK(predicted > 0);
+	CHECK(asked < predicted / 2);
+}
+
+/* Nothing to go on before the second vblank. */
+static void
+test_cold(void)
+{
+	struct crtc c = { 5000000, 16666667 };
+	struct nouveau_vblank_model m;
+	CARD64 msc, ust;
+
+	memset(&m, 0, sizeof(m));
+	CHECK(!nouveau_vblank_model_predict(&m, c.start + 8000, &msc, &ust));
+
+	nouveau_vblank_model_update(&m, 0, crtc_ust(&c, 0));
+	CHECK(!nouveau_vblank_model_predict(&m, crtc_ust(&c, 0) + 8000,
+					    &msc, &ust));
+
+	/* the same vblank reported twice isn't a second sample */
+	nouveau_vblank_model_update(&m, 0, crtc_ust(&c, 0));
+	CHECK(!nouveau_vblank_model_predict(&m, crtc_ust(&c, 0) + 8000,
+					    &msc, &ust));
+
+	nouveau_vblank_model_update(&m, 1, crtc_ust(&c, 1));
+	CHECK(nouveau_vblank_model_predict(&m, crtc_ust(&c, 1) + 8000,
+					   &msc, &ust));
+	CHECK(msc == 1 && ust == crtc_ust(&c, 1));
+}
+
+/* A sample more than STALE old, or from the future, isn't used. */
+static void
+test_stale(void)
+{
+	struct crtc c = { 5000000, 16666667 };
+	struct nouveau_vblank_model m;
+	CARD64 last, msc, ust;
+
+	memset(&m, 0, sizeof(m));
+	feed(&m, &c, 0, 4);
+	last = crtc_ust(&c, 3);
+
+	/* the last prediction window before going stale, and past it */
+	CHECK(nouveau_vblank_model_predict(&m, crtc_ust(&c, 62) + 8000,
+					   &msc, &ust));
+	CHECK(msc == 62);
+	CHECK(!nouveau_vblank_model_predict(&m, crtc_ust(&c, 63) + 8000,
+					    &msc, &ust));
+	CHECK(!nouveau_vblank_model_predict(&m, last +
+					    NOUVEAU_VBLANK_MODEL_STALE + 1,
+					    &msc, &ust));
+
+	/* a clock behind the last vblank, say a different clock */
+	CHECK(!nouveau_vblank_model_predict(&m, last - 8000, &msc, &ust));
+
+	/* a fresh vblank makes it usable again */
+	nouveau_vblank_model_update(&m, 100, crtc_ust(&c, 100));
+	CHECK(nouveau_vblank_model_predict(&m, crtc_ust(&c, 100) + 8000,
+					   &msc, &ust));
+	CHECK(msc == 100);
+}
+
+/* Within SLACK of a vblank the model can't tell if it has happened yet. */
+static void
+test_edges(void)
+{
+	struct crtc c = { 5000000, 16666000 };
+	struct nouveau_vblank_model m;
+	CARD64 v, msc, ust;
+	const CARD64 slack = NOUVEAU_VBLANK_MODEL_SLACK;
+
+	memset(&m, 0, sizeof(m));
+	feed(&m, &c, 0, 4);
+	CHECK(m.period == 16666);
+	v = crtc_ust(&c, 5);
+
+	CHECK(!nouveau_vblank_model_predict(&m, v, &msc, &ust));
+	CHECK(!nouveau_vblank_model_predict(&m, v + slack - 1, &msc, &ust));
+	CHECK(!nouveau_vblank_model_predict(&m, v - slack + 1, &msc, &ust));
+
+	CHECK(nouveau_vblank_model_predict(&m, v + slack, &msc, &ust));
+	CHECK(msc == 5 && ust == v);
+	CHECK(nouveau_vblank_model_predict(&m, v - slack, &msc, &ust));
+	CHECK(msc == 4 && ust == crtc_ust(&c, 4));
+}
+
+/* A mode change or DPMS cycle can reset the counter or the timing, the
+ * model starts over rather than mixing the two.
+ */
+static void
+test_reset(void)
+{
+	struct crtc c = { 5000000, 16666667 }, d = { 9000000, 13333333 };
+	struct nouveau_vblank_model m;
+	CARD64 msc, ust;
+
+	memset(&m, 0, sizeof(m));
+	feed(&m, &c, 50, 4);
+
+	/* counter went backwards */
+	nouveau_vblank_model_update(&m, 0, crtc_ust(&d, 0));
+	CHECK(!nouveau_vblank_model_predict(&m, crtc_ust(&d, 0) + 6000,
+					    &msc, &ust));
+
+	feed(&m, &d, 1, 4);
+	CHECK(nouveau_vblank_model_predict(&m, crtc_ust(&d, 4) + 6000,
+					   &msc, &ust));
+	CHECK(msc == 4);
+	CHECK(m.period >= 13333 - 1000 && m.period <= 13333 + 1000);
+
+	/* settles on the new rate */
+	feed(&m, &d, 5, 40);
+	CHECK(m.period >= 13332 && m.period <= 13334);
+}
+
+int
+main(void)
+{
+	test_cold();
+	test_accuracy(16666667);	/* 60Hz */
+	test_accuracy(16683350);	/* 59.94Hz */
+	test_accuracy(6944444);		/* 144Hz */
+	test_accuracy(40000000);	/* 25Hz */
+	test_stale();
+	test_edges();
+	test_reset();
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("vblank model checks passed\n");
+	return 0;
+}
@@ -8,6 +8,9 @@
 #include <X11/extensions/XvMC.h>
 #include <xf86.h>
 #include <fourcc.h>
+#include "nv_include.h"
+
+#define VL_ALIGN(x, a)	(((x) + (a) - 1) & ~((a) - 1))
 
 #define FOURCC_RGB	0x0000003
 #define XVIMAGE_RGB								\
@@ -70,6 +73,158 @@ static XF86ImagePtr subpictures[] =
 	(XF86ImagePtr)&rgb_subpicture
 };
 
+/* Driver side of surfaces and subpictures, the buffer the client renders to */
+struct vlXvMCBuffer
+{
+	struct nouveau_bo	*bo;
+};
+
+static int vlCreateBufferXvMC(ScrnInfoPtr pScrn, unsigned int size, void **driver_priv, CARD32 *handle)
+{
+	NVPtr			pNv = NVPTR(pScrn);
+	struct vlXvMCBuffer	*buffer;
+
+	buffer = calloc(1, sizeof(*buffer));
+	if (!buffer)
+		return BadAlloc;
+
+	if (nouveau_bo_new(pNv->dev, NOUVEAU_BO_VRAM | NOUVEAU_BO_MAP, 0, size, &buffer->bo))
+	{
+		free(buffer);
+		return BadAlloc;
+	}
+
+	if (nouveau_bo_handle_get(buffer->bo, handle))
+	{
+		nouveau_bo_ref(NULL, &buffer->bo);
+		free(buffer);
+		return BadAlloc;
+	}
+
+	*driver_priv = buffer;
+	return Success;
+}
+
+static void vlDestroyBufferXvMC(void *driver_priv)
+{
+	struct vlXvMCBuffer *buffer = driver_priv;
+
+	if (!buffer)
+		return;
+
+	nouveau_bo_ref(NULL, &buffer->bo);
+	free(buffer);
+}
+
+static int vlCreateContextXvMC(ScrnInfoPtr pScrn, XvMCContextPtr context, int *num_priv, CARD32 **priv)
+{
+	NVPtr				pNv = NVPTR(pScrn);
+	struct vlXvMCContextPriv	*context_priv;
+
+	if (context->width > yv12_mpeg2_surface.max_width ||
+	    context->height > yv12_mpeg2_surface.max_height)
+		return BadValue;
+
+	context_priv = calloc(1, sizeof(*context_priv));
+	if (!context_priv)
+		return BadAlloc;
+
+	/* Field pictures work on 16x16 macroblocks of one field */
+	context_priv->chipset = pNv->dev->chipset;
+	context_priv->width = VL_ALIGN(context->width, 16);
+	context_priv->height = VL_ALIGN(context->height, 32);
+
+	/* The XvMC layer frees the private data once it has been sent */
+	*num_priv = sizeof(*context_priv) / sizeof(CARD32);
+	*priv = (CARD32*)context_priv;
+
+	return Success;
+}
+
+static void vlDestroyContextXvMC(ScrnInfoPtr pScrn, XvMCContextPtr context)
+{
+	/* Nothing to do, surfaces and subpictures go away on their own */
+}
+
+static int vlCreateSurfaceXvMC(ScrnInfoPtr pScrn, XvMCSurfacePtr surface, int *num_priv, CARD32 **priv)
+{
+	struct vlXvMCSurfacePriv	*surface_priv;
+	unsigned int			width, height;
+	int				ret;
+
+	surface_priv = calloc(1, sizeof(*surface_priv));
+	if (!surface_priv)
+		return BadAlloc;
+
+	width = VL_ALIGN(surface->context->width, 16);
+	height = VL_ALIGN(surface->context->height, 32);
+
+	/* YV12: luma, then V and U at half the pitch and height */
+	surface_priv->pitch = VL_ALIGN(width, 64);
+	surface_priv->uv_pitch = surface_priv->pitch / 2;
+	surface_priv->v_offset = surface_priv->pitch * height;
+	surface_priv->u_offset = surface_priv->v_offset + surface_priv->uv_pitch * (height / 2);
+
+	ret = vlCreateBufferXvMC(pScrn, surface_priv->u_offset + surface_priv->uv_pitch * (height / 2),
+				 &surface->driver_priv, &surface_priv->handle);
+	if (ret != Success)
+	{
+		free(surface_priv);
+		return ret;
+	}
+
+	*num_priv = sizeof(*surface_priv) / sizeof(CARD32);
+	*priv = (CARD32*)surface_priv;
+
+	return Success;
+}
+
+static void vlDestroySurfaceXvMC(ScrnInfoPtr pScrn, XvMCSurfacePtr surface)
+{
+	vlDestroyBufferXvMC(surface->driver_priv);
+	surface->driver_priv = NULL;
+}
+
+static int vlCreateSubpictureXvMC(ScrnInfoPtr pScrn, XvMCSubpicturePtr subpicture, int *num_priv, CARD32 **priv)
+{
+	struct vlXvMCSubpicturePriv	*subpicture_priv;
+	int				ret;
+
+	if (subpicture->xvimage_id != FOURCC_RGB ||
+	    subpicture->width > yv12_mpeg2_surface.subpicture_max_width ||
+	    subpicture->height > yv12_mpeg2_surface.subpicture_max_height)
+		return BadMatch;
+
+	subpicture_priv = calloc(1, sizeof(*subpicture_priv));
+	if (!subpicture_priv)
+		return BadAlloc;
+
+	subpicture_priv->pitch = VL_ALIGN(subpicture->width * 4, 64);
+
+	ret = vlCreateBufferXvMC(pScrn, subpicture_priv->pitch * subpicture->height,
+				 &subpicture->driver_priv, &subpicture_priv->handle);
+	if (ret != Success)
+	{
+		free(subpicture_priv);
+		return ret;
+	}
+
+	/* BGRX, no palette */
+	subpicture->num_palette_entries = 0;
+	subpicture->entry_bytes = 0;
+
+	*num_priv = sizeof(*subpicture_priv) / sizeof(CARD32);
+	*priv = (CARD32*)subpicture_priv;
+
+	return Success;
+}
+
+static void vlDestroySubpictureXvMC(ScrnInfoPtr pScrn, XvMCSubpicturePtr subpicture)
+{
+	vlDestroyBufferXvMC(subpicture->driver_priv);
+	subpicture->driver_priv = NULL;
+}
+
 static XF86MCAdaptorRec adaptor_template =
 {
 	"",
@@ -77,12 +232,12 @@ static XF86MCAdaptorRec adaptor_template =
 	surfaces,
 	1,
 	subpictures,
-	(xf86XvMCCreateContextProcPtr)NULL,
-	(xf86XvMCDestroyContextProcPtr)NULL,
-	(xf86XvMCCreateSurfaceProcPtr)NULL,
-	(xf86XvMCDestroySurfaceProcPtr)NULL,
-	(xf86XvMCCreateSubpictureProcPtr)NULL,
-	(xf86XvMCDestroySubpictureProcPtr)NULL
+	vlCreateContextXvMC,
+	vlDestroyContextXvMC,
+	vlCreateSurfaceXvMC,
+	vlDestroySurfaceXvMC,
+	vlCreateSubpictureXvMC,
+	vlDestroySubpictureXvMC
 };
 
 XF86MCAdaptorPtr vlCreateAdaptorXvMC(ScreenPtr pScreen, char *xv_adaptor_name)
@@ -116,9 +271,11 @@ void vlDestroyAdaptorXvMC(XF86MCAdaptorPtr adaptor)
 	xf86XvMCDestroyAdaptorRec(adaptor);
 }
 
-/* TODO: Manage adaptor list and adaptor rec memory internally */
-
-void vlInitXvMC(ScreenPtr pScreen, unsigned int num_adaptors, XF86MCAdaptorPtr *adaptors)
+/*
+ * The XvMC layer keeps using the adaptor list and recs after this, they
+ * must stay around until the screen is closed.
+ */
+Bool vlInitXvMC(ScreenPtr pScreen, unsigned int num_adaptors, XF86MCAdaptorPtr *adaptors)
 {
 	ScrnInfoPtr	pScrn;
 	int		i;
@@ -132,9 +289,12 @@ void vlInitXvMC(ScreenPtr pScreen, unsigned int num_adaptors, XF86MCAdaptorPtr *
 	pScrn = xf86Screens[pScreen->myNum];
 	
 	if (!xf86XvMCScreenInit(pScreen, num_adaptors, adaptors))
+	{
 		xf86DrvMsg(pScrn->scrnIndex, X_ERROR, "[XvMC] Failed to initialize extension.\n");
-	else
-		xf86DrvMsg(pScrn->scrnIndex, X_INFO, "[XvMC] Extension initialized.\n");
+		return FALSE;
+	}
+
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO, "[XvMC] Extension initialized.\n");
 	
 #if (XvMCVersion > 1) || (XvMCRevision > 0)
 	/*
@@ -144,5 +304,7 @@ void vlInitXvMC(ScreenPtr pScreen, unsigned int num_adaptors, XF86MCAdaptorPtr *
 		xf86DrvMsg(pScrn->scrnIndex, X_INFO, "[XvMC] Registered client library.\n");
 	*/
 #endif
+
+	return TRUE;
 }
 
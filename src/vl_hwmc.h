@@ -3,9 +3,35 @@
 
 #include <xf86xvmc.h>
 
+/*
+ * Private data handed to the client library, as arrays of CARD32.
+ * Buffers are shared through their global GEM names.
+ */
+struct vlXvMCContextPriv
+{
+	CARD32	chipset;
+	CARD32	width;		/* surface size, rounded up to macroblocks */
+	CARD32	height;
+};
+
+struct vlXvMCSurfacePriv
+{
+	CARD32	handle;
+	CARD32	pitch;		/* of luma */
+	CARD32	u_offset;
+	CARD32	v_offset;
+	CARD32	uv_pitch;
+};
+
+struct vlXvMCSubpicturePriv
+{
+	CARD32	handle;
+	CARD32	pitch;
+};
+
 XF86MCAdaptorPtr vlCreateAdaptorXvMC(ScreenPtr pScreen, char *xv_adaptor_name);
 void vlDestroyAdaptorXvMC(XF86MCAdaptorPtr adaptor);
-void vlInitXvMC(ScreenPtr pScreen, unsigned int num_adaptors, XF86MCAdaptorPtr *adaptors);
+Bool vlInitXvMC(ScreenPtr pScreen, unsigned int num_adaptors, XF86MCAdaptorPtr *adaptors);
 
 #endif
 
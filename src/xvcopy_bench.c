@@ -0,0 +1,185 @@
+/*
+ * Copyright 2009 Nouveau Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Standalone throughput benchmark of the Xv CPU copy (nouveau_xv_copy.c),
+ * the conversion NVPutImage does before queueing the M2MF upload.  Each
+ * layout is timed on one thread and then split over the worker threads,
+ * the same way the driver does above XvThreadPixels.
+ *
+ * usage: xvcopy_bench [width height [threads [frames]]]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nouveau_xv_copy.h"
+
+struct layout {
+	const char *name;
+	int action_flags;
+};
+
+static const struct layout layouts[] = {
+	{ "YV12 -> YUY2", IS_YV12 | CONVERT_TO_YUY2 },
+	{ "YV12 -> NV12", IS_YV12 },
+	{ "NV12", IS_YV12 | IS_NV12 },
+	{ "YV12 planar", IS_YV12 | PLANAR_UPLOAD },
+	{ "YUY2", IS_YUY2 },
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Fills in c the way NVPutImage would for a whole w x h image, returns
+ * the number of bytes written per frame.
+ */
+static long
+setup(struct nv_xv_copy *c, int flags, int w, int h,
+      unsigned char *src, unsigned char *dst)
+{
+	memset(c, 0, sizeof(*c));
+	c->action_flags = flags;
+	c->npixels = w;
+	c->nlines = h;
+	c->src = src;
+
+	if (flags & IS_YUY2) {
+		c->src_pitch = w << 1;
+		c->line_len = w << 1;
+		c->dst_pitch = ((w << 1) + 63) & ~63;
+		c->dst = dst;
+		return (long)c->line_len * h;
+	}
+
+	c->src_pitch = w;
+	c->src_pitch2 = (flags & IS_NV12) ? w : w >> 1;
+	c->src2 = src + w * h;
+	c->src3 = (flags & IS_NV12) ? c->src2 :
+		  c->src2 + c->src_pitch2 * (h >> 1);
+	c->dst = dst;
+
+	if (flags & CONVERT_TO_YUY2) {
+		c->line_len = w << 1;
+		c->dst_pitch = ((w << 1) + 63) & ~63;
+		return (long)c->line_len * h;
+	}
+
+	c->line_len = w;
+	if (flags & PLANAR_UPLOAD) {
+		c->dst_pitch = w;
+		c->dst_uv = dst + w * h;
+	} else {
+		c->dst_pitch = (w + 63) & ~63;
+		c->dst_uv = dst + c->dst_pitch * h;
+	}
+	return (long)w * h * 3 / 2;
+}
+
+int
+main(int argc, char **argv)
+{
+	int w = 3840, h = 2160, threads = 3, frames = 200;
+	unsigned char *src, *dst;
+	size_t size;
+	unsigned i;
+
+	if (argc > 2) {
+		w = atoi(argv[1]) & ~1;
+		h = atoi(argv[2]) & ~1;
+	}
+	if (argc > 3)
+		threads = atoi(argv[3]);
+	if (argc > 4)
+		frames = atoi(argv[4]);
+	if (w <= 0 || h <= 0 || threads < 0 || frames <= 0) {
+		fprintf(stderr, "usage: %s [width height [threads [frames]]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	/* big enough for the largest layout, YUY2 with a padded pitch */
+	size = (size_t)(((w << 1) + 63) & ~63) * h;
+	src = malloc(size);
+	dst = malloc(size);
+	if (!src || !dst) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < size; i++)
+		src[i] = i * 7;
+	memset(dst, 0, size);
+
+	printf("%dx%d, %d frames\n", w, h, frames);
+
+	for (i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+		struct nv_xv_copy c;
+		long bytes = setup(&c, layouts[i].action_flags, w, h,
+				   src, dst);
+		double t;
+		int f;
+
+		t = now();
+		for (f = 0; f < frames; f++)
+			NVCopyStripe(&c, 0, h);
+		t = now() - t;
+		printf("%-14s 1 thread:  %8.1f fps %8.1f MB/s\n",
+		       layouts[i].name, frames / t, bytes * frames / t / 1e6);
+
+#ifdef HAVE_PTHREAD
+		if (threads) {
+			struct nouveau_xv_workers *workers;
+
+			workers = nouveau_xv_workers_start(threads);
+			if (!workers || !workers->nthreads) {
+				fprintf(stderr, "couldn't start threads\n");
+				return 1;
+			}
+
+			t = now();
+			for (f = 0; f < frames; f++)
+				nouveau_xv_workers_copy(workers, &c);
+			t = now() - t;
+			printf("%-14s %d threads: %8.1f fps %8.1f MB/s\n",
+			       layouts[i].name, workers->nthreads + 1,
+			       frames / t, bytes * frames / t / 1e6);
+
+			nouveau_xv_workers_stop(workers);
+		}
+#endif
+	}
+
+	free(src);
+	free(dst);
+	return 0;
+}